@@ -22,18 +22,116 @@
 #include "mprops.h"
 #include "common.h"
 #include "mtouch.h"
+#include "trace.h"
+
+#include <limits.h>
+#include <stddef.h>
 
 #define MAX_INT_VALUES 4
 #define MAX_FLOAT_VALUES 4
 
-#define VALID_BUTTON(x) (x >= 0 && x <= 32)
-#define VALID_BOOL(x) (x == 0 || x == 1)
-#define VALID_PCNT(x) (x >= 0 && x <= 100)
+#define MPROP_FLOAT 0
+
+#define CFG(x) offsetof(struct MConfig, x)
+#define VALUE(x, min, max) { CFG(x), min, max }
+#define VALUE_BUTTON(x) VALUE(x, 0, 32)
+#define VALUE_BOOL(x) VALUE(x, 0, 1)
+#define VALUE_PCNT(x) VALUE(x, 0, 100)
+#define VALUE_MIN(x, min) VALUE(x, min, INT_MAX)
+
+struct MPropValue {
+	size_t offset;
+	int min, max;
+};
+
+struct MPropDef {
+	const char* name;
+	int format;
+	int nvalues;
+	struct MPropValue values[MAX_INT_VALUES];
+};
+
+static const struct MPropDef mprop_defs[MPROP_COUNT] = {
+	[MPROP_TRACKPAD_DISABLE] = { MTRACK_PROP_TRACKPAD_DISABLE, 8, 1,
+		{ VALUE(trackpad_disable, 0, 3) } },
+	[MPROP_SENSITIVITY] = { MTRACK_PROP_SENSITIVITY, MPROP_FLOAT, 1,
+		{ VALUE_MIN(sensitivity, 0) } },
+	[MPROP_PRESSURE] = { MTRACK_PROP_PRESSURE, 8, 2,
+		{ VALUE_PCNT(touch_down), VALUE_PCNT(touch_up) } },
+	[MPROP_BUTTON_SETTINGS] = { MTRACK_PROP_BUTTON_SETTINGS, 8, 2,
+		{ VALUE_BOOL(button_enable), VALUE_BOOL(button_integrated) } },
+	[MPROP_BUTTON_EMULATE_SETTINGS] = { MTRACK_PROP_BUTTON_EMULATE_SETTINGS, 16, 3,
+		{ VALUE_BOOL(button_zones), VALUE_BOOL(button_move), VALUE_MIN(button_expire, 0) } },
+	[MPROP_BUTTON_EMULATE_VALUES] = { MTRACK_PROP_BUTTON_EMULATE_VALUES, 8, 3,
+		{ VALUE_BUTTON(button_1touch), VALUE_BUTTON(button_2touch), VALUE_BUTTON(button_3touch) } },
+	[MPROP_TAP_SETTINGS] = { MTRACK_PROP_TAP_SETTINGS, 32, 3,
+		{ VALUE_MIN(tap_hold, 1), VALUE_MIN(tap_timeout, 1), VALUE_MIN(tap_dist, 1) } },
+	[MPROP_TAP_EMULATE] = { MTRACK_PROP_TAP_EMULATE, 8, 4,
+		{ VALUE_BUTTON(tap_1touch), VALUE_BUTTON(tap_2touch), VALUE_BUTTON(tap_3touch), VALUE_BUTTON(tap_4touch) } },
+	[MPROP_THUMB_DETECT] = { MTRACK_PROP_THUMB_DETECT, 8, 2,
+		{ VALUE_BOOL(ignore_thumb), VALUE_BOOL(disable_on_thumb) } },
+	[MPROP_THUMB_SIZE] = { MTRACK_PROP_THUMB_SIZE, 32, 2,
+		{ VALUE_MIN(thumb_size, 0), VALUE_PCNT(thumb_ratio) } },
+	[MPROP_PALM_DETECT] = { MTRACK_PROP_PALM_DETECT, 8, 2,
+		{ VALUE_BOOL(ignore_palm), VALUE_BOOL(disable_on_palm) } },
+	[MPROP_PALM_SIZE] = { MTRACK_PROP_PALM_SIZE, 32, 1,
+		{ VALUE_MIN(palm_size, 0) } },
+	[MPROP_GESTURE_SETTINGS] = { MTRACK_PROP_GESTURE_SETTINGS, 16, 2,
+		{ VALUE_MIN(gesture_hold, 1), VALUE_MIN(gesture_wait, 0) } },
+	[MPROP_SCROLL_DIST] = { MTRACK_PROP_SCROLL_DIST, 32, 1,
+		{ VALUE_MIN(scroll_dist, 1) } },
+	[MPROP_SCROLL_BUTTONS] = { MTRACK_PROP_SCROLL_BUTTONS, 8, 4,
+		{ VALUE_BUTTON(scroll_up_btn), VALUE_BUTTON(scroll_dn_btn), VALUE_BUTTON(scroll_lt_btn), VALUE_BUTTON(scroll_rt_btn) } },
+	[MPROP_SWIPE_DIST] = { MTRACK_PROP_SWIPE_DIST, 32, 1,
+		{ VALUE_MIN(swipe_dist, 1) } },
+	[MPROP_SWIPE_BUTTONS] = { MTRACK_PROP_SWIPE_BUTTONS, 8, 4,
+		{ VALUE_BUTTON(swipe_up_btn), VALUE_BUTTON(swipe_dn_btn), VALUE_BUTTON(swipe_lt_btn), VALUE_BUTTON(swipe_rt_btn) } },
+	[MPROP_SWIPE4_DIST] = { MTRACK_PROP_SWIPE4_DIST, 32, 1,
+		{ VALUE_MIN(swipe4_dist, 1) } },
+	[MPROP_SWIPE4_BUTTONS] = { MTRACK_PROP_SWIPE4_BUTTONS, 8, 4,
+		{ VALUE_BUTTON(swipe4_up_btn), VALUE_BUTTON(swipe4_dn_btn), VALUE_BUTTON(swipe4_lt_btn), VALUE_BUTTON(swipe4_rt_btn) } },
+	[MPROP_SCALE_DIST] = { MTRACK_PROP_SCALE_DIST, 32, 1,
+		{ VALUE_MIN(scale_dist, 1) } },
+	[MPROP_SCALE_BUTTONS] = { MTRACK_PROP_SCALE_BUTTONS, 8, 2,
+		{ VALUE_BUTTON(scale_up_btn), VALUE_BUTTON(scale_dn_btn) } },
+	[MPROP_ROTATE_DIST] = { MTRACK_PROP_ROTATE_DIST, 32, 1,
+		{ VALUE_MIN(rotate_dist, 1) } },
+	[MPROP_ROTATE_BUTTONS] = { MTRACK_PROP_ROTATE_BUTTONS, 8, 2,
+		{ VALUE_BUTTON(rotate_lt_btn), VALUE_BUTTON(rotate_rt_btn) } },
+	[MPROP_DRAG_SETTINGS] = { MTRACK_PROP_DRAG_SETTINGS, 32, 4,
+		{ VALUE_BOOL(drag_enable), VALUE_MIN(drag_timeout, 1), VALUE_MIN(drag_wait, 0), VALUE_MIN(drag_dist, 0) } },
+	[MPROP_AXIS_INVERT] = { MTRACK_PROP_AXIS_INVERT, 8, 2,
+		{ VALUE_BOOL(axis_x_invert), VALUE_BOOL(axis_y_invert) } },
+	[MPROP_BOTTOM_EDGE] = { MTRACK_PROP_BOTTOM_EDGE, 8, 1,
+		{ VALUE_PCNT(bottom_edge) } },
+	[MPROP_PINCH_THRESHOLD] = { MTRACK_PROP_PINCH_THRESHOLD, 32, 1,
+		{ VALUE_MIN(pinch_threshold, 1) } },
+};
 
 struct MProps mprops;
 
-Atom atom_init_integer(DeviceIntPtr dev, char* name, int nvalues, int* values, int size) {
-	Atom atom;
+static inline int* cfg_int(struct MConfig* cfg, const struct MPropValue* value)
+{
+	return (int*)((char*)cfg + value->offset);
+}
+
+/* Number of values in the config blob, including the version.
+ */
+static int blob_size(void)
+{
+	int i, n = 1;
+	for (i = 0; i < MPROP_COUNT; i++)
+		n += mprop_defs[i].nvalues;
+	return n;
+}
+
+static int blob_sensitivity(double sensitivity)
+{
+	return (int)(sensitivity*1000 + 0.5);
+}
+
+static void prop_change_integer(DeviceIntPtr dev, Atom atom, int nvalues, int* values, int size)
+{
 	int i;
 	uint8_t uvals8[MAX_INT_VALUES];
 	uint16_t uvals16[MAX_INT_VALUES];
@@ -62,8 +160,12 @@ Atom atom_init_integer(DeviceIntPtr dev, char* name, int nvalues, int* values, i
 		break;
 	}
 
-	atom = MakeAtom(name, strlen(name), TRUE);
 	XIChangeDeviceProperty(dev, atom, XA_INTEGER, size, PropModeReplace, nvalues, uvals, FALSE);
+}
+
+Atom atom_init_integer(DeviceIntPtr dev, char* name, int nvalues, int* values, int size) {
+	Atom atom = MakeAtom(name, strlen(name), TRUE);
+	prop_change_integer(dev, atom, nvalues, values, size);
 	XISetDevicePropertyDeletable(dev, atom, FALSE);
 	return atom;
 }
@@ -75,566 +177,358 @@ Atom atom_init_float(DeviceIntPtr dev, char* name, int nvalues, float* values, A
 	return atom;
 }
 
-void mprops_init(struct MConfig* cfg, InputInfoPtr local) {
+/* Write the current value of a property into the device. With create
+ * set the property is new to the device and is made non-deletable. The
+ * atoms are the same for every device and are only looked up once.
+ */
+static void mprop_publish(DeviceIntPtr dev, struct MConfig* cfg, int index, int create)
+{
+	const struct MPropDef* def;
 	int ivals[MAX_INT_VALUES];
 	float fvals[MAX_FLOAT_VALUES];
+	int32_t* blob;
+	int i, j, n;
 
-	mprops.float_type = XIGetKnownProperty(XATOM_FLOAT);
-	if (!mprops.float_type) {
-		mprops.float_type = MakeAtom(XATOM_FLOAT, strlen(XATOM_FLOAT), TRUE);
-		if (!mprops.float_type) {
-			xf86Msg(X_ERROR, "mtrack: %s: Failed to init float atom. Property support is disabled.\n", local->name);
+	if (index == MPROP_CONFIG_BLOB) {
+		n = blob_size();
+		blob = calloc(n, sizeof(int32_t));
+		if (!blob)
 			return;
+		n = 0;
+		blob[n++] = MTRACK_CONFIG_BLOB_VERSION;
+		for (i = 0; i < MPROP_COUNT; i++) {
+			def = &mprop_defs[i];
+			for (j = 0; j < def->nvalues; j++) {
+				if (def->format == MPROP_FLOAT)
+					blob[n++] = blob_sensitivity(cfg->sensitivity);
+				else
+					blob[n++] = *cfg_int(cfg, &def->values[j]);
+			}
 		}
+		if (!mprops.atoms[index])
+			mprops.atoms[index] = MakeAtom(MTRACK_PROP_CONFIG_BLOB, strlen(MTRACK_PROP_CONFIG_BLOB), TRUE);
+		XIChangeDeviceProperty(dev, mprops.atoms[index], XA_INTEGER, 32, PropModeReplace, n, blob, FALSE);
+		if (create)
+			XISetDevicePropertyDeletable(dev, mprops.atoms[index], FALSE);
+		free(blob);
+		return;
 	}
 
-	ivals[0] = cfg->trackpad_disable;
-	mprops.trackpad_disable = atom_init_integer(local->dev, MTRACK_PROP_TRACKPAD_DISABLE, 1, ivals, 8);
-
-	fvals[0] = (float)cfg->sensitivity;
-	mprops.sensitivity = atom_init_float(local->dev, MTRACK_PROP_SENSITIVITY, 1, fvals, mprops.float_type);
-
-	ivals[0] = cfg->touch_down;
-	ivals[1] = cfg->touch_up;
-	mprops.pressure = atom_init_integer(local->dev, MTRACK_PROP_PRESSURE, 2, ivals, 8);
-
-	ivals[0] = cfg->button_enable;
-	ivals[1] = cfg->button_integrated;
-	mprops.button_settings = atom_init_integer(local->dev, MTRACK_PROP_BUTTON_SETTINGS, 2, ivals, 8);
-
-	ivals[0] = cfg->button_zones;
-	ivals[1] = cfg->button_move;
-	ivals[2] = cfg->button_expire;
-	mprops.button_emulate_settings = atom_init_integer(local->dev, MTRACK_PROP_BUTTON_EMULATE_SETTINGS, 3, ivals, 16);
-
-	ivals[0] = cfg->button_1touch;
-	ivals[1] = cfg->button_2touch;
-	ivals[2] = cfg->button_3touch;
-	mprops.button_emulate_values = atom_init_integer(local->dev, MTRACK_PROP_BUTTON_EMULATE_VALUES, 3, ivals, 8);
-
-	ivals[0] = cfg->tap_hold;
-	ivals[1] = cfg->tap_timeout;
-	ivals[2] = cfg->tap_dist;
-	mprops.tap_settings = atom_init_integer(local->dev, MTRACK_PROP_TAP_SETTINGS, 3, ivals, 32);
-
-	ivals[0] = cfg->tap_1touch;
-	ivals[1] = cfg->tap_2touch;
-	ivals[2] = cfg->tap_3touch;
-	ivals[3] = cfg->tap_4touch;
-	mprops.tap_emulate = atom_init_integer(local->dev, MTRACK_PROP_TAP_EMULATE, 4, ivals, 8);
-
-	ivals[0] = cfg->ignore_thumb;
-	ivals[1] = cfg->disable_on_thumb;
-	mprops.thumb_detect = atom_init_integer(local->dev, MTRACK_PROP_THUMB_DETECT, 2, ivals, 8);
-
-	ivals[0] = cfg->thumb_size;
-	ivals[1] = cfg->thumb_ratio;
-	mprops.thumb_size = atom_init_integer(local->dev, MTRACK_PROP_THUMB_SIZE, 2, ivals, 32);
-
-	ivals[0] = cfg->ignore_palm;
-	ivals[1] = cfg->disable_on_palm;
-	mprops.palm_detect = atom_init_integer(local->dev, MTRACK_PROP_PALM_DETECT, 2, ivals, 8);
-
-	ivals[0] = cfg->palm_size;
-	mprops.palm_size = atom_init_integer(local->dev, MTRACK_PROP_PALM_SIZE, 1, ivals, 32);
-
-	ivals[0] = cfg->gesture_hold;
-	ivals[1] = cfg->gesture_wait;
-	mprops.gesture_settings = atom_init_integer(local->dev, MTRACK_PROP_GESTURE_SETTINGS, 2, ivals, 16);
-
-	ivals[0] = cfg->scroll_dist;
-	mprops.scroll_dist = atom_init_integer(local->dev, MTRACK_PROP_SCROLL_DIST, 1, ivals, 32);
-
-	ivals[0] = cfg->scroll_up_btn;
-	ivals[1] = cfg->scroll_dn_btn;
-	ivals[2] = cfg->scroll_lt_btn;
-	ivals[3] = cfg->scroll_rt_btn;
-	mprops.scroll_buttons = atom_init_integer(local->dev, MTRACK_PROP_SCROLL_BUTTONS, 4, ivals, 8);
-
-	ivals[0] = cfg->swipe_dist;
-	mprops.swipe_dist = atom_init_integer(local->dev, MTRACK_PROP_SWIPE_DIST, 1, ivals, 32);
-
-	ivals[0] = cfg->swipe_up_btn;
-	ivals[1] = cfg->swipe_dn_btn;
-	ivals[2] = cfg->swipe_lt_btn;
-	ivals[3] = cfg->swipe_rt_btn;
-	mprops.swipe_buttons = atom_init_integer(local->dev, MTRACK_PROP_SWIPE_BUTTONS, 4, ivals, 8);
-
-	ivals[0] = cfg->swipe4_dist;
-	mprops.swipe4_dist = atom_init_integer(local->dev, MTRACK_PROP_SWIPE4_DIST, 1, ivals, 32);
-
-	ivals[0] = cfg->swipe4_up_btn;
-	ivals[1] = cfg->swipe4_dn_btn;
-	ivals[2] = cfg->swipe4_lt_btn;
-	ivals[3] = cfg->swipe4_rt_btn;
-	mprops.swipe4_buttons = atom_init_integer(local->dev, MTRACK_PROP_SWIPE4_BUTTONS, 4, ivals, 8);
-
-	ivals[0] = cfg->scale_dist;
-	mprops.scale_dist = atom_init_integer(local->dev, MTRACK_PROP_SCALE_DIST, 1, ivals, 32);
-
-	ivals[0] = cfg->scale_up_btn;
-	ivals[1] = cfg->scale_dn_btn;
-	mprops.scale_buttons = atom_init_integer(local->dev, MTRACK_PROP_SCALE_BUTTONS, 2, ivals, 8);
-
-	ivals[0] = cfg->rotate_dist;
-	mprops.rotate_dist = atom_init_integer(local->dev, MTRACK_PROP_ROTATE_DIST, 1, ivals, 32);
-
-	ivals[0] = cfg->rotate_lt_btn;
-	ivals[1] = cfg->rotate_rt_btn;
-	mprops.rotate_buttons = atom_init_integer(local->dev, MTRACK_PROP_SCALE_BUTTONS, 2, ivals, 8);
-
-	ivals[0] = cfg->drag_enable;
-	ivals[1] = cfg->drag_timeout;
-	ivals[2] = cfg->drag_wait;
-	ivals[3] = cfg->drag_dist;
-	mprops.drag_settings = atom_init_integer(local->dev, MTRACK_PROP_DRAG_SETTINGS, 4, ivals, 32);
-
-	ivals[0] = cfg->axis_x_invert;
-	ivals[1] = cfg->axis_y_invert;
-	mprops.axis_invert = atom_init_integer(local->dev, MTRACK_PROP_AXIS_INVERT, 2, ivals, 8);
-}
-
-int mprops_set_property(DeviceIntPtr dev, Atom property, XIPropertyValuePtr prop, BOOL checkonly) {
-	InputInfoPtr local = dev->public.devicePrivate;
-	struct MConfig* cfg = &((struct MTouch*)local->private)->cfg;
-
-	uint8_t* ivals8;
-	uint16_t* ivals16;
-	uint32_t* ivals32;
-	float* fvals;
-
-	if (property == mprops.trackpad_disable) {
-		if (prop->size != 1 || prop->format != 8 || prop->type != XA_INTEGER)
-			return BadMatch;
-
-		ivals8 = (uint8_t*)prop->data;
-		if (ivals8[0] < 0 || ivals8[0] > 3)
-			return BadMatch;
-
-		if (!checkonly) {
-			cfg->trackpad_disable = ivals8[0];
-#ifdef DEBUG_PROPS
-			if (cfg->trackpad_disable)
-				xf86Msg(X_INFO, "mtrack: trackpad input disabled\n");
-			else
-				xf86Msg(X_INFO, "mtrack: trackpad input enabled\n");
-#endif
-		}
-	}
-	else if (property == mprops.sensitivity) {
-		if (prop->size != 1 || prop->format != 32 || prop->type != mprops.float_type)
-			return BadMatch;
-
-		fvals = (float*)prop->data;
-		if (fvals[0] < 0)
-			return BadMatch;
-
-		if (!checkonly) {
-			cfg->sensitivity = fvals[0];
-#ifdef DEBUG_PROPS
-			xf86Msg(X_INFO, "mtrack: set sensitivity to %f\n", cfg->sensitivity);
-#endif
-		}
+	def = &mprop_defs[index];
+	if (def->format == MPROP_FLOAT) {
+		fvals[0] = (float)cfg->sensitivity;
+		if (create)
+			mprops.atoms[index] = atom_init_float(dev, (char*)def->name, 1, fvals, mprops.float_type);
+		else
+			XIChangeDeviceProperty(dev, mprops.atoms[index], mprops.float_type, 32, PropModeReplace, 1, fvals, FALSE);
+		return;
 	}
-	else if (property == mprops.pressure) {
-		if (prop->size != 2 || prop->format != 8 || prop->type != XA_INTEGER) 
-			return BadMatch;
-
-		ivals8 = (uint8_t*)prop->data;
-		if (!VALID_PCNT(ivals8[0]) || !VALID_PCNT(ivals8[1]))
-			return BadMatch;
 
-		if (!checkonly) {
-			cfg->touch_down = ivals8[0];
-			cfg->touch_up = ivals8[1];
-#ifdef DEBUG_PROPS
-			xf86Msg(X_INFO, "mtrack: set touch pressure to %d %d\n",
-				cfg->touch_down, cfg->touch_up);
-#endif
-		}
-	}
-	else if (property == mprops.button_settings) {
-		if (prop->size != 2 || prop->format != 8 || prop->type != XA_INTEGER) 
-			return BadMatch;
-
-		ivals8 = (uint8_t*)prop->data;
-		if (!VALID_BOOL(ivals16[0]) || !VALID_BOOL(ivals16[1]))
-			return BadMatch;
-
-		if (!checkonly) {
-			cfg->button_enable = ivals8[0];
-			cfg->button_integrated = ivals8[1];
-#ifdef DEBUG_PROPS
-			xf86Msg(X_INFO, "mtrack: set button settings to %d %d\n",
-				cfg->button_enable, cfg->button_integrated);
-#endif
-		}
-	}
-	else if (property == mprops.button_emulate_settings) {
-		if (prop->size != 3 || prop->format != 16 || prop->type != XA_INTEGER)
-			return BadMatch;
-
-		ivals16 = (uint16_t*)prop->data;
-		if (!VALID_BOOL(ivals16[0]) || !VALID_BOOL(ivals16[1]) || ivals16[2] < 0)
-			return BadMatch;
+	for (i = 0; i < def->nvalues; i++)
+		ivals[i] = *cfg_int(cfg, &def->values[i]);
+	if (create)
+		mprops.atoms[index] = atom_init_integer(dev, (char*)def->name, def->nvalues, ivals, def->format);
+	else
+		prop_change_integer(dev, mprops.atoms[index], def->nvalues, ivals, def->format);
+}
 
-		if (!checkonly) {
-			cfg->button_zones = ivals16[0];
-			cfg->button_move = ivals16[1];
-			cfg->button_expire = ivals16[2];
-#ifdef DEBUG_PROPS
-			xf86Msg(X_INFO, "mtrack: set button emulate settings to %d %d %d\n",
-				cfg->button_zones, cfg->button_move, cfg->button_expire);
-#endif
-		}
+/* Write the latency summary into the device, creating the property with
+ * create set as mprop_publish does.
+ */
+static void mprop_publish_latency(DeviceIntPtr dev, const struct MLatency* lat, int create)
+{
+	static const double percentiles[] = { 0.5, 0.9, 0.99 };
+	const struct LatencyHistogram* h;
+	int32_t vals[LATENCY_STAGES * 5];
+	int i, j, n = 0;
+
+	for (i = 0; i < LATENCY_STAGES; i++) {
+		h = &lat->stage[i];
+		vals[n++] = MINVAL(h->count, INT_MAX);
+		for (j = 0; j < 3; j++)
+			vals[n++] = MINVAL(latency_percentile(h, percentiles[j]), INT_MAX);
+		vals[n++] = MINVAL(h->max, INT_MAX);
 	}
-	else if (property == mprops.button_emulate_values) {
-		if (prop->size != 3 || prop->format != 8 || prop->type != XA_INTEGER)
-			return BadMatch;
 
-		ivals8 = (uint8_t*)prop->data;
-		if (!VALID_BUTTON(ivals8[0]) || !VALID_BUTTON(ivals8[1]) || !VALID_BUTTON(ivals8[2]))
-			return BadMatch;
+	if (!mprops.atoms[MPROP_LATENCY])
+		mprops.atoms[MPROP_LATENCY] = MakeAtom(MTRACK_PROP_LATENCY, strlen(MTRACK_PROP_LATENCY), TRUE);
+	XIChangeDeviceProperty(dev, mprops.atoms[MPROP_LATENCY], XA_INTEGER, 32, PropModeReplace, n, vals, FALSE);
+	if (create)
+		XISetDevicePropertyDeletable(dev, mprops.atoms[MPROP_LATENCY], FALSE);
+}
 
-		if (!checkonly) {
-			cfg->button_1touch = ivals8[0];
-			cfg->button_2touch = ivals8[1];
-			cfg->button_3touch = ivals8[2];
-#ifdef DEBUG_PROPS
-			xf86Msg(X_INFO, "mtrack: set button emulation to %d %d %s\n",
-				cfg->button_1touch, cfg->button_2touch, cfg->button_3touch);
-#endif
-		}
+static int mprops_lookup(Atom atom)
+{
+	int lo = 0, hi = mprops.nlookup - 1, mid;
+	while (lo <= hi) {
+		mid = (lo + hi) / 2;
+		if (mprops.lookup[mid].atom == atom)
+			return mprops.lookup[mid].index;
+		else if (mprops.lookup[mid].atom < atom)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
 	}
-	else if (property == mprops.tap_settings) {
-		if (prop->size != 3 || prop->format != 32 || prop->type != XA_INTEGER)
-			return BadMatch;
-
-		ivals32 = (uint32_t*)prop->data;
-		if (ivals32[0] < 1 || ivals32[1] < 1 || ivals32[2] < 1)
-			return BadMatch;
-
-		if (!checkonly) {
-			cfg->tap_hold = ivals32[0];
-			cfg->tap_timeout = ivals32[1];
-			cfg->tap_dist = ivals32[2];
-#ifdef DEBUG_PROPS
-			xf86Msg(X_INFO, "mtrack: set tap settings to %d %d %d\n",
-				cfg->tap_hold, cfg->tap_timeout, cfg->tap_dist);
-#endif
-		}
-	}
-	else if (property == mprops.tap_emulate) {
-		if (prop->size != 4 || prop->format != 8 || prop->type != XA_INTEGER)
-			return BadMatch;
-
-		ivals8 = (uint8_t*)prop->data;
-		if (!VALID_BUTTON(ivals8[0]) || !VALID_BUTTON(ivals8[1]) || !VALID_BUTTON(ivals8[2]) || !VALID_BUTTON(ivals8[3]))
-			return BadMatch;
+	return -1;
+}
 
-		if (!checkonly) {			
-			cfg->tap_1touch = ivals8[0];
-			cfg->tap_2touch = ivals8[1];
-			cfg->tap_3touch = ivals8[2];
-			cfg->tap_4touch = ivals8[3];
-#ifdef DEBUG_PROPS
-			xf86Msg(X_INFO, "mtrack: set tap emulation to %d %d %d %d\n",
-				cfg->tap_1touch, cfg->tap_2touch, cfg->tap_3touch, cfg->tap_4touch);
-#endif
-		}
+static void mprops_index(void)
+{
+	struct MPropIndex tmp;
+	int i, j;
+	mprops.nlookup = 0;
+	for (i = 0; i < MPROP_ATOMS; i++) {
+		if (!mprops.atoms[i])
+			continue;
+		tmp.atom = mprops.atoms[i];
+		tmp.index = i;
+		for (j = mprops.nlookup; j > 0 && mprops.lookup[j - 1].atom > tmp.atom; j--)
+			mprops.lookup[j] = mprops.lookup[j - 1];
+		mprops.lookup[j] = tmp;
+		mprops.nlookup++;
 	}
-	else if (property == mprops.thumb_detect) {
-		if (prop->size != 2 || prop->format != 8 || prop->type != XA_INTEGER)
-			return BadMatch;
+}
 
-		ivals8 = (uint8_t*)prop->data;
-		if (!VALID_BOOL(ivals8[0]) || !VALID_BOOL(ivals8[1]))
-			return BadMatch;
+void mprops_init(struct MConfig* cfg, InputInfoPtr local) {
+	struct MTouch* mt = local->private;
+	int i;
 
-		if (!checkonly) {
-			cfg->ignore_thumb = ivals8[0];
-			cfg->disable_on_thumb = ivals8[1];
-#ifdef DEBUG_PROPS
-			xf86Msg(X_INFO, "mtrack: set thumb detect to %d %d\n",
-				cfg->ignore_thumb, cfg->disable_on_thumb);
-#endif
+	mprops.float_type = XIGetKnownProperty(XATOM_FLOAT);
+	if (!mprops.float_type) {
+		mprops.float_type = MakeAtom(XATOM_FLOAT, strlen(XATOM_FLOAT), TRUE);
+		if (!mprops.float_type) {
+			xf86Msg(X_ERROR, "mtrack: %s: Failed to init float atom. Property support is disabled.\n", local->name);
+			return;
 		}
 	}
-	else if (property == mprops.thumb_size) {
-		if (prop->size != 2 || prop->format != 32 || prop->type != XA_INTEGER)
-			return BadMatch;
-
-		ivals32 = (uint32_t*)prop->data;
-		if (ivals32[0] < 0 || !VALID_PCNT(ivals32[1]))
-			return BadMatch;
 
-		if (!checkonly) {
-			cfg->thumb_size = ivals32[0];
-			cfg->thumb_ratio = ivals32[0];
-#ifdef DEBUG_PROPS
-			xf86Msg(X_INFO, "mtrack: set thumb size to %d %d\n",
-				cfg->thumb_size, cfg->thumb_ratio);
-#endif
-		}
+	mprops.updating = 1;
+	for (i = 0; i <= MPROP_COUNT; i++)
+		mprop_publish(local->dev, cfg, i, 1);
+	if (mt->latency)
+		mprop_publish_latency(local->dev, mt->latency, 1);
+	if (mt->flight) {
+		i = 0;
+		mprops.atoms[MPROP_FLIGHT] = atom_init_integer(local->dev, (char*)MTRACK_PROP_FLIGHT, 1, &i, 8);
 	}
-	else if (property == mprops.palm_detect) {
-		if (prop->size != 2 || prop->format != 8 || prop->type != XA_INTEGER)
-			return BadMatch;
-
-		ivals8 = (uint8_t*)prop->data;
-		if (!VALID_BOOL(ivals8[0]) || !VALID_BOOL(ivals8[1]))
-			return BadMatch;
+	i = trace_mask;
+	mprops.atoms[MPROP_TRACE] = atom_init_integer(local->dev, (char*)MTRACK_PROP_TRACE, 1, &i, 32);
+	mprops.updating = 0;
+	mprops_index();
+}
 
-		if (!checkonly) {
-			cfg->ignore_palm = ivals8[0];
-			cfg->disable_on_palm = ivals8[1];
-#ifdef DEBUG_PROPS
-			xf86Msg(X_INFO, "mtrack: set palm detect to %d %d\n",
-				cfg->ignore_palm, cfg->disable_on_palm);
-#endif
-		}
+/* Read a property value as an integer. 32 bit values are signed so that
+ * negative values fail range checks.
+ */
+static int prop_int(const XIPropertyValuePtr prop, int i)
+{
+	switch (prop->format) {
+	case 8:
+		return ((uint8_t*)prop->data)[i];
+	case 16:
+		return ((uint16_t*)prop->data)[i];
+	default:
+		return ((int32_t*)prop->data)[i];
 	}
-	else if (property == mprops.palm_size) {
-		if (prop->size != 1 || prop->format != 32 || prop->type != XA_INTEGER)
-			return BadMatch;
+}
 
-		ivals32 = (uint32_t*)prop->data;
-		if (ivals32[0] < 0)
+/* Check the values of one property against its limits.
+ */
+static int mprop_check(const struct MPropDef* def, const int* vals)
+{
+	int i;
+	for (i = 0; i < def->nvalues; i++) {
+		if (vals[i] < def->values[i].min || vals[i] > def->values[i].max)
 			return BadMatch;
-
-		if (!checkonly) {
-			cfg->palm_size = ivals32[0];
-#ifdef DEBUG_PROPS
-			xf86Msg(X_INFO, "mtrack: set palm size to %d\n",
-				cfg->palm_size);
-#endif
-		}
 	}
-	else if (property == mprops.gesture_settings) {
-		if (prop->size != 2 || prop->format != 16 || prop->type != XA_INTEGER)
-			return BadMatch;
-
-		ivals16 = (uint16_t*)prop->data;
-		if (ivals16[0] < 1 || ivals16[1] < 0)
-			return BadMatch;
+	return Success;
+}
 
-		if (!checkonly) {
-			cfg->gesture_hold = ivals16[0];
-			cfg->gesture_wait = ivals16[1];
-#ifdef DEBUG_PROPS
-			xf86Msg(X_INFO, "mtrack: set gesture settings to %d %d\n",
-				cfg->gesture_hold, cfg->gesture_wait);
-#endif
-		}
+static void mprop_apply(const struct MPropDef* def, const int* vals, struct MConfig* cfg)
+{
+	char text[16 * MAX_INT_VALUES];
+	int i, n = 0;
+	for (i = 0; i < def->nvalues; i++)
+		*cfg_int(cfg, &def->values[i]) = vals[i];
+	if (trace_enabled(TRACE_PROPS)) {
+		for (i = 0; i < def->nvalues; i++)
+			n += snprintf(text + n, sizeof(text) - n, " %d", vals[i]);
+		trace(TRACE_PROPS, "set %s to%s\n", def->name, n ? text : "");
 	}
-	else if (property == mprops.scroll_dist) {
-		if (prop->size != 1 || prop->format != 32 || prop->type != XA_INTEGER)
-			return BadMatch;
+}
 
-		ivals32 = (uint32_t*)prop->data;
-		if (ivals32[0] < 1)
-			return BadMatch;
+static int mprops_set_single(int index, XIPropertyValuePtr prop, BOOL checkonly, struct MConfig* cfg)
+{
+	const struct MPropDef* def = &mprop_defs[index];
+	int i, ivals[MAX_INT_VALUES];
+	float* fvals;
 
-		if (!checkonly) {
-			cfg->scroll_dist = ivals32[0];
-#ifdef DEBUG_PROPS
-			xf86Msg(X_INFO, "mtrack: set scroll distance to %d\n",
-				cfg->scroll_dist);
-#endif
-		}
-	}
-	else if (property == mprops.scroll_buttons) {
-		if (prop->size != 4 || prop->format != 8 || prop->type != XA_INTEGER)
+	if (def->format == MPROP_FLOAT) {
+		if (prop->size != 1 || prop->format != 32 || prop->type != mprops.float_type)
 			return BadMatch;
 
-		ivals8 = (uint8_t*)prop->data;
-		if (!VALID_BUTTON(ivals8[0]) || !VALID_BUTTON(ivals8[1]) || !VALID_BUTTON(ivals8[2]) || !VALID_BUTTON(ivals8[3]))
+		fvals = (float*)prop->data;
+		if (fvals[0] < 0)
 			return BadMatch;
 
 		if (!checkonly) {
-			cfg->scroll_up_btn = ivals8[0];
-			cfg->scroll_dn_btn = ivals8[1];
-			cfg->scroll_lt_btn = ivals8[2];
-			cfg->scroll_rt_btn = ivals8[3];
-#ifdef DEBUG_PROPS
-			xf86Msg(X_INFO, "mtrack: set scroll buttons to %d %d %d %d\n",
-				cfg->scroll_up_btn, cfg->scroll_dn_btn, cfg->scroll_lt_btn, cfg->scroll_rt_btn);
-#endif
+			cfg->sensitivity = fvals[0];
+			trace(TRACE_PROPS, "set sensitivity to %f\n", cfg->sensitivity);
 		}
+		return Success;
 	}
-	else if (property == mprops.swipe_dist) {
-		if (prop->size != 1 || prop->format != 32 || prop->type != XA_INTEGER)
-			return BadMatch;
 
-		ivals32 = (uint32_t*)prop->data;
-		if (ivals32[0] < 1)
-			return BadMatch;
+	if (prop->size != def->nvalues || prop->format != def->format || prop->type != XA_INTEGER)
+		return BadMatch;
 
-		if (!checkonly) {
-			cfg->swipe_dist = ivals32[0];
-#ifdef DEBUG_PROPS
-			xf86Msg(X_INFO, "mtrack: set swipe distance to %d\n",
-				cfg->swipe_dist);
-#endif
-		}
-	}
-	else if (property == mprops.swipe_buttons) {
-		if (prop->size != 4 || prop->format != 8 || prop->type != XA_INTEGER)
-			return BadMatch;
+	for (i = 0; i < def->nvalues; i++)
+		ivals[i] = prop_int(prop, i);
+	if (mprop_check(def, ivals) != Success)
+		return BadMatch;
 
-		ivals8 = (uint8_t*)prop->data;
-		if (!VALID_BUTTON(ivals8[0]) || !VALID_BUTTON(ivals8[1]) || !VALID_BUTTON(ivals8[2]) || !VALID_BUTTON(ivals8[3]))
-			return BadMatch;
+	if (!checkonly)
+		mprop_apply(def, ivals, cfg);
+	return Success;
+}
 
-		if (!checkonly) {
-			cfg->swipe_up_btn = ivals8[0];
-			cfg->swipe_dn_btn = ivals8[1];
-			cfg->swipe_lt_btn = ivals8[2];
-			cfg->swipe_rt_btn = ivals8[3];
-#ifdef DEBUG_PROPS
-			xf86Msg(X_INFO, "mtrack: set swipe buttons to %d %d %d %d\n",
-				cfg->swipe_up_btn, cfg->swipe_dn_btn, cfg->swipe_lt_btn, cfg->swipe_rt_btn);
-#endif
-		}
-	}
-	else if (property == mprops.swipe4_dist) {
-		if (prop->size != 1 || prop->format != 32 || prop->type != XA_INTEGER)
-			return BadMatch;
+static int mprops_set_blob(XIPropertyValuePtr prop, BOOL checkonly, struct MConfig* cfg)
+{
+	const struct MPropDef* def;
+	const int32_t* blob;
+	int i, n;
 
-		ivals32 = (uint32_t*)prop->data;
-		if (ivals32[0] < 1)
-			return BadMatch;
+	if (prop->size != blob_size() || prop->format != 32 || prop->type != XA_INTEGER)
+		return BadMatch;
 
-		if (!checkonly) {
-			cfg->swipe4_dist = ivals32[0];
-#ifdef DEBUG_PROPS
-			xf86Msg(X_INFO, "mtrack: set swipe4 distance to %d\n",
-				cfg->swipe4_dist);
-#endif
-		}
-	}
-	else if (property == mprops.swipe4_buttons) {
-		if (prop->size != 4 || prop->format != 8 || prop->type != XA_INTEGER)
-			return BadMatch;
+	blob = (const int32_t*)prop->data;
+	if (blob[0] != MTRACK_CONFIG_BLOB_VERSION)
+		return BadMatch;
 
-		ivals8 = (uint8_t*)prop->data;
-		if (!VALID_BUTTON(ivals8[0]) || !VALID_BUTTON(ivals8[1]) || !VALID_BUTTON(ivals8[2]) || !VALID_BUTTON(ivals8[3]))
-			return BadMatch;
-
-		if (!checkonly) {
-			cfg->swipe4_up_btn = ivals8[0];
-			cfg->swipe4_dn_btn = ivals8[1];
-			cfg->swipe4_lt_btn = ivals8[2];
-			cfg->swipe4_rt_btn = ivals8[3];
-#ifdef DEBUG_PROPS
-			xf86Msg(X_INFO, "mtrack: set swipe4 buttons to %d %d %d %d\n",
-				cfg->swipe4_up_btn, cfg->swipe4_dn_btn, cfg->swipe4_lt_btn, cfg->swipe4_rt_btn);
-#endif
+	for (i = 0, n = 1; i < MPROP_COUNT; n += mprop_defs[i++].nvalues) {
+		def = &mprop_defs[i];
+		if (def->format == MPROP_FLOAT) {
+			if (blob[n] < 0)
+				return BadMatch;
 		}
-	}
-	else if (property == mprops.scale_dist) {
-		if (prop->size != 1 || prop->format != 32 || prop->type != XA_INTEGER)
-			return BadMatch;
-
-		ivals32 = (uint32_t*)prop->data;
-		if (ivals32[0] < 1)
+		else if (mprop_check(def, &blob[n]) != Success)
 			return BadMatch;
-
-		if (!checkonly) {
-			cfg->scale_dist = ivals32[0];
-#ifdef DEBUG_PROPS
-			xf86Msg(X_INFO, "mtrack: set scale distance to %d\n",
-				cfg->scale_dist);
-#endif
-		}
 	}
-	else if (property == mprops.scale_buttons) {
-		if (prop->size != 4 || prop->format != 8 || prop->type != XA_INTEGER)
-			return BadMatch;
 
-		ivals8 = (uint8_t*)prop->data;
-		if (!VALID_BUTTON(ivals8[0]) || !VALID_BUTTON(ivals8[1]) || !VALID_BUTTON(ivals8[2]) || !VALID_BUTTON(ivals8[3]))
-			return BadMatch;
+	if (checkonly)
+		return Success;
 
-		if (!checkonly) {
-			cfg->scale_up_btn = ivals8[0];
-			cfg->scale_dn_btn = ivals8[1];
-#ifdef DEBUG_PROPS
-			xf86Msg(X_INFO, "mtrack: set scale buttons to %d %d\n",
-				cfg->scale_up_btn, cfg->scale_dn_btn);
-#endif
-		}
+	for (i = 0, n = 1; i < MPROP_COUNT; n += mprop_defs[i++].nvalues) {
+		def = &mprop_defs[i];
+		if (def->format == MPROP_FLOAT)
+			cfg->sensitivity = blob[n] / 1000.0;
+		else
+			mprop_apply(def, &blob[n], cfg);
 	}
-	else if (property == mprops.rotate_dist) {
-		if (prop->size != 1 || prop->format != 32 || prop->type != XA_INTEGER)
-			return BadMatch;
+	return Success;
+}
 
-		ivals32 = (uint32_t*)prop->data;
-		if (ivals32[0] < 1)
-			return BadMatch;
+/* Save the flight recorder as text when 1 is written, or as a Chrome
+ * trace when 2 is.
+ */
+static int mprops_set_flight(struct MTouch* mt, XIPropertyValuePtr prop, BOOL checkonly)
+{
+	char saved[sizeof(mt->flight->path) + 16];
+	int format, n;
+
+	if (prop->size != 1 || prop->format != 8 || prop->type != XA_INTEGER)
+		return BadMatch;
+	if (checkonly || !prop_int(prop, 0))
+		return Success;
+
+	format = prop_int(prop, 0) == FLIGHT_CHROME ? FLIGHT_CHROME : FLIGHT_TEXT;
+	n = flight_save(mt->flight, format, saved, sizeof(saved));
+	if (n < 0)
+		xf86Msg(X_ERROR, "mtrack: cannot save flight recorder to %s: %s\n",
+			mt->flight->path, strerror(-n));
+	else
+		xf86Msg(X_INFO, "mtrack: saved %d flight records to %s\n", n, saved);
+	return Success;
+}
 
-		if (!checkonly) {
-			cfg->rotate_dist = ivals32[0];
-#ifdef DEBUG_PROPS
-			xf86Msg(X_INFO, "mtrack: set rotate distance to %d\n",
-				cfg->rotate_dist);
-#endif
-		}
-	}
-	else if (property == mprops.rotate_buttons) {
-		if (prop->size != 4 || prop->format != 8 || prop->type != XA_INTEGER)
-			return BadMatch;
+static int mprops_set_trace(XIPropertyValuePtr prop, BOOL checkonly)
+{
+	int mask;
 
-		ivals8 = (uint8_t*)prop->data;
-		if (!VALID_BUTTON(ivals8[0]) || !VALID_BUTTON(ivals8[1]) || !VALID_BUTTON(ivals8[2]) || !VALID_BUTTON(ivals8[3]))
-			return BadMatch;
+	if (prop->size != 1 || prop->format != 32 || prop->type != XA_INTEGER)
+		return BadMatch;
+	mask = prop_int(prop, 0);
+	if (mask & ~TRACE_ALL)
+		return BadMatch;
 
-		if (!checkonly) {
-			cfg->rotate_lt_btn = ivals8[0];
-			cfg->rotate_rt_btn = ivals8[1];
-#ifdef DEBUG_PROPS
-			xf86Msg(X_INFO, "mtrack: set rotate buttons to %d %d\n",
-				cfg->rotate_lt_btn, cfg->rotate_rt_btn);
-#endif
-		}
+	if (!checkonly) {
+		trace_set_mask(mask);
+		mtrack_trace_update();
 	}
-	else if (property == mprops.drag_settings) {
-		if (prop->size != 4 || prop->format != 32 || prop->type != XA_INTEGER)
-			return BadMatch;
-
-		ivals32 = (uint32_t*)prop->data;
-		if (!VALID_BOOL(ivals32[0]) || ivals32[1] < 1 || ivals32[2] < 0 || ivals32[3] < 0)
-			return BadMatch;
+	return Success;
+}
 
-		if (!checkonly) {
-			cfg->drag_enable = ivals32[0];
-			cfg->drag_timeout = ivals32[1];
-			cfg->drag_wait = ivals32[2];
-			cfg->drag_dist = ivals32[3];
-#ifdef DEBUG_PROPS
-			xf86Msg(X_INFO, "mtrack: set drag settings to %d %d %d %d\n",
-				cfg->drag_enable, cfg->drag_timeout, cfg->drag_wait, cfg->drag_dist);
-#endif
-		}
+int mprops_set_property(DeviceIntPtr dev, Atom property, XIPropertyValuePtr prop, BOOL checkonly) {
+	InputInfoPtr local = dev->public.devicePrivate;
+	struct MTouch* mt = local->private;
+	struct MConfig* cfg = &mt->cfg;
+	int i, index, rc;
+
+	if (mprops.updating)
+		return Success;
+
+	index = mprops_lookup(property);
+	if (index < 0)
+		return Success;
+	if (index == MPROP_LATENCY)
+		return BadAccess;
+	if (index == MPROP_FLIGHT)
+		return mprops_set_flight(mt, prop, checkonly);
+	if (index == MPROP_TRACE)
+		return mprops_set_trace(prop, checkonly);
+
+	if (index == MPROP_CONFIG_BLOB)
+		rc = mprops_set_blob(prop, checkonly, cfg);
+	else
+		rc = mprops_set_single(index, prop, checkonly, cfg);
+	if (rc != Success || checkonly)
+		return rc;
+
+	mtouch_publish_config(mt);
+
+	// Keep the single properties and the blob in sync.
+	mprops.updating = 1;
+	if (index == MPROP_CONFIG_BLOB) {
+		for (i = 0; i < MPROP_COUNT; i++)
+			mprop_publish(dev, cfg, i, 0);
 	}
-	else if (property == mprops.axis_invert) {
-		if (prop->size != 2 || prop->format != 8 || prop->type != XA_INTEGER)
-			return BadMatch;
+	else
+		mprop_publish(dev, cfg, MPROP_CONFIG_BLOB, 0);
+	mprops.updating = 0;
 
-		ivals8 = (uint8_t*)prop->data;
-		if (!VALID_BOOL(ivals8[0]) || !VALID_BOOL(ivals8[1]))
-			return BadMatch;
+	return Success;
+}
 
-		if (!checkonly) {
-			cfg->axis_x_invert = ivals8[0];
-			cfg->axis_y_invert = ivals8[1];
-#ifdef DEBUG_PROPS
-			xf86Msg(X_INFO, "mtrack: set axis inversion to %d %d\n",
-				cfg->axis_x_invert, cfg->axis_y_invert);
-#endif
-		}
+/* Refresh the properties the driver changes behind the back of clients
+ * before they are read.
+ */
+int mprops_get_property(DeviceIntPtr dev, Atom property)
+{
+	InputInfoPtr local = dev->public.devicePrivate;
+	struct MTouch* mt = local->private;
+	int index, mask;
+
+	if (mprops.updating)
+		return Success;
+
+	index = mprops_lookup(property);
+	mprops.updating = 1;
+	if (index == MPROP_LATENCY && mt->latency)
+		mprop_publish_latency(dev, mt->latency, 0);
+	else if (index == MPROP_TRACE) {
+		// The mask is shared by all devices, another may have changed it.
+		mask = trace_mask;
+		prop_change_integer(dev, property, 1, &mask, 32);
 	}
-
+	mprops.updating = 0;
 	return Success;
 }
-
@@ -20,8 +20,14 @@
  *
  **************************************************************************/
 
+#include <xorg-server.h>
+#include <xf86.h>
+#include <xf86_OSproc.h>
+#include <xf86Xinput.h>
+
 #include "mtouch.h"
 #include "mprops.h"
+#include "trace.h"
 
 #include <xf86Module.h>
 #if GET_ABI_MAJOR(ABI_XINPUT_VERSION) >= 7
@@ -38,6 +44,12 @@
 #define SCALE_THRESHOLD 0.15
 #define ROTATE_THRESHOLD 0.15
 
+// How often trace lines are moved from their buffer to the log.
+#define TRACE_DRAIN_MS 100
+
+// Where the flight recorder is saved unless FlightRecorderFile says otherwise.
+#define FLIGHT_FILE "/var/log/mtrack-flight"
+
 #if GET_ABI_MAJOR(ABI_XINPUT_VERSION) >= 12
 typedef InputInfoPtr LocalDevicePtr;
 #endif
@@ -45,11 +57,61 @@ typedef InputInfoPtr LocalDevicePtr;
 /* button mapping simplified */
 #define PROPMAP(m, x, y) m[x] = XIGetKnownProperty(y)
 
+static mlog_handler_fn log_message;
+
+static void log_message(int level, const char* format, va_list args)
+{
+	MessageType type = level == MLOG_ERROR ? X_ERROR :
+		level == MLOG_WARNING ? X_WARNING : X_INFO;
+	LogVMessageVerb(type, 1, format, args);
+}
+
+static int option_int(void* data, const char* name, int deflt)
+{
+	return xf86SetIntOption(data, name, deflt);
+}
+
+static int option_bool(void* data, const char* name, int deflt)
+{
+	return xf86SetBoolOption(data, name, deflt);
+}
+
+static double option_real(void* data, const char* name, double deflt)
+{
+	return xf86SetRealOption(data, name, deflt);
+}
+
+static void configure_options(struct MTouch* mt, pointer options)
+{
+	const struct MOptions opts = {
+		options, option_int, option_bool, option_real
+	};
+	char* path;
+	int ret;
+	mconfig_configure(&mt->cfg, &opts);
+	if (mt->flight) {
+		path = xf86SetStrOption(options, "FlightRecorderFile", FLIGHT_FILE);
+		flight_init(mt->flight, path);
+		free(path);
+	}
+	// Telemetry is only shared when asked for.
+	path = xf86SetStrOption(options, "TelemetryFile", NULL);
+	if (path) {
+		mt->telemetry = calloc(1, sizeof(struct MTelemetry));
+		ret = mt->telemetry ? telemetry_open(mt->telemetry, path) : -ENOMEM;
+		if (ret) {
+			xf86Msg(X_WARNING, "mtrack: could not share telemetry in %s: %s\n",
+				path, strerror(-ret));
+			free(mt->telemetry);
+			mt->telemetry = NULL;
+		}
+		free(path);
+	}
+}
+
 static void pointer_control(DeviceIntPtr dev, PtrCtrl *ctrl)
 {
-#if DEBUG_DRIVER
-	xf86Msg(X_INFO, "pointer_control\n");
-#endif
+	trace(TRACE_DRIVER, "pointer_control\n");
 }
 
 #if GET_ABI_MAJOR(ABI_XINPUT_VERSION) >= 7
@@ -154,11 +216,36 @@ static int device_init(DeviceIntPtr dev, LocalDevicePtr local)
 #endif
 	xf86InitValuatorDefaults(dev, 1);
 	mprops_init(&mt->cfg, local);
-	XIRegisterPropertyHandler(dev, mprops_set_property, NULL, NULL);
+	XIRegisterPropertyHandler(dev, mprops_set_property, mprops_get_property, NULL);
 
 	return Success;
 }
 
+/* Trace lines are logged from a timer so that the input path never waits
+ * for the log. One timer serves all devices, and it only runs while a
+ * device is on and tracing is enabled.
+ */
+static OsTimerPtr trace_timer;
+static int trace_devices;
+
+static CARD32 drain_trace(OsTimerPtr timer, CARD32 now, pointer arg)
+{
+	trace_drain();
+	return TRACE_DRAIN_MS;
+}
+
+void mtrack_trace_update(void)
+{
+	if (trace_devices > 0 && trace_mask) {
+		if (!trace_timer)
+			trace_timer = TimerSet(NULL, 0, TRACE_DRAIN_MS, drain_trace, NULL);
+	} else if (trace_timer) {
+		TimerFree(trace_timer);
+		trace_timer = NULL;
+		trace_drain();
+	}
+}
+
 static int device_on(LocalDevicePtr local)
 {
 	struct MTouch *mt = local->private;
@@ -172,6 +259,8 @@ static int device_on(LocalDevicePtr local)
 		return !Success;
 	}
 	xf86AddEnabledDevice(local);
+	trace_devices++;
+	mtrack_trace_update();
 	return Success;
 }
 
@@ -182,6 +271,8 @@ static int device_off(LocalDevicePtr local)
 	if (mtouch_close(mt))
 		xf86Msg(X_WARNING, "mtrack: cannot ungrab device\n");
 	xf86CloseSerial(local->fd);
+	trace_devices--;
+	mtrack_trace_update();
 	return Success;
 }
 
@@ -190,42 +281,28 @@ static int device_close(LocalDevicePtr local)
 	return Success;
 }
 
-static void handle_gestures(LocalDevicePtr local,
-			const struct Gestures* gs)
+static void post_button(void* data, int button, int down)
 {
-	static bitmask_t buttons_prev = 0U;
-	int i;
-
-	for (i = 0; i < 32; i++) {
-		if (GETBIT(gs->buttons, i) == GETBIT(buttons_prev, i))
-			continue;
-		if (GETBIT(gs->buttons, i)) {
-			xf86PostButtonEvent(local->dev, FALSE, i+1, 1, 0, 0);
-#if DEBUG_DRIVER
-			xf86Msg(X_INFO, "button %d down\n", i+1);
-#endif
-		}
-		else {
-			xf86PostButtonEvent(local->dev, FALSE, i+1, 0, 0, 0);
-#if DEBUG_DRIVER
-			xf86Msg(X_INFO, "button %d up\n", i+1);
-#endif
-		}
-	}
-	buttons_prev = gs->buttons;
+	LocalDevicePtr local = data;
+	xf86PostButtonEvent(local->dev, FALSE, button, down, 0, 0);
+	trace(TRACE_DRIVER, "button %d %s\n", button, down ? "down" : "up");
+}
 
-	if (gs->move_dx != 0 || gs->move_dy != 0)
-		xf86PostMotionEvent(local->dev, 0, 0, 2, gs->move_dx, gs->move_dy);
+static void post_motion(void* data, int dx, int dy)
+{
+	LocalDevicePtr local = data;
+	xf86PostMotionEvent(local->dev, 0, 0, 2, dx, dy);
 }
 
 /* called for each full received packet from the touchpad */
 static void read_input(LocalDevicePtr local)
 {
 	struct MTouch *mt = local->private;
+	const struct MSink sink = { local, post_button, post_motion, NULL };
 	while (mtouch_read(mt) > 0)
-		handle_gestures(local, &mt->gs);
+		mtouch_output(mt, &sink);
 	if (mtouch_delayed(mt))
-		handle_gestures(local, &mt->gs);
+		mtouch_output(mt, &sink);
 }
 
 static Bool device_control(DeviceIntPtr dev, int mode)
@@ -256,9 +333,13 @@ static int preinit(InputDriverPtr drv, InputInfoPtr pInfo, int flags)
 {
 	struct MTouch *mt;
 
-	mt = calloc(1, sizeof(*mt));
+	mt = mtouch_alloc();
 	if (!mt)
 		return BadAlloc;
+	// Latency statistics and the flight recorder are optional, the
+	// driver runs fine without.
+	mt->latency = calloc(1, sizeof(struct MLatency));
+	mt->flight = calloc(1, sizeof(struct FlightRecorder));
 
 	pInfo->private = mt;
 	pInfo->type_name = XI_TOUCHPAD;
@@ -269,7 +350,7 @@ static int preinit(InputDriverPtr drv, InputInfoPtr pInfo, int flags)
     xf86CollectInputOptions(pInfo, NULL);
     xf86OptionListReport(pInfo->options);
     xf86ProcessCommonOptions(pInfo, pInfo->options);
-    mconfig_configure(&mt->cfg, pInfo->options);
+    configure_options(mt, pInfo->options);
 
 	return Success;
 }
@@ -280,9 +361,11 @@ static InputInfoPtr preinit(InputDriverPtr drv, IDevPtr dev, int flags)
 	InputInfoPtr local = xf86AllocateInput(drv, 0);
 	if (!local)
 		goto error;
-	mt = calloc(1, sizeof(struct MTouch));
+	mt = mtouch_alloc();
 	if (!mt)
 		goto error;
+	mt->latency = calloc(1, sizeof(struct MLatency));
+	mt->flight = calloc(1, sizeof(struct FlightRecorder));
 
 	local->name = dev->identifier;
 	local->type_name = XI_TOUCHPAD;
@@ -295,7 +378,7 @@ static InputInfoPtr preinit(InputDriverPtr drv, IDevPtr dev, int flags)
 	xf86CollectInputOptions(local, NULL, NULL);
 	xf86OptionListReport(local->options);
 	xf86ProcessCommonOptions(local, local->options);
-	mconfig_configure(&mt->cfg, local->options);
+	configure_options(mt, local->options);
 
 	local->flags |= XI86_CONFIGURED;
  error:
@@ -305,8 +388,17 @@ static InputInfoPtr preinit(InputDriverPtr drv, IDevPtr dev, int flags)
 
 static void uninit(InputDriverPtr drv, InputInfoPtr local, int flags)
 {
-	free(local->private);
+	struct MTouch *mt = local->private;
+	if (mt) {
+		free(mt->latency);
+		free(mt->flight);
+		if (mt->telemetry)
+			telemetry_close(mt->telemetry);
+		free(mt->telemetry);
+	}
+	mtouch_free(mt);
 	local->private = 0;
+	mtrack_trace_update();
 	xf86DeleteInput(local, 0);
 }
 
@@ -335,6 +427,7 @@ static XF86ModuleVersionInfo moduleVersion = {
 
 static pointer setup(pointer module, pointer options, int *errmaj, int *errmin)
 {
+	mlog_set_handler(log_message);
 	xf86AddInputDriver(&MTRACK, module, 0);
 	return module;
 }
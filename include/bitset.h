@@ -0,0 +1,125 @@
+/***************************************************************************
+ *
+ * Multitouch X driver
+ * Copyright (C) 2008 Henrik Rydberg <rydberg@euromail.se>
+ * Copyright (C) 2011 Ryan Bourgeois <bluedragonx@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ **************************************************************************/
+
+#ifndef BITSET_H
+#define BITSET_H
+
+#include <stdint.h>
+#include <string.h>
+
+/* Sets of fingers, touches and buttons are arrays of 64-bit words held
+ * in a struct, so they can be assigned, compared and returned by value.
+ * Bits at or above the size of a set are always clear.
+ */
+typedef uint64_t bitword_t;
+
+#define BITWORD_BITS 64
+#define BITSET_WORDS(n) (((n) + BITWORD_BITS - 1) / BITWORD_BITS)
+#define BITSET(n) struct { bitword_t w[BITSET_WORDS(n)]; }
+
+#define BITSET_LEN(s) ((int)(sizeof((s).w) / sizeof(bitword_t)))
+#define BITWORD(x) ((bitword_t)1 << ((x) % BITWORD_BITS))
+
+#define bitset_get(s, x) ((int)(((s).w[(x) / BITWORD_BITS] >> ((x) % BITWORD_BITS)) & 1))
+#define bitset_set(s, x) ((s).w[(x) / BITWORD_BITS] |= BITWORD(x))
+#define bitset_clear(s, x) ((s).w[(x) / BITWORD_BITS] &= ~BITWORD(x))
+#define bitset_mod(s, x, b) ((b) ? bitset_set(s, x) : bitset_clear(s, x))
+#define bitset_zero(s) memset(&(s), 0, sizeof(s))
+
+/* Combine two sets word by word into d, which may be either of them.
+ */
+#define bitset_op(d, a, b, op) do {					\
+		int bitset_k_;						\
+		for (bitset_k_ = 0; bitset_k_ < BITSET_LEN(d); bitset_k_++)	\
+			(d).w[bitset_k_] = (a).w[bitset_k_] op (b).w[bitset_k_];	\
+	} while (0)
+#define bitset_and(d, a, b) bitset_op(d, a, b, &)
+#define bitset_or(d, a, b) bitset_op(d, a, b, |)
+#define bitset_xor(d, a, b) bitset_op(d, a, b, ^)
+#define bitset_andnot(d, a, b) bitset_op(d, a, b, & ~)
+
+/* Return 1 if any bit of the words is set.
+ */
+static inline int bitwords_any(const bitword_t* w, int len)
+{
+	int k;
+	for (k = 0; k < len; k++) {
+		if (w[k])
+			return 1;
+	}
+	return 0;
+}
+
+/* Count the bits set in the words.
+ */
+static inline int bitwords_count(const bitword_t* w, int len)
+{
+	int k, n = 0;
+	for (k = 0; k < len; k++)
+		n += __builtin_popcountll(w[k]);
+	return n;
+}
+
+/* Return the index of the first bit set at or after x, -1 if none.
+ */
+static inline int bitwords_next(const bitword_t* w, int len, int x)
+{
+	int k = x / BITWORD_BITS;
+	bitword_t v;
+	if (k >= len)
+		return -1;
+	v = w[k] & (~(bitword_t)0 << (x % BITWORD_BITS));
+	while (!v) {
+		if (++k >= len)
+			return -1;
+		v = w[k];
+	}
+	return k * BITWORD_BITS + __builtin_ctzll(v);
+}
+
+/* Return the index of the first clear bit below n, -1 if none.
+ */
+static inline int bitwords_first_zero(const bitword_t* w, int n)
+{
+	int k, x;
+	for (k = 0; k * BITWORD_BITS < n; k++) {
+		if (~w[k]) {
+			x = k * BITWORD_BITS + __builtin_ctzll(~w[k]);
+			return x < n ? x : -1;
+		}
+	}
+	return -1;
+}
+
+#define bitset_any(s) bitwords_any((s).w, BITSET_LEN(s))
+#define bitset_count(s) bitwords_count((s).w, BITSET_LEN(s))
+#define bitset_next(s, x) bitwords_next((s).w, BITSET_LEN(s), x)
+#define bitset_first_zero(s, n) bitwords_first_zero((s).w, n)
+#define bitset_equal(a, b) (memcmp(&(a), &(b), sizeof(a)) == 0)
+
+/* Iterate over the bits set in s, lowest first. Each step looks up the
+ * next bit in s as it is then, so clearing bit i in the loop is safe.
+ */
+#define foreach_bit(i, s)						\
+	for (i = bitset_next(s, 0); i >= 0; i = bitset_next(s, i + 1))
+
+#endif
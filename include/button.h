@@ -22,8 +22,17 @@
 #ifndef BUTTON_H
 #define BUTTON_H
 
+#include "bitset.h"
+
 #define DIM_BUTTON 15
 
+/* Gestures may press any of these buttons, X only sees the first
+ * DIM_BUTTON of them.
+ */
+#define MAX_BUTTONS 32
+
+typedef BITSET(MAX_BUTTONS) buttonset_t;
+
 #define MT_BUTTON_LEFT 0
 #define MT_BUTTON_MIDDLE 1
 #define MT_BUTTON_RIGHT 2
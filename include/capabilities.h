@@ -37,6 +37,9 @@ struct Capabilities {
 };
 
 int read_capabilities(struct Capabilities *cap, int fd);
+int match_capabilities(const struct Capabilities *cap, int fd);
+void copy_mtdev_capabilities(struct mtdev_caps *mtcaps,
+			const struct Capabilities *cap);
 int get_cap_xsize(const struct Capabilities *cap);
 int get_cap_ysize(const struct Capabilities *cap);
 int get_cap_wsize(const struct Capabilities *cap);
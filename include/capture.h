@@ -0,0 +1,101 @@
+/***************************************************************************
+ *
+ * Multitouch X driver
+ * Copyright (C) 2008 Henrik Rydberg <rydberg@euromail.se>
+ * Copyright (C) 2011 Ryan Bourgeois <bluedragonx@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ **************************************************************************/
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include "common.h"
+#include "capabilities.h"
+
+/* Capture files hold the capabilities of a device followed by the raw
+ * evdev events it produced. All fields are little-endian.
+ *
+ *   header   "MTRC", u32 version
+ *   caps     u16 bustype, vendor, product, version
+ *            char devname[32]
+ *            s32 has_left, has_middle, has_right, has_mtdata, has_ibt
+ *            s32 has_slot, absinfo slot
+ *            u32 naxes, then naxes times s32 has_abs, absinfo abs
+ *   events   s64 time in microseconds, u16 type, u16 code, s32 value
+ *
+ * where absinfo is six s32: value, minimum, maximum, fuzz, flat and
+ * resolution.
+ */
+#define CAPTURE_MAGIC "MTRC"
+#define CAPTURE_VERSION 1
+#define CAPTURE_EVENT_SIZE 16
+
+/* Replay as fast as possible or at the pace of the recording.
+ */
+#define CAPTURE_FAST 0
+#define CAPTURE_REALTIME 1
+
+struct CaptureWriter {
+	FILE* file;
+};
+
+struct CaptureReader {
+	struct Capabilities caps;
+	struct input_event* events;
+	size_t count;
+	size_t pos;
+	int mode;
+	int frame_end;		// Last event returned ended a frame.
+	struct timeval start;	// Wall time of the first event in realtime mode.
+};
+
+/* Create a capture file for a device with the given capabilities.
+ * Returns 0 on success or a negative errno.
+ */
+int capture_create(struct CaptureWriter* w, const char* path,
+			const struct Capabilities* caps);
+
+/* Append an event. Returns 0 on success or a negative errno.
+ */
+int capture_write(struct CaptureWriter* w, const struct input_event* ev);
+
+int capture_close(struct CaptureWriter* w);
+
+/* Load a capture file into memory for replay. Returns 0 on success,
+ * -EINVAL if the file is not a capture or a negative errno.
+ */
+int capture_open(struct CaptureReader* r, const char* path, int mode);
+
+/* Fetch the next event. Returns 1 on success and 0 at the end of the
+ * capture. Like a non-blocking device, the reader returns -EAGAIN once
+ * after every frame so the caller gets to run its timers in between.
+ */
+int capture_read(struct CaptureReader* r, struct input_event* ev);
+
+/* Wait for a timer that expires at until, or for the next event if it
+ * comes first. The time the wait ended is placed in now.
+ */
+void capture_wait(struct CaptureReader* r, const struct timeval* until,
+			struct timeval* now);
+
+/* Start the replay over from the first event.
+ */
+void capture_rewind(struct CaptureReader* r);
+
+void capture_free(struct CaptureReader* r);
+
+#endif
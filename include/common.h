@@ -27,22 +27,42 @@
 #include "config.h"
 #endif
 
-#include <xorg-server.h>
-#include <xf86.h>
-#include <xf86_OSproc.h>
-#include <xf86Xinput.h>
 #include <errno.h>
 #include <mtdev-mapping.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
 #include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
 
+#include "bitset.h"
+#include "mlog.h"
+
+/* The number of slots and touches tracked. Configure sets these with
+ * --with-max-contacts, any value works but multiples of 8 waste nothing.
+ */
+#ifndef DIM_FINGER
 #define DIM_FINGER 32
+#endif
+#ifndef DIM_TOUCHES
 #define DIM_TOUCHES 32
+#endif
+
+typedef BITSET(DIM_FINGER) fingerset_t;
+typedef BITSET(DIM_TOUCHES) touchset_t;
+
+/* Size of a cache line, and the alignment of data that should start one. */
+#define CACHELINE 64
+#define CACHE_ALIGNED __attribute__((aligned(CACHELINE)))
 
 /* year-proof millisecond event time */
 typedef __u64 mstime_t;
 
-/* all bit masks have this type */
+/* small bit masks of flags have this type, sets of fingers, touches and
+ * buttons are bitsets */
 typedef unsigned int bitmask_t;
 
 #define BITMASK(x) (1U << (x))
@@ -66,6 +86,15 @@ static inline void microtime(struct timeval* tv)
 	gettimeofday(tv, NULL);
 }
 
+/* Read a monotonic clock in nanoseconds, for profiling.
+ */
+static inline uint64_t nanotime(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
 /* Copy one time value to another.
  */
 static inline void timercp(struct timeval* dest, const struct timeval* src)
@@ -121,24 +150,6 @@ static inline int dist2(int dx, int dy)
 	return dx * dx + dy * dy;
 }
 
-/* Count number of bits (Sean Eron Andersson's Bit Hacks).
- */
-static inline int bitcount(unsigned v)
-{
-	v -= ((v>>1) & 0x55555555);
-	v = (v&0x33333333) + ((v>>2) & 0x33333333);
-	return (((v + (v>>4)) & 0xF0F0F0F) * 0x1010101) >> 24;
-}
-
-/* Return index of first bit [0-31], -1 on zero\
- */
-#define firstbit(v) (__builtin_ffs(v) - 1)
-
-/* Boost-style foreach bit.
- */
-#define foreach_bit(i, m)						\
-	for (i = firstbit(m); i >= 0; i = firstbit((m) & (~0U << i + 1)))
-
 /* Robust system ioctl calls.
  */
 #define SYSCALL(call) while (((call) == -1) && (errno == EINTR))
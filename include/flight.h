@@ -0,0 +1,148 @@
+/***************************************************************************
+ *
+ * Multitouch X driver
+ * Copyright (C) 2008 Henrik Rydberg <rydberg@euromail.se>
+ * Copyright (C) 2011 Ryan Bourgeois <bluedragonx@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ **************************************************************************/
+
+#ifndef FLIGHT_H
+#define FLIGHT_H
+
+#include "common.h"
+#include "gestures.h"
+#include "mtstate.h"
+
+/* The flight recorder keeps the last FLIGHT_SIZE raw events, gesture
+ * decisions and pipeline stage timings in memory so that a misbehaving
+ * gesture can be looked at after the fact. Recording is a handful of
+ * stores; nothing is formatted or written out until the recorder is
+ * saved.
+ */
+#define FLIGHT_SIZE 8192
+
+/* Kinds of records. For events, code and value are those of the event
+ * and arg its type. For move transitions, code is the new move type,
+ * value the old one and arg the direction. For buttons, code is the
+ * button and value 1 when pressed. For invalidated touches, code is the
+ * touch, value its tracking id and arg its MT_* state bits. For spans,
+ * code is the FLIGHT_STAGE_*, value its duration in nanoseconds and arg
+ * the nanoseconds past time at which it started.
+ */
+#define FLIGHT_EVENT 0
+#define FLIGHT_MOVE 1
+#define FLIGHT_BUTTON 2
+#define FLIGHT_INVALID 3
+#define FLIGHT_SPAN 4
+
+/* Pipeline stages timed by spans, the same as the MTOUCH_STAGE_* with
+ * the output of a frame added.
+ */
+#define FLIGHT_STAGE_HWSTATE 0
+#define FLIGHT_STAGE_MTSTATE 1
+#define FLIGHT_STAGE_GESTURES 2
+#define FLIGHT_STAGE_POST 3
+
+/* Formats flight_save can write.
+ */
+#define FLIGHT_TEXT 1
+#define FLIGHT_CHROME 2
+
+struct FlightRecord {
+	int64_t time;		// Microseconds, CLOCK_MONOTONIC for spans and
+				// the evdev clock, CLOCK_REALTIME, otherwise.
+	uint16_t kind;
+	uint16_t code;
+	int32_t value;
+	int32_t arg;
+};
+
+/* Written by the input path only. Readers copy the ring and use the head
+ * to drop records that were overwritten while they copied.
+ */
+struct FlightRecorder {
+	uint64_t head;
+	struct FlightRecord ring[FLIGHT_SIZE];
+
+	// Gesture state as of the last recorded decision.
+	int move_type;
+	buttonset_t buttons;
+	touchset_t invalid;
+
+	char path[256];		// Prefix of the files flight_save writes.
+};
+
+static inline void flight_record(struct FlightRecorder* fr, const struct timeval* time,
+				int kind, int code, int value, int arg)
+{
+	uint64_t head = fr->head;
+	struct FlightRecord* r = &fr->ring[head & (FLIGHT_SIZE - 1)];
+	r->time = (int64_t)time->tv_sec * 1000000 + time->tv_usec;
+	r->kind = kind;
+	r->code = code;
+	r->value = value;
+	r->arg = arg;
+	__atomic_store_n(&fr->head, head + 1, __ATOMIC_RELEASE);
+}
+
+static inline void flight_event(struct FlightRecorder* fr, const struct input_event* ev)
+{
+	flight_record(fr, &ev->time, FLIGHT_EVENT, ev->code, ev->value, ev->type);
+}
+
+/* Record a stage that started at start and took ns, both as returned by
+ * nanotime.
+ */
+static inline void flight_span(struct FlightRecorder* fr, int stage, uint64_t start, uint64_t ns)
+{
+	struct timeval tv;
+	tv.tv_sec = start / 1000000000;
+	tv.tv_usec = start / 1000 % 1000000;
+	flight_record(fr, &tv, FLIGHT_SPAN, stage, (int32_t)MINVAL(ns, INT32_MAX), start % 1000);
+}
+
+void flight_init(struct FlightRecorder* fr, const char* path);
+
+/* Record whatever the gestures decided since the last call: move type
+ * transitions, button edges and newly invalidated touches.
+ */
+void flight_decisions(struct FlightRecorder* fr, const struct Gestures* gs,
+			const struct MTState* ms);
+
+/* Write the recorded history as text, oldest first. Returns the number
+ * of records written.
+ */
+int flight_dump(const struct FlightRecorder* fr, FILE* file);
+
+/* Write the recorded history in the Chrome trace event format, which
+ * chrome://tracing and Perfetto load. Stages become spans, everything
+ * else instant events, on one track each for the pipeline, the gestures
+ * and the raw events. All timestamps are converted to CLOCK_MONOTONIC,
+ * the clock compositors trace with. Returns the number of records
+ * written.
+ */
+int flight_export(const struct FlightRecorder* fr, FILE* file);
+
+/* Write to a new file in a FLIGHT_* format. The file is named after the
+ * path of the recorder with a unique part and ".log" or ".json" appended,
+ * is only readable by its owner and never replaces an existing file. Its
+ * name is stored in saved. Returns the number of records written or a
+ * negative errno.
+ */
+int flight_save(const struct FlightRecorder* fr, int format, char* saved, size_t size);
+
+#endif
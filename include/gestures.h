@@ -49,12 +49,20 @@ struct Gestures {
 	 * If a bit is not set, the button is up.
 	 * Bit 0 is button 1.
 	 */
-	bitmask_t buttons;
+	buttonset_t buttons;
 
 	/* Pointer movement is tracked here.
 	 */
 	int move_dx, move_dy;
 
+	/* Two finger geometry, relative to when the pair was put down. The
+	 * scale is the distance between the fingers over the distance they
+	 * started at, the angle is how far the line between them has turned
+	 * clockwise, in radians. 1 and 0 while there is no pair.
+	 */
+	double pinch_scale;
+	double pinch_angle;
+
 	/* Current time and time delta. Updated after each event and after sleeping.
 	 */
 	struct timeval time;
@@ -62,6 +70,7 @@ struct Gestures {
 
 	/* Internal state tracking. Not for direct access.
 	 */
+	buttonset_t button_prev;
 	int button_emulate;
 	int button_delayed;
 	struct timeval button_delayed_time;
@@ -81,12 +90,42 @@ struct Gestures {
 	struct timeval move_wait;
 	struct timeval move_drag_wait;
 	struct timeval move_drag_expire;
+
+	int pinch_id[2];	// Tracking ids of the pair, -1 if none.
+	double pinch_start;	// Distance between the pair when it was put down.
+	double pinch_dist;	// Distance and angle in the last frame.
+	double pinch_turn;
+	double pinch_radial;	// Change per finger not yet fed to a gesture.
+	double pinch_arc;
 };
 
 
 void gestures_init(struct MTouch* mt);
+
+/* Reset accumulated gesture state after the configuration changed.
+ */
+void gestures_reconfigure(struct MTouch* mt);
 void gestures_extract(struct MTouch* mt);
+
+/* Advance the gesture timers for a frame in which no touch or button
+ * changed.
+ */
+void gestures_idle(struct MTouch* mt);
+
+/* Follow the physical buttons while the trackpad is fully disabled so
+ * that nothing fires when it is enabled again.
+ */
+void gestures_disabled(struct MTouch* mt);
+
+/* Wait for the delayed button, then release it. Returns 1 if it was
+ * released.
+ */
 int gestures_delayed(struct MTouch* mt);
 
+/* Release the delayed button if it is due at now, without waiting.
+ * Returns 1 if it was released.
+ */
+int gestures_expire(struct MTouch* mt, const struct timeval* now);
+
 #endif
 
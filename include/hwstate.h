@@ -33,20 +33,38 @@ struct FingerState {
 	int tracking_id;
 };
 
+/* The range each axis is clamped to, taken from the capabilities so that
+ * events can be applied without reaching into them.
+ */
+struct AbsRange {
+	int minimum, maximum;
+};
+
+/* Everything every event touches comes first, the slots follow.
+ */
 struct HWState {
+	fingerset_t used;
+	fingerset_t dirty;	// Slots changed by the last frame.
+	fingerset_t pending;	// Slots changed by the frame being read.
+	buttonset_t button;
+	buttonset_t button_dirty;	// Buttons changed by the last frame.
+	buttonset_t button_prev;	// Buttons at the end of the last frame.
+	int slot;
+	bitmask_t copy_minor;	// Minor axes taken from the major ones.
+	struct timeval evtime;
+	struct AbsRange range[MT_ABS_SIZE];
 	struct FingerState data[DIM_FINGER];
-	bitmask_t used;
-	bitmask_t slot;
-	bitmask_t button;
 	int max_x, max_y;
-	struct timeval evtime;
+	uint64_t dropped;	// SYN_DROPPED reports so far.
 };
 
 void hwstate_init(struct HWState *s,
 			const struct Capabilities *caps);
-int hwstate_modify(struct HWState *s,
-			struct mtdev *dev, int fd,
-			const struct Capabilities *caps);
+
+/* Apply a single event. Returns 1 when the event completes a frame.
+ */
+int hwstate_process(struct HWState *s,
+			const struct input_event *ev);
 void hwstate_output(const struct HWState *s);
 
 int find_finger(const struct HWState *s, int tracking_id);
@@ -0,0 +1,107 @@
+/***************************************************************************
+ *
+ * Multitouch X driver
+ * Copyright (C) 2008 Henrik Rydberg <rydberg@euromail.se>
+ * Copyright (C) 2011 Ryan Bourgeois <bluedragonx@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ **************************************************************************/
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include "common.h"
+
+/* Log-linear latency histograms in the spirit of HdrHistogram. Values
+ * below LATENCY_SUB are counted exactly, larger values fall into one of
+ * LATENCY_SUB buckets per power of two, so every bucket is within 1/8 of
+ * its value. Values are in nanoseconds and saturate at about 2^40.
+ */
+#define LATENCY_SUB_BITS 3
+#define LATENCY_SUB (1 << LATENCY_SUB_BITS)
+#define LATENCY_MAX_BITS 40
+#define LATENCY_BUCKETS ((LATENCY_MAX_BITS - LATENCY_SUB_BITS + 1) * LATENCY_SUB)
+
+/* Stages of a frame. Ingest runs from the kernel timestamp of the frame
+ * to the end of its assembly, state and gesture are the time spent in
+ * mtstate and gestures, post is the time spent delivering the output and
+ * total runs from the kernel timestamp to the end of the post. Delayed is
+ * how late delayed clicks were released.
+ */
+#define LATENCY_INGEST 0
+#define LATENCY_STATE 1
+#define LATENCY_GESTURE 2
+#define LATENCY_POST 3
+#define LATENCY_TOTAL 4
+#define LATENCY_DELAYED 5
+#define LATENCY_STAGES 6
+
+/* Histograms are written by the input path and read elsewhere without
+ * locking; a reader may see a sample counted in one field but not yet in
+ * another, which is harmless for statistics.
+ */
+struct LatencyHistogram {
+	uint64_t count;
+	uint64_t sum;
+	uint64_t max;
+	uint64_t last;
+	uint32_t buckets[LATENCY_BUCKETS];
+};
+
+struct MLatency {
+	struct LatencyHistogram stage[LATENCY_STAGES];
+};
+
+/* Bucket of a value.
+ */
+static inline int latency_bucket(uint64_t ns)
+{
+	int msb, shift;
+	if (ns < LATENCY_SUB)
+		return (int)ns;
+	msb = 63 - __builtin_clzll(ns);
+	if (msb >= LATENCY_MAX_BITS)
+		return LATENCY_BUCKETS - 1;
+	shift = msb - LATENCY_SUB_BITS;
+	return (shift + 1) * LATENCY_SUB + (int)((ns >> shift) & (LATENCY_SUB - 1));
+}
+
+static inline void latency_record(struct LatencyHistogram* h, uint64_t ns)
+{
+	h->buckets[latency_bucket(ns)]++;
+	h->count++;
+	h->sum += ns;
+	h->last = ns;
+	if (ns > h->max)
+		h->max = ns;
+}
+
+/* Largest value that falls into a bucket.
+ */
+uint64_t latency_bucket_value(int bucket);
+
+/* Value at or below which a fraction p of the samples fall, rounded up to
+ * the bucket it is in. Returns 0 for an empty histogram.
+ */
+uint64_t latency_percentile(const struct LatencyHistogram* h, double p);
+
+const char* latency_stage_name(int stage);
+
+/* Print count, mean, p50, p90, p99 and max of every stage.
+ */
+void latency_print(FILE* file, const struct MLatency* lat);
+
+#endif
@@ -23,6 +23,7 @@
 #define MCONFIG_H
 
 #include "capabilities.h"
+#include "moptions.h"
 
 #define DEFAULT_TRACKPAD_DISABLE 0
 #define DEFAULT_TOUCH_DOWN 5
@@ -73,6 +74,7 @@
 #define DEFAULT_ROTATE_DIST 150
 #define DEFAULT_ROTATE_LT_BTN 14
 #define DEFAULT_ROTATE_RT_BTN 15
+#define DEFAULT_PINCH_THRESHOLD 20
 #define DEFAULT_DRAG_ENABLE 1
 #define DEFAULT_DRAG_TIMEOUT 350
 #define DEFAULT_DRAG_WAIT 40
@@ -157,6 +159,7 @@ struct MConfig {
 	int rotate_dist;		// Distance needed to trigger a button. >= 0, 0 disables
 	int rotate_lt_btn;		// Button to use for rotate left. >= 0, 0 is none
 	int rotate_rt_btn;		// Button to use for rotate right. >= 0, 0 is none
+	int pinch_threshold;		// Change between two fingers that starts a scale or rotate. >= 1
 	int drag_enable;		// Enable tap-to-drag? 0 or 1
 	int drag_timeout;		// How long to wait for a move after tapping? > 0
 	int drag_wait;			// How long to wait before triggering button down? >= 0
@@ -164,6 +167,25 @@ struct MConfig {
 	double sensitivity;		// Mouse movement multiplier. >= 0
 };
 
+/* Values that only depend on MConfig and Capabilities but would otherwise
+ * be recomputed on every frame. Compiled by mconfig_compile() whenever the
+ * configuration is published and used by MTState and Gestures. Kept to
+ * a single cache line.
+ */
+struct MConfigDerived {
+	int x_offset, x_scale;	// Touch x position is x_offset + x_scale*x. Applies axis inversion.
+	int y_offset, y_scale;	// Touch y position is y_offset + y_scale*y. Applies axis inversion.
+	int touch_min;		// Minimum touch value.
+	int touch_span;		// Range of touch values.
+	int bottom_edge;	// New touches below this y position are ignored.
+	int tap_dist;		// Square of the tap distance.
+	int drag_dist;		// Square of the drag distance.
+	int tap_max;		// Most touches that make up a tap. 0 if tapping is disabled.
+	int zone_count;		// Number of button emulation zones.
+	int zone_offset;	// Offset from a touch x position to a zone position.
+	int zone_right[3];	// Right edge of each button zone. The left edge of zone n is the right of n-1.
+};
+
 /* Load the MConfig struct with its defaults.
  */
 void mconfig_defaults(struct MConfig* cfg);
@@ -173,8 +195,17 @@ void mconfig_defaults(struct MConfig* cfg);
 void mconfig_init(struct MConfig* cfg,
 			const struct Capabilities* caps);
 
+/* Load the MConfig struct from user options, falling back to the defaults
+ * for anything that is not set.
+ */
 void mconfig_configure(struct MConfig* cfg,
-			pointer opts);
+			const struct MOptions* opts);
+
+/* Compile the derived values of a configuration.
+ */
+void mconfig_compile(struct MConfigDerived* drv,
+			const struct MConfig* cfg,
+			const struct Capabilities* caps);
 
 #endif
 
@@ -0,0 +1,58 @@
+/***************************************************************************
+ *
+ * Multitouch X driver
+ * Copyright (C) 2008 Henrik Rydberg <rydberg@euromail.se>
+ * Copyright (C) 2011 Ryan Bourgeois <bluedragonx@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ **************************************************************************/
+
+#ifndef MLOG_H
+#define MLOG_H
+
+#include <stdarg.h>
+
+#define MLOG_INFO 0
+#define MLOG_WARNING 1
+#define MLOG_ERROR 2
+
+/* Receives every message logged by the core. The Xorg driver forwards
+ * these to the server log, the tools default to stderr. Declare handlers
+ * with mlog_handler_fn so that they get the format checks.
+ */
+typedef void mlog_handler_fn(int level, const char* format, va_list args)
+	__attribute__((format(printf, 2, 0)));
+typedef mlog_handler_fn* mlog_handler_t;
+
+/* The default handler, writing everything to stderr.
+ */
+mlog_handler_fn mlog_stderr;
+
+/* Write only errors to stderr, for tools whose own output would drown
+ * in the messages of the core.
+ */
+mlog_handler_fn mlog_quiet;
+
+/* Replace the log handler. Passing NULL restores the stderr handler.
+ */
+void mlog_set_handler(mlog_handler_t handler);
+
+/* Log a message through the current handler.
+ */
+void mlog(int level, const char* format, ...)
+	__attribute__((format(printf, 2, 3)));
+
+#endif
@@ -0,0 +1,83 @@
+/***************************************************************************
+ *
+ * Multitouch X driver
+ * Copyright (C) 2008 Henrik Rydberg <rydberg@euromail.se>
+ * Copyright (C) 2011 Ryan Bourgeois <bluedragonx@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ **************************************************************************/
+
+#ifndef MOPTIONS_H
+#define MOPTIONS_H
+
+/* Source of user options. Each getter returns the named option or deflt
+ * when it is not set. The Xorg driver wraps the InputClass options; the
+ * tools provide their own.
+ */
+struct MOptions {
+	void* data;
+	int (*get_int)(void* data, const char* name, int deflt);
+	int (*get_bool)(void* data, const char* name, int deflt);
+	double (*get_real)(void* data, const char* name, double deflt);
+};
+
+static inline int moptions_int(const struct MOptions* opts, const char* name, int deflt)
+{
+	return opts && opts->get_int ? opts->get_int(opts->data, name, deflt) : deflt;
+}
+
+static inline int moptions_bool(const struct MOptions* opts, const char* name, int deflt)
+{
+	return opts && opts->get_bool ? opts->get_bool(opts->data, name, deflt) : deflt;
+}
+
+static inline double moptions_real(const struct MOptions* opts, const char* name, double deflt)
+{
+	return opts && opts->get_real ? opts->get_real(opts->data, name, deflt) : deflt;
+}
+
+#define MOPTIONS_MAX 128
+#define MOPTIONS_NAME_LEN 32
+#define MOPTIONS_VALUE_LEN 32
+
+/* A simple option store for the tools. Options use the same names as in
+ * xorg.conf and are matched case-insensitively.
+ */
+struct MOptionStore {
+	int count;
+	struct {
+		char name[MOPTIONS_NAME_LEN];
+		char value[MOPTIONS_VALUE_LEN];
+	} items[MOPTIONS_MAX];
+};
+
+/* Set an option from a "Name=Value" string, replacing any earlier value.
+ * Returns 0 on success or -EINVAL if the string is malformed or the store
+ * is full.
+ */
+int moptions_parse(struct MOptionStore* store, const char* option);
+
+/* Read options from a file with one "Name=Value" per line. Blank lines
+ * and lines starting with # are skipped. Returns 0 on success or a
+ * negative errno.
+ */
+int moptions_load(struct MOptionStore* store, const char* path);
+
+/* Point opts at the store.
+ */
+void moptions_bind(struct MOptions* opts, const struct MOptionStore* store);
+
+#endif
@@ -50,7 +50,7 @@
 #define MTRACK_PROP_BUTTON_EMULATE_VALUES "Trackpad Button Emulation Values"
 // int, 3 values - click time, touch timeout, invalidate distance
 #define MTRACK_PROP_TAP_SETTINGS "Trackpad Tap Settings"
-// int, 3 values - 1 touch button, 2 touch button, 3 touch button, 4 touch button
+// int, 4 values - 1 touch button, 2 touch button, 3 touch button, 4 touch button
 #define MTRACK_PROP_TAP_EMULATE "Trackpad Tap Button Emulation"
 // int, 2 values - ignore thumb touches, disable trackpad on thumb touches
 #define MTRACK_PROP_THUMB_DETECT "Trackpad Thumb Detection"
@@ -86,42 +86,93 @@
 #define MTRACK_PROP_DRAG_SETTINGS "Trackpad Drag Settings"
 // int, 2 values - invert x axis, invert y axis
 #define MTRACK_PROP_AXIS_INVERT "Trackpad Axis Inversion"
+// int, 1 value - percent of the bottom of the trackpad ignored for new touches
+#define MTRACK_PROP_BOTTOM_EDGE "Trackpad Bottom Edge"
+// int, 1 value - change between two fingers that starts a scale or rotate
+#define MTRACK_PROP_PINCH_THRESHOLD "Trackpad Pinch Threshold"
+
+// int, N values - blob version followed by the values of every property
+// above in the order listed, sensitivity in thousandths
+#define MTRACK_PROP_CONFIG_BLOB "Trackpad Config Blob"
+
+#define MTRACK_CONFIG_BLOB_VERSION 2
+
+// int, 5 values per latency stage - count, p50, p90, p99 and max in
+// nanoseconds, for ingest, state, gesture, post, total and delayed clicks;
+// read only
+#define MTRACK_PROP_LATENCY "Trackpad Latency"
+// int, 1 value - write 1 to save the flight recorder as text, or 2 to
+// save it as a Chrome trace, to a new file named after FlightRecorderFile
+#define MTRACK_PROP_FLIGHT "Trackpad Flight Recorder"
+// int, 1 value - mask of the TRACE_* categories to log, shared by all
+// devices
+#define MTRACK_PROP_TRACE "Trackpad Trace Categories"
+
+/* Property indexes. These match the order of the property definitions
+ * above and of the values in the config blob.
+ */
+#define MPROP_TRACKPAD_DISABLE 0
+#define MPROP_SENSITIVITY 1
+#define MPROP_PRESSURE 2
+#define MPROP_BUTTON_SETTINGS 3
+#define MPROP_BUTTON_EMULATE_SETTINGS 4
+#define MPROP_BUTTON_EMULATE_VALUES 5
+#define MPROP_TAP_SETTINGS 6
+#define MPROP_TAP_EMULATE 7
+#define MPROP_THUMB_DETECT 8
+#define MPROP_THUMB_SIZE 9
+#define MPROP_PALM_DETECT 10
+#define MPROP_PALM_SIZE 11
+#define MPROP_GESTURE_SETTINGS 12
+#define MPROP_SCROLL_DIST 13
+#define MPROP_SCROLL_BUTTONS 14
+#define MPROP_SWIPE_DIST 15
+#define MPROP_SWIPE_BUTTONS 16
+#define MPROP_SWIPE4_DIST 17
+#define MPROP_SWIPE4_BUTTONS 18
+#define MPROP_SCALE_DIST 19
+#define MPROP_SCALE_BUTTONS 20
+#define MPROP_ROTATE_DIST 21
+#define MPROP_ROTATE_BUTTONS 22
+#define MPROP_DRAG_SETTINGS 23
+#define MPROP_AXIS_INVERT 24
+#define MPROP_BOTTOM_EDGE 25
+#define MPROP_PINCH_THRESHOLD 26
+#define MPROP_COUNT 27
+#define MPROP_CONFIG_BLOB MPROP_COUNT
+#define MPROP_LATENCY (MPROP_COUNT + 1)
+#define MPROP_FLIGHT (MPROP_COUNT + 2)
+#define MPROP_TRACE (MPROP_COUNT + 3)
+#define MPROP_ATOMS (MPROP_COUNT + 4)
+
+struct MPropIndex {
+	Atom atom;
+	int index;
+};
 
 struct MProps {
 	// Properties Config
 	Atom float_type;
 
-	// Adjustable Properties
-	Atom api;
-	Atom trackpad_disable;
-	Atom sensitivity;
-	Atom pressure;
-	Atom button_settings;
-	Atom button_emulate_settings;
-	Atom button_emulate_values;
-	Atom tap_settings;
-	Atom tap_emulate;
-	Atom thumb_detect;
-	Atom thumb_size;
-	Atom palm_detect;
-	Atom palm_size;
-	Atom gesture_settings;
-	Atom scroll_dist;
-	Atom scroll_buttons;
-	Atom swipe_dist;
-	Atom swipe_buttons;
-	Atom swipe4_dist;
-	Atom swipe4_buttons;
-	Atom scale_dist;
-	Atom scale_buttons;
-	Atom rotate_dist;
-	Atom rotate_buttons;
-	Atom drag_settings;
-	Atom axis_invert;
+	// Properties, indexed by MPROP_*
+	Atom atoms[MPROP_ATOMS];
+
+	// Atom to index lookup, sorted by atom
+	struct MPropIndex lookup[MPROP_ATOMS];
+	int nlookup;
+
+	// Set while the driver updates its own properties
+	int updating;
 };
 
 void mprops_init(struct MConfig* cfg, InputInfoPtr local);
 int mprops_set_property(DeviceIntPtr dev, Atom property, XIPropertyValuePtr prop, BOOL checkonly);
+int mprops_get_property(DeviceIntPtr dev, Atom property);
+
+/* Start the trace drain timer while a device is on and tracing is
+ * enabled, and stop it otherwise. Defined in mtrack.c.
+ */
+void mtrack_trace_update(void);
 
 #endif
 
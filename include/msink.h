@@ -0,0 +1,39 @@
+/***************************************************************************
+ *
+ * Multitouch X driver
+ * Copyright (C) 2008 Henrik Rydberg <rydberg@euromail.se>
+ * Copyright (C) 2011 Ryan Bourgeois <bluedragonx@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ **************************************************************************/
+
+#ifndef MSINK_H
+#define MSINK_H
+
+/* Receives the output of the gesture engine. Buttons are numbered from 1
+ * as in X and are only reported when their state changes. Motion is
+ * relative and only reported when non-zero. If set, flush is called
+ * after the output of a frame that reported anything, for sinks that
+ * batch a frame into one write.
+ */
+struct MSink {
+	void* data;
+	void (*button)(void* data, int button, int down);
+	void (*motion)(void* data, int dx, int dy);
+	void (*flush)(void* data);
+};
+
+#endif
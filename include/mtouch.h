@@ -29,22 +29,133 @@
 #include "mtstate.h"
 #include "mconfig.h"
 #include "gestures.h"
+#include "msink.h"
+#include "capture.h"
+#include "latency.h"
+#include "flight.h"
+#include "telemetry.h"
 
+#define MTOUCH_STAGE_HWSTATE 0
+#define MTOUCH_STAGE_MTSTATE 1
+#define MTOUCH_STAGE_GESTURES 2
+#define MTOUCH_STAGES 3
+
+/* Time spent in each stage of mtouch_read, collected when a profile is
+ * attached to the MTouch.
+ */
+struct MTouchProfile {
+	uint64_t frames;
+	uint64_t ns[MTOUCH_STAGES];
+};
+
+/* A published configuration and the values derived from it.
+ */
+#define MCONFIG_BUFFERS 3
+#define MCONFIG_FRESH 0x4	// Set on cfg_shared by a publication not yet taken.
+struct MConfigPub {
+	struct MConfig cfg;
+	struct MConfigDerived drv;
+} CACHE_ALIGNED;
+
+/* All pipeline state lives in the MTouch, so separate instances may run
+ * on separate threads. Only the log handler and the trace ring are shared
+ * by the whole process.
+ *
+ * Whatever every frame reads or writes is packed at the start, in the
+ * order a frame uses it, and the rest is moved out of its way. The
+ * struct is cache line aligned, so allocate it with mtouch_alloc.
+ */
 struct MTouch {
+	/* Hot: used by every frame.
+	 */
 	int fd;
-	struct mtdev dev;
-	struct Capabilities caps;
+	int latency_frame;		// The frame read last has not been posted.
+	unsigned int cfg_shared;	// Exchanged with the publisher, rarely.
+	int cfg_front;			// Buffer read by frames.
+	struct CaptureReader* replay;	// Read events from here instead of dev.
+	struct CaptureWriter* record;	// Copy every event read to here.
+	const struct MConfig* cfg_live;
+	const struct MConfigDerived* drv_live;
+	struct MTouchProfile* profile;	// Optional, collects stage timings.
+	struct MLatency* latency;	// Optional, collects latency histograms.
+	struct FlightRecorder* flight;	// Optional, keeps recent history.
+	struct MTelemetry* telemetry;	// Optional, shares live state.
+	buttonset_t buttons_posted;
+	struct Gestures gs;
 	struct HWState hs;
 	struct MTState state;
-	struct MConfig cfg;
-	struct Gestures gs;
-};
+
+	/* Configuration is staged in cfg by options and properties and then
+	 * published into the pub buffers along with its derived values. Each
+	 * buffer belongs to one side at a time: the publisher writes its back
+	 * buffer and swaps it with the shared one, and at the start of a frame
+	 * the input path swaps its front buffer with the shared one if that
+	 * holds a fresh publication. A frame never sees a partially applied
+	 * change however often the publisher runs, and the publisher writes
+	 * on lines of its own.
+	 */
+	struct MConfigPub pub[MCONFIG_BUFFERS];
+
+	/* Cold: only used to open, close and reconfigure.
+	 */
+	struct MConfig cfg CACHE_ALIGNED;
+	int cfg_back;			// Buffer written by the publisher.
+	struct Capabilities caps;
+	int caps_valid;
+	int grab;			// Grab the device while open.
+	struct mtdev dev;
+} CACHE_ALIGNED;
+
+/* Clear an MTouch and hand its configuration buffers out as publication
+ * expects. Use this, not memset, to reuse an MTouch that is not in use.
+ */
+void mtouch_init(struct MTouch* mt);
+
+/* Allocate a cleared, suitably aligned MTouch. Release it with
+ * mtouch_free.
+ */
+struct MTouch* mtouch_alloc(void);
+void mtouch_free(struct MTouch* mt);
 
 int mtouch_configure(struct MTouch* mt, int fd);
+
+/* Open the device on fd. If grab is set, nothing else gets its events
+ * until mtouch_close.
+ */
 int mtouch_open(struct MTouch* mt, int fd);
+
+/* Open a recorded capture in place of a device. The capture stays owned
+ * by the caller and must outlive the MTouch.
+ */
+int mtouch_open_replay(struct MTouch* mt, struct CaptureReader* replay);
 int mtouch_close(struct MTouch* mt);
 
+/* Publish the staged configuration. The change takes effect as a whole at
+ * the start of the next frame. Publications may come from another thread
+ * than the frames, but only from one at a time.
+ */
+void mtouch_publish_config(struct MTouch* mt);
+
 int mtouch_read(struct MTouch* mt);
+
+/* Wait until the delayed button is due and release it. Returns 1 if it
+ * was released.
+ */
 int mtouch_delayed(struct MTouch* mt);
 
+/* For callers with their own event loop: get the time at which the
+ * delayed button is due, in the timebase of the event timestamps.
+ * Returns 0 if there is none.
+ */
+int mtouch_deadline(const struct MTouch* mt, struct timeval* deadline);
+
+/* Release the delayed button if it is due at now. Returns 1 if it was
+ * released.
+ */
+int mtouch_expire(struct MTouch* mt, const struct timeval* now);
+
+/* Report the button changes and motion of the last frame to sink.
+ */
+void mtouch_output(struct MTouch* mt, const struct MSink* sink);
+
 #endif
@@ -35,32 +35,103 @@
 #define MT_PALM 4
 #define MT_BOTTOM_EDGE 5
 
+/* The parts of a touch that only change when it appears, is classified
+ * or changes direction.
+ */
 struct Touch {
 	bitmask_t state;
 	bitmask_t flags;
 	double direction;
 	int tracking_id;
-	int x, y, dx, dy;
-	int total_dx, total_dy;
 	struct timeval down;
 };
 
+/* Touches rounded up to whole vectors of the widest SIMD unit.
+ */
+#define DIM_MOTION ((DIM_TOUCHES + 7) & ~7)
+
+/* The parts of the touches that change with every frame, kept as one
+ * array per field so a frame can update all touches at once with vector
+ * instructions. Entries line up with MTState.touch.
+ */
+struct TouchMotion {
+	int x[DIM_MOTION];
+	int y[DIM_MOTION];
+	int dx[DIM_MOTION];
+	int dy[DIM_MOTION];
+	int total_dx[DIM_MOTION];
+	int total_dy[DIM_MOTION];
+};
+
+/* Number of flags a touch may carry. The flags belong to the gestures,
+ * MTState only keeps track of which touches carry them.
+ */
+#define MT_FLAGS 2
+
+/* A group of touches and their summed motion in the last frame.
+ */
+struct TouchGroup {
+	touchset_t set;
+	int dx, dy;
+};
+
+/* Figures over all valid touches, brought up to date by mtstate_extract
+ * and by touch_flag_set and touch_flag_clear, so the gestures never
+ * have to scan the touches for them.
+ */
+struct TouchAggregate {
+	struct TouchGroup valid;		// Touches not invalidated.
+	struct TouchGroup flagged[MT_FLAGS];	// Valid touches with each flag.
+	int64_t sum_x, sum_y;			// Positions of the valid touches.
+	int64_t sum_sq;				// Squared distances from the origin.
+	int earliest, latest;			// Valid touches down first and last, -1 if none.
+};
+
 struct MTState {
 	bitmask_t state;
+	touchset_t touch_used;
+	struct TouchAggregate agg;
+
+	/* Set when no touch moved, appeared or was released in the last
+	 * frame. Extracting again from an unchanged HWState would produce
+	 * the same state.
+	 */
+	int settled;
+
+	struct TouchMotion motion;
 	struct Touch touch[DIM_TOUCHES];
-	bitmask_t touch_used;
 };
 
 /* Initialize an MTState struct.
  */
 void mtstate_init(struct MTState* ms);
 
+/* Set or clear a gesture flag of touch i, keeping the aggregates in step.
+ */
+void touch_flag_set(struct MTState* ms, int i, int flag);
+void touch_flag_clear(struct MTState* ms, int i, int flag);
+
+/* Number of touches in a group.
+ */
+static inline int touch_group_count(const struct TouchGroup* g)
+{
+	return bitset_count(g->set);
+}
+
+/* Get the centroid of the valid touches. Returns 0 if there are none.
+ */
+int mtstate_centroid(const struct MTState* ms, int* x, int* y);
+
+/* Root mean square distance of the valid touches from their centroid.
+ */
+double mtstate_spread(const struct MTState* ms);
+
 /* Extract the MTState from the current hardware state.
  */
 void mtstate_extract(struct MTState* ms,
 			const struct MConfig* cfg,
-			const struct HWState* hs,
-			const struct Capabilities* caps);
+			const struct MConfigDerived* drv,
+			const struct HWState* hs);
 
 #endif
 
@@ -0,0 +1,71 @@
+/***************************************************************************
+ *
+ * Multitouch X driver
+ * Copyright (C) 2008 Henrik Rydberg <rydberg@euromail.se>
+ * Copyright (C) 2011 Ryan Bourgeois <bluedragonx@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ **************************************************************************/
+
+#ifndef MUINPUT_H
+#define MUINPUT_H
+
+#include "common.h"
+#include "msink.h"
+
+#define MUINPUT_PATH "/dev/uinput"
+#define MUINPUT_NAME "mtrack pointer"
+
+/* Events queued for the current frame. A frame holds at most one motion,
+ * four wheel events and the button edges, so this only fills up when a
+ * frame changes most of the buttons at once.
+ */
+#define MUINPUT_QUEUE 64
+
+/* Wheel units per click, as in the kernel's high-resolution wheel API.
+ */
+#define MUINPUT_WHEEL_HI_RES 120
+
+/* A virtual relative pointer created through uinput. Button edges and
+ * motion are queued and written with a SYN_REPORT once per frame, so a
+ * frame reaches clients in a single read.
+ */
+struct MUinput {
+	int fd;
+	int count;
+	struct input_event queue[MUINPUT_QUEUE];
+};
+
+/* Create the pointer device. Returns 0 on success or a negative errno,
+ * typically -ENOENT without the uinput module or -EACCES without write
+ * access to path.
+ */
+int muinput_open(struct MUinput* u, const char* path, const char* name);
+
+/* Point sink at the device. Buttons 1 to 3 are the usual mouse buttons,
+ * 4 to 7 turn the vertical and horizontal wheels, 8 to 12 are the side,
+ * extra, forward, back and task buttons and higher buttons are reported
+ * as BTN_TRIGGER_HAPPY1 onwards so a compositor can bind them.
+ */
+void muinput_sink(struct MUinput* u, struct MSink* sink);
+
+/* Write out the events queued so far. Returns 0 or a negative errno.
+ */
+int muinput_flush(struct MUinput* u);
+
+void muinput_close(struct MUinput* u);
+
+#endif
@@ -0,0 +1,91 @@
+/***************************************************************************
+ *
+ * Multitouch X driver
+ * Copyright (C) 2008 Henrik Rydberg <rydberg@euromail.se>
+ * Copyright (C) 2011 Ryan Bourgeois <bluedragonx@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ **************************************************************************/
+
+#ifndef SIMD_H
+#define SIMD_H
+
+/* A thin layer over the integer vector instructions the touch kernels
+ * need, chosen when compiling: AVX2 if the compiler targets it, SSE2 on
+ * any x86-64, and no vectors at all elsewhere or when SIMD_SCALAR is
+ * defined, in which case SIMD_LANES is left undefined and callers fall
+ * back to plain loops. All loads and stores are unaligned; they cost
+ * nothing extra on aligned data.
+ */
+#if defined(SIMD_SCALAR)
+#elif defined(__AVX2__)
+#include <immintrin.h>
+
+#define SIMD_LANES 8
+typedef __m256i simd_t;
+
+#define simd_load(p) _mm256_loadu_si256((const __m256i*)(p))
+#define simd_store(p, v) _mm256_storeu_si256((__m256i*)(p), v)
+#define simd_set1(x) _mm256_set1_epi32(x)
+#define simd_add(a, b) _mm256_add_epi32(a, b)
+#define simd_sub(a, b) _mm256_sub_epi32(a, b)
+#define simd_and(a, b) _mm256_and_si256(a, b)
+#define simd_andnot(a, b) _mm256_andnot_si256(a, b)
+#define simd_or(a, b) _mm256_or_si256(a, b)
+#define simd_cmpeq(a, b) _mm256_cmpeq_epi32(a, b)
+#define simd_cmpgt(a, b) _mm256_cmpgt_epi32(a, b)
+#define simd_movemask(v) _mm256_movemask_ps(_mm256_castsi256_ps(v))
+#define simd_lanebits() _mm256_set_epi32(128, 64, 32, 16, 8, 4, 2, 1)
+
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+
+#define SIMD_LANES 4
+typedef __m128i simd_t;
+
+#define simd_load(p) _mm_loadu_si128((const __m128i*)(p))
+#define simd_store(p, v) _mm_storeu_si128((__m128i*)(p), v)
+#define simd_set1(x) _mm_set1_epi32(x)
+#define simd_add(a, b) _mm_add_epi32(a, b)
+#define simd_sub(a, b) _mm_sub_epi32(a, b)
+#define simd_and(a, b) _mm_and_si128(a, b)
+#define simd_andnot(a, b) _mm_andnot_si128(a, b)
+#define simd_or(a, b) _mm_or_si128(a, b)
+#define simd_cmpeq(a, b) _mm_cmpeq_epi32(a, b)
+#define simd_cmpgt(a, b) _mm_cmpgt_epi32(a, b)
+#define simd_movemask(v) _mm_movemask_ps(_mm_castsi128_ps(v))
+#define simd_lanebits() _mm_set_epi32(8, 4, 2, 1)
+#endif
+
+#ifdef SIMD_LANES
+/* All-ones in the lanes whose bit is set in the low SIMD_LANES bits of
+ * bits, zero in the others.
+ */
+static inline simd_t simd_expand(unsigned int bits)
+{
+	simd_t lanes = simd_lanebits();
+	return simd_cmpeq(simd_and(simd_set1((int)bits), lanes), lanes);
+}
+
+/* Lanes of a where mask is set and of b elsewhere.
+ */
+static inline simd_t simd_select(simd_t mask, simd_t a, simd_t b)
+{
+	return simd_or(simd_and(mask, a), simd_andnot(mask, b));
+}
+#endif
+
+#endif
@@ -0,0 +1,99 @@
+/***************************************************************************
+ *
+ * Multitouch X driver
+ * Copyright (C) 2008 Henrik Rydberg <rydberg@euromail.se>
+ * Copyright (C) 2011 Ryan Bourgeois <bluedragonx@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ **************************************************************************/
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "common.h"
+#include "gestures.h"
+#include "hwstate.h"
+#include "latency.h"
+#include "mtstate.h"
+
+/* Live telemetry is a small file, typically in /dev/shm, that the input
+ * path maps and rewrites after every frame. Monitors map it read-only and
+ * sample it as often as they like without ever blocking the writer. The
+ * page is guarded by a sequence lock: seq is odd while a frame is being
+ * written, and a reader retries if seq was odd or changed while it
+ * copied.
+ */
+#define TELEMETRY_MAGIC 0x4c54544dU	// "MTTL"
+#define TELEMETRY_VERSION 3
+
+struct TelemetryTouch {
+	int32_t tracking_id;
+	uint32_t state;		// MT_* bits.
+	int32_t x, y;
+	int32_t dx, dy;
+};
+
+/* The layout of the file. All fields are in native byte order.
+ */
+struct TelemetryPage {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size;		// Of this struct, for readers built elsewhere.
+	uint32_t seq;
+	uint64_t frames;
+	uint64_t dropped;	// SYN_DROPPED reports from the kernel.
+	int64_t time;		// Gesture time of the frame, microseconds.
+	uint32_t buttons;
+	int32_t move_type;
+	int32_t move_dir;
+	double pinch_scale;	// Two finger scale and angle, see Gestures.
+	double pinch_angle;
+	uint64_t latency[LATENCY_STAGES];	// Last sample, nanoseconds.
+	touchset_t touch_used;
+	struct TelemetryTouch touch[DIM_TOUCHES];
+};
+
+struct MTelemetry {
+	struct TelemetryPage* page;
+	uint64_t frames;
+};
+
+/* Replace the telemetry file at path with a new one and map it. The file
+ * is created exclusively and only its owner may read it, so a file left
+ * by another user is never mapped. Returns 0 or a negative errno.
+ */
+int telemetry_open(struct MTelemetry* t, const char* path);
+
+/* Publish the state after a frame. lat may be NULL.
+ */
+void telemetry_publish(struct MTelemetry* t, const struct HWState* hs,
+			const struct MTState* ms, const struct Gestures* gs,
+			const struct MLatency* lat);
+
+/* Take a consistent snapshot of a mapped page. Returns 0, -EINVAL if the
+ * page is not a telemetry page of this version or -EAGAIN if the writer
+ * kept it busy.
+ */
+int telemetry_read(const struct TelemetryPage* page, struct TelemetryPage* snap);
+
+/* Map an existing telemetry file read-only. Returns the page or NULL with
+ * errno set.
+ */
+const struct TelemetryPage* telemetry_map(const char* path);
+
+void telemetry_close(struct MTelemetry* t);
+
+#endif
@@ -0,0 +1,69 @@
+/***************************************************************************
+ *
+ * Multitouch X driver
+ * Copyright (C) 2008 Henrik Rydberg <rydberg@euromail.se>
+ * Copyright (C) 2011 Ryan Bourgeois <bluedragonx@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ **************************************************************************/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "common.h"
+
+/* Trace categories. Each can be switched on at runtime through the trace
+ * mask; the --enable-debug-* configure options only choose which are on
+ * from the start.
+ */
+#define TRACE_GESTURES 0
+#define TRACE_MTSTATE 1
+#define TRACE_PROPS 2
+#define TRACE_DRIVER 3
+#define TRACE_CATEGORIES 4
+#define TRACE_ALL (BITMASK(TRACE_CATEGORIES) - 1)
+
+/* Trace lines are formatted into a ring of TRACE_LINES lines and logged
+ * later by trace_drain, so that tracing never blocks the input path on
+ * the log. Lines that don't fit are counted and dropped.
+ */
+#define TRACE_LINES 512
+#define TRACE_LINE_SIZE 160
+
+extern unsigned int trace_mask;
+
+static inline int trace_enabled(int category)
+{
+	return __builtin_expect(GETBIT(__atomic_load_n(&trace_mask, __ATOMIC_RELAXED), category), 0);
+}
+
+/* Record a trace line if its category is enabled. The arguments are not
+ * evaluated otherwise.
+ */
+#define trace(category, ...) \
+	do { if (trace_enabled(category)) trace_printf(category, __VA_ARGS__); } while (0)
+
+void trace_printf(int category, const char* format, ...)
+	__attribute__((format(printf, 2, 3)));
+
+void trace_set_mask(unsigned int mask);
+
+/* Log all pending lines through mlog. Only one thread may drain at a
+ * time. Returns the number of lines logged.
+ */
+int trace_drain(void);
+
+#endif
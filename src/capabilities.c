@@ -106,6 +106,9 @@ int read_capabilities(struct Capabilities *cap, int fd)
 	SETABS(cap, slot, absbits, ABS_MT_SLOT, fd);
 	for (i = 0; i < MT_ABS_SIZE; i++)
 		SETABS(cap, abs[i], absbits, mtdev_mt2abs(i), fd);
+	if (cap->has_slot && cap->slot.maximum >= DIM_FINGER)
+		mlog(MLOG_WARNING, "mtrack: %d slots, only %d are tracked\n",
+			cap->slot.maximum + 1, DIM_FINGER);
 
 	cap->has_mtdata = has_mt_data(cap);
 	cap->has_ibt = has_integrated_button(cap);
@@ -121,6 +124,42 @@ int read_capabilities(struct Capabilities *cap, int fd)
 	return 0;
 }
 
+/* Check that fd refers to the device cap was read from. Only the device
+ * id and name are read so this is much cheaper than read_capabilities().
+ */
+int match_capabilities(const struct Capabilities *cap, int fd)
+{
+	struct input_id devid;
+	char devname[sizeof(cap->devname)];
+	int rc;
+
+	memset(devname, 0, sizeof(devname));
+	SYSCALL(rc = ioctl(fd, EVIOCGID, &devid));
+	if (rc < 0)
+		return 0;
+	SYSCALL(rc = ioctl(fd, EVIOCGNAME(sizeof(devname)), devname));
+	if (rc < 0)
+		return 0;
+	return devid.bustype == cap->devid.bustype &&
+		devid.vendor == cap->devid.vendor &&
+		devid.product == cap->devid.product &&
+		devid.version == cap->devid.version &&
+		!strncmp(devname, cap->devname, sizeof(devname));
+}
+
+/* Fill in mtdev capabilities so that the device does not have to be
+ * probed again by mtdev_configure().
+ */
+void copy_mtdev_capabilities(struct mtdev_caps *mtcaps,
+			const struct Capabilities *cap)
+{
+	mtcaps->has_mtdata = cap->has_mtdata;
+	mtcaps->has_slot = cap->has_slot;
+	memcpy(mtcaps->has_abs, cap->has_abs, sizeof(mtcaps->has_abs));
+	memcpy(&mtcaps->slot, &cap->slot, sizeof(mtcaps->slot));
+	memcpy(mtcaps->abs, cap->abs, sizeof(mtcaps->abs));
+}
+
 int get_cap_xsize(const struct Capabilities *cap)
 {
 	const struct input_absinfo *x = &cap->abs[MTDEV_POSITION_X];
@@ -173,13 +212,13 @@ void output_capabilities(const struct Capabilities *cap)
 	ADDCAP(line, cap, right);
 	ADDCAP(line, cap, mtdata);
 	ADDCAP(line, cap, ibt);
-	xf86Msg(X_INFO, "mtrack: devname: %s\n", cap->devname);
-	xf86Msg(X_INFO, "mtrack: devid: %x %x %x\n",
+	mlog(MLOG_INFO, "mtrack: devname: %s\n", cap->devname);
+	mlog(MLOG_INFO, "mtrack: devid: %x %x %x\n",
 		cap->devid.vendor, cap->devid.product, cap->devid.version);
-	xf86Msg(X_INFO, "mtrack: caps:%s\n", line);
+	mlog(MLOG_INFO, "mtrack: caps:%s\n", line);
 	for (i = 0; i < MT_ABS_SIZE; i++) {
 		if (cap->has_abs[i])
-			xf86Msg(X_INFO, "mtrack: %d: min: %d max: %d\n",
+			mlog(MLOG_INFO, "mtrack: %d: min: %d max: %d\n",
 				i,
 				cap->abs[i].minimum,
 				cap->abs[i].maximum);
@@ -0,0 +1,341 @@
+/***************************************************************************
+ *
+ * Multitouch X driver
+ * Copyright (C) 2008 Henrik Rydberg <rydberg@euromail.se>
+ * Copyright (C) 2011 Ryan Bourgeois <bluedragonx@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ **************************************************************************/
+
+#include "capture.h"
+#include <endian.h>
+#include <time.h>
+
+#define CAPS_SIZE (8 + 32 + 4*5 + 4 + 24 + 4 + MT_ABS_SIZE*(4 + 24))
+
+struct Buffer {
+	unsigned char* data;
+	size_t size;
+	size_t pos;
+};
+
+static void put_u16(struct Buffer* b, uint16_t v)
+{
+	v = htole16(v);
+	memcpy(b->data + b->pos, &v, sizeof(v));
+	b->pos += sizeof(v);
+}
+
+static void put_u32(struct Buffer* b, uint32_t v)
+{
+	v = htole32(v);
+	memcpy(b->data + b->pos, &v, sizeof(v));
+	b->pos += sizeof(v);
+}
+
+static void put_u64(struct Buffer* b, uint64_t v)
+{
+	v = htole64(v);
+	memcpy(b->data + b->pos, &v, sizeof(v));
+	b->pos += sizeof(v);
+}
+
+static void put_absinfo(struct Buffer* b, const struct input_absinfo* abs)
+{
+	put_u32(b, abs->value);
+	put_u32(b, abs->minimum);
+	put_u32(b, abs->maximum);
+	put_u32(b, abs->fuzz);
+	put_u32(b, abs->flat);
+	put_u32(b, abs->resolution);
+}
+
+/* Fetch functions return 0 once the buffer runs out so a truncated file
+ * cannot be read past its end. Check b->pos <= b->size afterwards.
+ */
+static uint16_t get_u16(struct Buffer* b)
+{
+	uint16_t v = 0;
+	if (b->pos + sizeof(v) <= b->size)
+		memcpy(&v, b->data + b->pos, sizeof(v));
+	b->pos += sizeof(v);
+	return le16toh(v);
+}
+
+static uint32_t get_u32(struct Buffer* b)
+{
+	uint32_t v = 0;
+	if (b->pos + sizeof(v) <= b->size)
+		memcpy(&v, b->data + b->pos, sizeof(v));
+	b->pos += sizeof(v);
+	return le32toh(v);
+}
+
+static uint64_t get_u64(struct Buffer* b)
+{
+	uint64_t v = 0;
+	if (b->pos + sizeof(v) <= b->size)
+		memcpy(&v, b->data + b->pos, sizeof(v));
+	b->pos += sizeof(v);
+	return le64toh(v);
+}
+
+static void get_absinfo(struct Buffer* b, struct input_absinfo* abs)
+{
+	abs->value = (int32_t)get_u32(b);
+	abs->minimum = (int32_t)get_u32(b);
+	abs->maximum = (int32_t)get_u32(b);
+	abs->fuzz = (int32_t)get_u32(b);
+	abs->flat = (int32_t)get_u32(b);
+	abs->resolution = (int32_t)get_u32(b);
+}
+
+static void put_caps(struct Buffer* b, const struct Capabilities* caps)
+{
+	int i;
+	put_u16(b, caps->devid.bustype);
+	put_u16(b, caps->devid.vendor);
+	put_u16(b, caps->devid.product);
+	put_u16(b, caps->devid.version);
+	memcpy(b->data + b->pos, caps->devname, sizeof(caps->devname));
+	b->pos += sizeof(caps->devname);
+	put_u32(b, caps->has_left);
+	put_u32(b, caps->has_middle);
+	put_u32(b, caps->has_right);
+	put_u32(b, caps->has_mtdata);
+	put_u32(b, caps->has_ibt);
+	put_u32(b, caps->has_slot);
+	put_absinfo(b, &caps->slot);
+	put_u32(b, MT_ABS_SIZE);
+	for (i = 0; i < MT_ABS_SIZE; i++) {
+		put_u32(b, caps->has_abs[i]);
+		put_absinfo(b, &caps->abs[i]);
+	}
+}
+
+static void get_caps(struct Buffer* b, struct Capabilities* caps)
+{
+	struct input_absinfo skip;
+	unsigned int i, naxes;
+	memset(caps, 0, sizeof(struct Capabilities));
+	caps->devid.bustype = get_u16(b);
+	caps->devid.vendor = get_u16(b);
+	caps->devid.product = get_u16(b);
+	caps->devid.version = get_u16(b);
+	if (b->pos + sizeof(caps->devname) <= b->size)
+		memcpy(caps->devname, b->data + b->pos, sizeof(caps->devname));
+	caps->devname[sizeof(caps->devname) - 1] = '\0';
+	b->pos += sizeof(caps->devname);
+	caps->has_left = get_u32(b);
+	caps->has_middle = get_u32(b);
+	caps->has_right = get_u32(b);
+	caps->has_mtdata = get_u32(b);
+	caps->has_ibt = get_u32(b);
+	caps->has_slot = get_u32(b);
+	get_absinfo(b, &caps->slot);
+	// Captures from an mtdev with a different number of axes still load,
+	// unknown axes are skipped and missing ones stay unsupported.
+	naxes = get_u32(b);
+	for (i = 0; i < naxes && b->pos <= b->size; i++) {
+		if (i < MT_ABS_SIZE) {
+			caps->has_abs[i] = get_u32(b);
+			get_absinfo(b, &caps->abs[i]);
+		}
+		else {
+			get_u32(b);
+			get_absinfo(b, &skip);
+		}
+	}
+}
+
+int capture_create(struct CaptureWriter* w, const char* path,
+			const struct Capabilities* caps)
+{
+	unsigned char data[8 + CAPS_SIZE];
+	struct Buffer b = { data, sizeof(data), 0 };
+
+	memcpy(b.data, CAPTURE_MAGIC, 4);
+	b.pos = 4;
+	put_u32(&b, CAPTURE_VERSION);
+	put_caps(&b, caps);
+
+	w->file = fopen(path, "wb");
+	if (!w->file)
+		return -errno;
+	if (fwrite(b.data, b.pos, 1, w->file) != 1) {
+		int err = -errno;
+		fclose(w->file);
+		w->file = NULL;
+		return err;
+	}
+	return 0;
+}
+
+int capture_write(struct CaptureWriter* w, const struct input_event* ev)
+{
+	unsigned char data[CAPTURE_EVENT_SIZE];
+	struct Buffer b = { data, sizeof(data), 0 };
+
+	put_u64(&b, (uint64_t)ev->time.tv_sec * 1000000 + ev->time.tv_usec);
+	put_u16(&b, ev->type);
+	put_u16(&b, ev->code);
+	put_u32(&b, ev->value);
+	if (fwrite(b.data, b.pos, 1, w->file) != 1)
+		return -errno;
+	return 0;
+}
+
+int capture_close(struct CaptureWriter* w)
+{
+	int ret = 0;
+	if (w->file && fclose(w->file))
+		ret = -errno;
+	w->file = NULL;
+	return ret;
+}
+
+static int read_file(const char* path, struct Buffer* b)
+{
+	FILE* file = fopen(path, "rb");
+	long size;
+	if (!file)
+		return -errno;
+	if (fseek(file, 0, SEEK_END) || (size = ftell(file)) < 0 ||
+	    fseek(file, 0, SEEK_SET))
+		goto error;
+	b->data = malloc(size ? size : 1);
+	b->size = size;
+	b->pos = 0;
+	if (!b->data) {
+		fclose(file);
+		return -ENOMEM;
+	}
+	if (size && fread(b->data, size, 1, file) != 1) {
+		free(b->data);
+		goto error;
+	}
+	fclose(file);
+	return 0;
+ error:
+	fclose(file);
+	return errno ? -errno : -EIO;
+}
+
+int capture_open(struct CaptureReader* r, const char* path, int mode)
+{
+	struct Buffer b = { NULL, 0, 0 };
+	size_t i;
+	int ret;
+
+	memset(r, 0, sizeof(struct CaptureReader));
+	r->mode = mode;
+	ret = read_file(path, &b);
+	if (ret)
+		return ret;
+
+	if (b.size < 8 || memcmp(b.data, CAPTURE_MAGIC, 4))
+		goto invalid;
+	b.pos = 4;
+	if (get_u32(&b) != CAPTURE_VERSION)
+		goto invalid;
+	get_caps(&b, &r->caps);
+	if (b.pos > b.size)
+		goto invalid;
+
+	r->count = (b.size - b.pos) / CAPTURE_EVENT_SIZE;
+	r->events = malloc(MAXVAL(r->count, 1) * sizeof(struct input_event));
+	if (!r->events) {
+		free(b.data);
+		return -ENOMEM;
+	}
+	for (i = 0; i < r->count; i++) {
+		struct input_event* ev = &r->events[i];
+		uint64_t usec = get_u64(&b);
+		ev->time.tv_sec = usec / 1000000;
+		ev->time.tv_usec = usec % 1000000;
+		ev->type = get_u16(&b);
+		ev->code = get_u16(&b);
+		ev->value = (int32_t)get_u32(&b);
+	}
+	free(b.data);
+	return 0;
+ invalid:
+	free(b.data);
+	return -EINVAL;
+}
+
+/* Sleep until the wall clock has advanced as far past the start of the
+ * replay as evtime is past the first event.
+ */
+static void capture_pace(struct CaptureReader* r, const struct timeval* evtime)
+{
+	struct timeval now, due;
+	struct timespec ts;
+
+	if (r->mode != CAPTURE_REALTIME || !r->count)
+		return;
+	if (!timerisset(&r->start))
+		microtime(&r->start);
+	timersub(evtime, &r->events[0].time, &due);
+	timeradd(&r->start, &due, &due);
+	microtime(&now);
+	if (timercmp(&due, &now, >)) {
+		timersub(&due, &now, &due);
+		ts.tv_sec = due.tv_sec;
+		ts.tv_nsec = due.tv_usec * 1000;
+		while (nanosleep(&ts, &ts) && errno == EINTR)
+			;
+	}
+}
+
+int capture_read(struct CaptureReader* r, struct input_event* ev)
+{
+	if (r->frame_end) {
+		r->frame_end = 0;
+		return -EAGAIN;
+	}
+	if (r->pos >= r->count)
+		return 0;
+	*ev = r->events[r->pos++];
+	capture_pace(r, &ev->time);
+	r->frame_end = ev->type == EV_SYN && ev->code == SYN_REPORT;
+	return 1;
+}
+
+void capture_wait(struct CaptureReader* r, const struct timeval* until,
+			struct timeval* now)
+{
+	if (r->pos < r->count && timercmp(&r->events[r->pos].time, until, <))
+		timercp(now, &r->events[r->pos].time);
+	else
+		timercp(now, until);
+	capture_pace(r, now);
+}
+
+void capture_rewind(struct CaptureReader* r)
+{
+	r->pos = 0;
+	r->frame_end = 0;
+	timerclear(&r->start);
+}
+
+void capture_free(struct CaptureReader* r)
+{
+	free(r->events);
+	r->events = NULL;
+	r->count = 0;
+	r->pos = 0;
+}
@@ -0,0 +1,293 @@
+/***************************************************************************
+ *
+ * Multitouch X driver
+ * Copyright (C) 2008 Henrik Rydberg <rydberg@euromail.se>
+ * Copyright (C) 2011 Ryan Bourgeois <bluedragonx@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ **************************************************************************/
+
+#include "flight.h"
+#include <fcntl.h>
+
+static const char* move_names[] = {
+	"none", "move", "scroll", "swipe", "scale", "rotate",
+	"drag-ready", "drag-wait", "drag-active"
+};
+
+static const char* stage_names[] = {
+	"hwstate_process", "mtstate_extract", "gestures_extract", "mtouch_output"
+};
+
+// Tracks of a Chrome trace.
+#define TRACK_PIPELINE 1
+#define TRACK_GESTURES 2
+#define TRACK_EVENTS 3
+
+static const char* stage_name(int stage)
+{
+	return stage >= 0 && stage < (int)(sizeof(stage_names) / sizeof(stage_names[0])) ?
+		stage_names[stage] : "unknown";
+}
+
+static const char* move_name(int type)
+{
+	return type >= 0 && type < (int)(sizeof(move_names) / sizeof(move_names[0])) ?
+		move_names[type] : "unknown";
+}
+
+static const char* abs_name(int code)
+{
+	switch (code) {
+	case ABS_MT_SLOT: return "slot";
+	case ABS_MT_TOUCH_MAJOR: return "touch-major";
+	case ABS_MT_TOUCH_MINOR: return "touch-minor";
+	case ABS_MT_WIDTH_MAJOR: return "width-major";
+	case ABS_MT_WIDTH_MINOR: return "width-minor";
+	case ABS_MT_ORIENTATION: return "orientation";
+	case ABS_MT_POSITION_X: return "x";
+	case ABS_MT_POSITION_Y: return "y";
+	case ABS_MT_TRACKING_ID: return "tracking-id";
+	case ABS_MT_PRESSURE: return "pressure";
+	default: return NULL;
+	}
+}
+
+void flight_init(struct FlightRecorder* fr, const char* path)
+{
+	memset(fr, 0, sizeof(struct FlightRecorder));
+	snprintf(fr->path, sizeof(fr->path), "%s", path);
+}
+
+void flight_decisions(struct FlightRecorder* fr, const struct Gestures* gs,
+			const struct MTState* ms)
+{
+	buttonset_t changed;
+	touchset_t invalid;
+	int i;
+
+	if (gs->move_type != fr->move_type) {
+		flight_record(fr, &gs->time, FLIGHT_MOVE, gs->move_type, fr->move_type, gs->move_dir);
+		fr->move_type = gs->move_type;
+	}
+
+	bitset_xor(changed, gs->buttons, fr->buttons);
+	foreach_bit(i, changed)
+		flight_record(fr, &gs->time, FLIGHT_BUTTON, i + 1, bitset_get(gs->buttons, i), 0);
+	fr->buttons = gs->buttons;
+
+	bitset_zero(invalid);
+	foreach_bit(i, ms->touch_used) {
+		if (!GETBIT(ms->touch[i].state, MT_INVALID))
+			continue;
+		bitset_set(invalid, i);
+		if (!bitset_get(fr->invalid, i))
+			flight_record(fr, &gs->time, FLIGHT_INVALID, i,
+				ms->touch[i].tracking_id, ms->touch[i].state);
+	}
+	fr->invalid = invalid;
+}
+
+static void dump_record(FILE* file, const struct FlightRecord* r)
+{
+	const char* name;
+	fprintf(file, "%lld.%06lld ", (long long)(r->time / 1000000), (long long)(r->time % 1000000));
+	switch (r->kind) {
+	case FLIGHT_EVENT:
+		if (r->arg == EV_SYN)
+			fprintf(file, "sync %d\n", r->code);
+		else if (r->arg == EV_KEY)
+			fprintf(file, "key %d %d\n", r->code, r->value);
+		else if (r->arg == EV_ABS && (name = abs_name(r->code)))
+			fprintf(file, "abs %s %d\n", name, r->value);
+		else
+			fprintf(file, "event %d %d %d\n", r->arg, r->code, r->value);
+		break;
+	case FLIGHT_MOVE:
+		fprintf(file, "gesture %s -> %s dir %d\n",
+			move_name(r->value), move_name(r->code), r->arg);
+		break;
+	case FLIGHT_BUTTON:
+		fprintf(file, "button %d %s\n", r->code, r->value ? "down" : "up");
+		break;
+	case FLIGHT_INVALID:
+		fprintf(file, "invalid touch %d id %d:%s%s%s%s\n", r->code, r->value,
+			GETBIT(r->arg, MT_THUMB) ? " thumb" : "",
+			GETBIT(r->arg, MT_PALM) ? " palm" : "",
+			GETBIT(r->arg, MT_BOTTOM_EDGE) ? " bottom-edge" : "",
+			r->arg & (BITMASK(MT_THUMB) | BITMASK(MT_PALM) | BITMASK(MT_BOTTOM_EDGE)) ?
+				"" : " disabled");
+		break;
+	case FLIGHT_SPAN:
+		fprintf(file, "stage %s %d ns\n", stage_name(r->code), r->value);
+		break;
+	}
+}
+
+/* Copy the ring. Records from *first up to *head are valid in the copy,
+ * which the caller frees.
+ */
+static struct FlightRecord* flight_snapshot(const struct FlightRecorder* fr,
+			uint64_t* first, uint64_t* head)
+{
+	struct FlightRecord* copy = malloc(sizeof(fr->ring));
+	if (!copy)
+		return NULL;
+	*head = __atomic_load_n(&fr->head, __ATOMIC_ACQUIRE);
+	memcpy(copy, fr->ring, sizeof(fr->ring));
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+	// Records from before the copy started are safe unless the writer
+	// has come round to them since.
+	*first = __atomic_load_n(&fr->head, __ATOMIC_ACQUIRE);
+	*first = *first >= FLIGHT_SIZE ? *first - FLIGHT_SIZE + 1 : 0;
+	return copy;
+}
+
+int flight_dump(const struct FlightRecorder* fr, FILE* file)
+{
+	struct FlightRecord* copy;
+	uint64_t head, first, i;
+	int n = 0;
+
+	copy = flight_snapshot(fr, &first, &head);
+	if (!copy)
+		return 0;
+	for (i = first; i < head; i++, n++)
+		dump_record(file, &copy[i & (FLIGHT_SIZE - 1)]);
+	free(copy);
+	return n;
+}
+
+/* Print a time in nanoseconds as the microseconds Chrome traces use.
+ */
+static void export_time(FILE* file, const char* key, int64_t ns)
+{
+	fprintf(file, "\"%s\":%lld.%03lld", key,
+		(long long)(ns / 1000), (long long)(ABSVAL(ns) % 1000));
+}
+
+static void export_instant(FILE* file, int pid, int tid, int64_t ns, const char* cat)
+{
+	fprintf(file, ",\"cat\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":%d,\"tid\":%d,",
+		cat, pid, tid);
+	export_time(file, "ts", ns);
+}
+
+static void export_record(FILE* file, const struct FlightRecord* r, int pid, int64_t offset)
+{
+	// Everything but spans is stamped by the evdev clock.
+	int64_t ns = r->time * 1000 - (r->kind == FLIGHT_SPAN ? 0 : offset);
+	const char* name;
+
+	fputs(",\n{", file);
+	switch (r->kind) {
+	case FLIGHT_EVENT:
+		if (r->arg == EV_SYN)
+			fprintf(file, "\"name\":\"sync %d\"", r->code);
+		else if (r->arg == EV_KEY)
+			fprintf(file, "\"name\":\"key %d\"", r->code);
+		else if (r->arg == EV_ABS && (name = abs_name(r->code)))
+			fprintf(file, "\"name\":\"%s\"", name);
+		else
+			fprintf(file, "\"name\":\"event %d %d\"", r->arg, r->code);
+		export_instant(file, pid, TRACK_EVENTS, ns, "evdev");
+		fprintf(file, ",\"args\":{\"value\":%d}", r->value);
+		break;
+	case FLIGHT_MOVE:
+		fprintf(file, "\"name\":\"%s\"", move_name(r->code));
+		export_instant(file, pid, TRACK_GESTURES, ns, "gesture");
+		fprintf(file, ",\"args\":{\"from\":\"%s\",\"dir\":%d}", move_name(r->value), r->arg);
+		break;
+	case FLIGHT_BUTTON:
+		fprintf(file, "\"name\":\"button %d %s\"", r->code, r->value ? "down" : "up");
+		export_instant(file, pid, TRACK_GESTURES, ns, "gesture");
+		break;
+	case FLIGHT_INVALID:
+		fprintf(file, "\"name\":\"invalid touch %d\"", r->code);
+		export_instant(file, pid, TRACK_GESTURES, ns, "gesture");
+		fprintf(file, ",\"args\":{\"id\":%d,\"state\":%d}", r->value, r->arg);
+		break;
+	case FLIGHT_SPAN:
+		fprintf(file, "\"name\":\"%s\",\"cat\":\"pipeline\",\"ph\":\"X\","
+			"\"pid\":%d,\"tid\":%d,", stage_name(r->code), pid, TRACK_PIPELINE);
+		export_time(file, "ts", ns + r->arg);
+		fputc(',', file);
+		export_time(file, "dur", r->value);
+		break;
+	}
+	fputc('}', file);
+}
+
+static void export_track(FILE* file, int pid, int tid, const char* name)
+{
+	fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+		"\"args\":{\"name\":\"%s\"}}", pid, tid, name);
+}
+
+int flight_export(const struct FlightRecorder* fr, FILE* file)
+{
+	struct FlightRecord* copy;
+	struct timespec real;
+	uint64_t head, first, i;
+	int64_t offset;
+	int pid = getpid(), n = 0;
+
+	copy = flight_snapshot(fr, &first, &head);
+	if (!copy)
+		return 0;
+	// The distance between the clocks now stands in for the one at the
+	// time of each record.
+	clock_gettime(CLOCK_REALTIME, &real);
+	offset = (int64_t)real.tv_sec * 1000000000 + real.tv_nsec - (int64_t)nanotime();
+
+	fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+		"{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+		"\"args\":{\"name\":\"mtrack\"}}", pid);
+	export_track(file, pid, TRACK_PIPELINE, "pipeline");
+	export_track(file, pid, TRACK_GESTURES, "gestures");
+	export_track(file, pid, TRACK_EVENTS, "evdev");
+	for (i = first; i < head; i++, n++)
+		export_record(file, &copy[i & (FLIGHT_SIZE - 1)], pid, offset);
+	fputs("\n]}\n", file);
+	free(copy);
+	return n;
+}
+
+int flight_save(const struct FlightRecorder* fr, int format, char* saved, size_t size)
+{
+	const char* ext = format == FLIGHT_CHROME ? ".json" : ".log";
+	char path[sizeof(fr->path) + 16];
+	FILE* file;
+	int fd, n;
+
+	snprintf(path, sizeof(path), "%s-XXXXXX%s", fr->path, ext);
+	// A fresh name for every dump, so that nothing planted at a name
+	// known in advance is ever written to.
+	fd = mkstemps(path, strlen(ext));
+	if (fd < 0)
+		return -errno;
+	snprintf(saved, size, "%s", path);
+	file = fdopen(fd, "w");
+	if (!file) {
+		close(fd);
+		return -errno;
+	}
+	n = format == FLIGHT_CHROME ? flight_export(fr, file) : flight_dump(fr, file);
+	if (fclose(file))
+		return -errno;
+	return n;
+}
@@ -27,9 +27,11 @@
 
 #include "gestures.h"
 #include "mtouch.h"
+#include "trace.h"
 #include "trig.h"
+#include <math.h>
 
-#define IS_VALID_BUTTON(x) (x >= 0 && x <= 31)
+#define IS_VALID_BUTTON(x) (x >= 0 && x < MAX_BUTTONS)
 
 static void trigger_button_up(struct Gestures* gs, int button)
 {
@@ -38,10 +40,8 @@ static void trigger_button_up(struct Gestures* gs, int button)
 			button = gs->button_emulate;
 			gs->button_emulate = 0;
 		}
-		CLEARBIT(gs->buttons, button);
-#ifdef DEBUG_GESTURES
-		xf86Msg(X_INFO, "trigger_button_up: %d up\n", button);
-#endif
+		bitset_clear(gs->buttons, button);
+		trace(TRACE_GESTURES, "trigger_button_up: %d up\n", button);
 	}
 }
 
@@ -51,26 +51,20 @@ static void trigger_button_down(struct Gestures* gs, int button)
 	timerclear(&epoch);
 
 	if (IS_VALID_BUTTON(button) && (button != gs->button_delayed || timercmp(&gs->button_delayed_time, &epoch, ==))) {
-		SETBIT(gs->buttons, button);
-#ifdef DEBUG_GESTURES
-		xf86Msg(X_INFO, "trigger_button_down: %d down\n", button);
-#endif
+		bitset_set(gs->buttons, button);
+		trace(TRACE_GESTURES, "trigger_button_down: %d down\n", button);
 	}
-#ifdef DEBUG_GESTURES
 	else if (IS_VALID_BUTTON(button))
-		xf86Msg(X_INFO, "trigger_button_down: %d down ignored, in delayed mode\n", button);
-#endif
+		trace(TRACE_GESTURES, "trigger_button_down: %d down ignored, in delayed mode\n", button);
 }
 
 static void trigger_button_emulation(struct Gestures* gs, int button)
 {
-	if (IS_VALID_BUTTON(button) && GETBIT(gs->buttons, 0)) {
-		CLEARBIT(gs->buttons, 0);
-		SETBIT(gs->buttons, button);
+	if (IS_VALID_BUTTON(button) && bitset_get(gs->buttons, 0)) {
+		bitset_clear(gs->buttons, 0);
+		bitset_set(gs->buttons, button);
 		gs->button_emulate = button;
-#ifdef DEBUG_GESTURES
-		xf86Msg(X_INFO, "trigger_button_emulation: %d emulated\n", button);
-#endif
+		trace(TRACE_GESTURES, "trigger_button_emulation: %d emulated\n", button);
 	}
 }
 
@@ -85,14 +79,10 @@ static void trigger_button_click(struct Gestures* gs,
 		gs->button_delayed = button;
 		timercp(&gs->button_delayed_time, trigger_up_time);
 		timerclear(&gs->button_delayed_delta);
-#ifdef DEBUG_GESTURES
-		xf86Msg(X_INFO, "trigger_button_click: %d placed in delayed mode\n");
-#endif
+		trace(TRACE_GESTURES, "trigger_button_click: %d placed in delayed mode\n", button);
 	}
-#ifdef DEBUG_GESTURES
 	else if (IS_VALID_BUTTON(button))
-		xf86Msg(X_INFO, "trigger_button_click: %d ignored, in delayed mode\n", button);
-#endif
+		trace(TRACE_GESTURES, "trigger_button_click: %d ignored, in delayed mode\n", button);
 }
 
 static void trigger_drag_ready(struct Gestures* gs,
@@ -100,13 +90,12 @@ static void trigger_drag_ready(struct Gestures* gs,
 {
 	gs->move_drag = GS_DRAG_READY;
 	timeraddms(&gs->time, cfg->drag_timeout, &gs->move_drag_expire);
-#ifdef DEBUG_GESTURES
-	xf86Msg(X_INFO, "trigger_drag_ready: drag is ready\n");
-#endif
+	trace(TRACE_GESTURES, "trigger_drag_ready: drag is ready\n");
 }
 
 static int trigger_drag_start(struct Gestures* gs,
 			const struct MConfig* cfg,
+			const struct MConfigDerived* drv,
 			int dx, int dy)
 {
 	if (gs->move_drag == GS_DRAG_READY) {
@@ -114,18 +103,14 @@ static int trigger_drag_start(struct Gestures* gs,
 		if (cfg->drag_wait == 0) {
  			gs->move_drag = GS_DRAG_ACTIVE;
 			trigger_button_down(gs, 0);
-#ifdef DEBUG_GESTURES
-			xf86Msg(X_INFO, "trigger_drag_start: drag is active\n");
-#endif
+			trace(TRACE_GESTURES, "trigger_drag_start: drag is active\n");
 		}
 		else {
 			gs->move_drag = GS_DRAG_WAIT;
 			gs->move_drag_dx = dx;
 			gs->move_drag_dy = dy;
 			timeraddms(&gs->time, cfg->drag_wait, &gs->move_drag_wait);
-#ifdef DEBUG_GESTURES
-			xf86Msg(X_INFO, "trigger_drag_start: drag in wait\n");
-#endif
+			trace(TRACE_GESTURES, "trigger_drag_start: drag in wait\n");
 		}
 	}
 	else if (gs->move_drag == GS_DRAG_WAIT) {
@@ -134,15 +119,11 @@ static int trigger_drag_start(struct Gestures* gs,
 		if (!timercmp(&gs->time, &gs->move_drag_wait, <)) {
 			gs->move_drag = GS_DRAG_ACTIVE;
 			trigger_button_down(gs, 0);
-#ifdef DEBUG_GESTURES
-			xf86Msg(X_INFO, "trigger_drag_start: drag is active\n");
-#endif
+			trace(TRACE_GESTURES, "trigger_drag_start: drag is active\n");
 		}
-		else if (dist2(gs->move_drag_dx, gs->move_drag_dy) > SQRVAL(cfg->drag_dist)) {
+		else if (dist2(gs->move_drag_dx, gs->move_drag_dy) > drv->drag_dist) {
 			gs->move_drag = GS_NONE;
-#ifdef DEBUG_GESTURES
-			xf86Msg(X_INFO, "trigger_drag_start: drag canceled, moved too far\n");
-#endif
+			trace(TRACE_GESTURES, "trigger_drag_start: drag canceled, moved too far\n");
 		}
 	}
 	return gs->move_drag != GS_DRAG_WAIT;
@@ -153,95 +134,67 @@ static void trigger_drag_stop(struct Gestures* gs, int force)
 	if (gs->move_drag == GS_DRAG_READY && force) {
 		gs->move_drag = GS_NONE;
 		timerclear(&gs->move_drag_expire);
-#ifdef DEBUG_GESTURES
-		xf86Msg(X_INFO, "trigger_drag_stop: drag canceled\n");
-#endif
+		trace(TRACE_GESTURES, "trigger_drag_stop: drag canceled\n");
 	}
 	else if (gs->move_drag == GS_DRAG_ACTIVE) {
 		gs->move_drag = GS_NONE;
 		timerclear(&gs->move_drag_expire);
 		trigger_button_up(gs, 0);
-#ifdef DEBUG_GESTURES
-		xf86Msg(X_INFO, "trigger_drag_stop: drag stopped\n");
-#endif
+		trace(TRACE_GESTURES, "trigger_drag_stop: drag stopped\n");
 	}
 }
 
 static void buttons_update(struct Gestures* gs,
 			const struct MConfig* cfg,
+			const struct MConfigDerived* drv,
 			const struct HWState* hs,
 			struct MTState* ms)
 {
 	if (!cfg->button_enable || cfg->trackpad_disable >= 3)
 		return;
 
-	static bitmask_t button_prev = 0U;
+	buttonset_t changed;
 	int i, down, emulate, touching;
 	down = 0;
-	emulate = GETBIT(hs->button, 0) && !GETBIT(button_prev, 0);
+	emulate = bitset_get(hs->button, 0) && !bitset_get(gs->button_prev, 0);
 
-	for (i = 0; i < 32; i++) {
-		if (GETBIT(hs->button, i) == GETBIT(button_prev, i))
-			continue;
-		if (GETBIT(hs->button, i)) {
+	bitset_xor(changed, hs->button, gs->button_prev);
+	foreach_bit(i, changed) {
+		if (bitset_get(hs->button, i)) {
 			down++;
 			trigger_button_down(gs, i);
 		}
 		else
 			trigger_button_up(gs, i);
 	}
-	button_prev = hs->button;
+	gs->button_prev = hs->button;
 
 	if (down) {
-		int earliest, latest, moving = 0;
+		int earliest = ms->agg.earliest, latest = ms->agg.latest;
 		gs->move_type = GS_NONE;
 		timeraddms(&gs->time, cfg->gesture_wait, &gs->move_wait);
-		earliest = -1;
-		latest = -1;
-		foreach_bit(i, ms->touch_used) {
-			if (GETBIT(ms->touch[i].state, MT_INVALID))
-				continue;
-			if (cfg->button_integrated && !GETBIT(ms->touch[i].flags, GS_BUTTON))
-				SETBIT(ms->touch[i].flags, GS_BUTTON);
-			if (earliest == -1 || timercmp(&ms->touch[i].down, &ms->touch[earliest].down, <))
-				earliest = i;
-			if (latest == -1 || timercmp(&ms->touch[i].down, &ms->touch[latest].down, >))
-				latest = i;
+		if (cfg->button_integrated) {
+			foreach_bit(i, ms->agg.valid.set)
+				touch_flag_set(ms, i, GS_BUTTON);
 		}
 
 		if (emulate) {
 			if (cfg->button_zones && earliest >= 0) {
-				int zones, left, right, pos;
-				double width;
-
-				zones = 0;
-				if (cfg->button_1touch > 0)
-					zones++;
-				if (cfg->button_2touch > 0)
-					zones++;
-				if (cfg->button_3touch > 0)
-					zones++;
-
-				if (zones > 0) {
-					width = ((double)cfg->pad_width)/((double)zones);
-					pos = cfg->pad_width / 2 + ms->touch[earliest].x;
-#ifdef DEBUG_GESTURES
-					xf86Msg(X_INFO, "buttons_update: pad width %d, zones %d, zone width %f, x %d\n",
-						cfg->pad_width, zones, width, pos);
-#endif
-					for (i = 0; i < zones; i++) {
-						left = width*i;
-						right = width*(i+1);
-						if (pos >= left && pos <= right) {
-#ifdef DEBUG_GESTURES
-							xf86Msg(X_INFO, "buttons_update: button %d, left %d, right %d (found)\n", i, left, right);
-#endif
+				int left, pos;
+
+				if (drv->zone_count > 0) {
+					pos = drv->zone_offset + ms->motion.x[earliest];
+					trace(TRACE_GESTURES, "buttons_update: pad width %d, zones %d, x %d\n",
+						cfg->pad_width, drv->zone_count, pos);
+					left = 0;
+					for (i = 0; i < drv->zone_count; i++) {
+						if (pos >= left && pos <= drv->zone_right[i]) {
+							trace(TRACE_GESTURES, "buttons_update: button %d, left %d, right %d (found)\n", i, left, drv->zone_right[i]);
 							break;
 						}
-#ifdef DEBUG_GESTURES
 						else
-							xf86Msg(X_INFO, "buttons_update: button %d, left %d, right %d\n", i, left, right);
-#endif
+							trace(TRACE_GESTURES, "buttons_update: button %d, left %d, right %d\n", i, left, drv->zone_right[i]);
+						left = drv->zone_right[i];
 					}
 
 					if (i == 0)
@@ -277,24 +230,14 @@ static void buttons_update(struct Gestures* gs,
 
 static void tapping_update(struct Gestures* gs,
 			const struct MConfig* cfg,
+			const struct MConfigDerived* drv,
 			struct MTState* ms)
 {
-	int i, n, dist, released_max;
+	int i, n, dist;
 	struct timeval tv_tmp;
 	struct timeval epoch;
 
-	if (cfg->trackpad_disable >= 1)
-		return;
-
-	if (cfg->tap_4touch > 0)
-		released_max = 4;
-	else if (cfg->tap_3touch > 0)
-		released_max = 3;
-	else if (cfg->tap_2touch > 0)
-		released_max = 2;
-	else if (cfg->tap_1touch > 0)
-		released_max = 1;
-	else
+	if (cfg->trackpad_disable >= 1 || drv->tap_max == 0)
 		return;
 
 	timerclear(&epoch);
@@ -304,61 +247,49 @@ static void tapping_update(struct Gestures* gs,
 		gs->tap_released = 0;
 		timerclear(&gs->tap_time_down);
 
-		foreach_bit(i, ms->touch_used) {
-			if (GETBIT(ms->touch[i].flags, GS_TAP))
-				CLEARBIT(ms->touch[i].flags, GS_TAP);
-		}
+		foreach_bit(i, ms->touch_used)
+			touch_flag_clear(ms, i, GS_TAP);
 	}
 	else {
 		foreach_bit(i, ms->touch_used) {
 			if (GETBIT(ms->touch[i].state, MT_INVALID) || GETBIT(ms->touch[i].flags, GS_BUTTON)) {
 				if (GETBIT(ms->touch[i].flags, GS_TAP)) {
-					CLEARBIT(ms->touch[i].flags, GS_TAP);
+					touch_flag_clear(ms, i, GS_TAP);
 					gs->tap_touching--;
-#ifdef DEBUG_GESTURES
-					xf86Msg(X_INFO, "tapping_update: tap_touching-- (%d): invalid or button\n", gs->tap_touching);
-#endif
+					trace(TRACE_GESTURES, "tapping_update: tap_touching-- (%d): invalid or button\n", gs->tap_touching);
 				}
 			}
 			else {
 				if (GETBIT(ms->touch[i].state, MT_NEW)) {
-					SETBIT(ms->touch[i].flags, GS_TAP);
+					touch_flag_set(ms, i, GS_TAP);
 					gs->tap_touching++;
-#ifdef DEBUG_GESTURES
-					xf86Msg(X_INFO, "tapping_update: tap_touching++ (%d): new touch\n", gs->tap_touching);
-#endif
+					trace(TRACE_GESTURES, "tapping_update: tap_touching++ (%d): new touch\n", gs->tap_touching);
 					timerclear(&tv_tmp);
 					if (timercmp(&gs->tap_time_down, &epoch, ==))
 						timercp(&gs->tap_time_down, &gs->time);
 				}
 
 				if (GETBIT(ms->touch[i].flags, GS_TAP)) {
-					dist = dist2(ms->touch[i].total_dx, ms->touch[i].total_dy);
-					if (dist >= SQRVAL(cfg->tap_dist)) {
-						CLEARBIT(ms->touch[i].flags, GS_TAP);
+					dist = dist2(ms->motion.total_dx[i], ms->motion.total_dy[i]);
+					if (dist >= drv->tap_dist) {
+						touch_flag_clear(ms, i, GS_TAP);
 						gs->tap_touching--;
-#ifdef DEBUG_GESTURES
-					xf86Msg(X_INFO, "tapping_update: tap_touching-- (%d): moved too far\n", gs->tap_touching);
-#endif
+					trace(TRACE_GESTURES, "tapping_update: tap_touching-- (%d): moved too far\n", gs->tap_touching);
 					}
 					else if (GETBIT(ms->touch[i].state, MT_RELEASED)) {
 						gs->tap_touching--;
 						gs->tap_released++;
-#ifdef DEBUG_GESTURES
-					xf86Msg(X_INFO, "tapping_update: tap_touching-- (%d): released\n", gs->tap_touching);
-					xf86Msg(X_INFO, "tapping_update: tap_released++ (%d) (max %d): released\n", gs->tap_released, released_max);
-#endif
+					trace(TRACE_GESTURES, "tapping_update: tap_touching-- (%d): released\n", gs->tap_touching);
+					trace(TRACE_GESTURES, "tapping_update: tap_released++ (%d) (max %d): released\n", gs->tap_released, drv->tap_max);
 					}
 				}
 			}
 		}
 	}
 
-	if ((gs->tap_touching == 0 && gs->tap_released > 0) || gs->tap_released >= released_max) {
-		foreach_bit(i, ms->touch_used) {
-			if (GETBIT(ms->touch[i].flags, GS_TAP))
-				CLEARBIT(ms->touch[i].flags, GS_TAP);
-		}
+	if ((gs->tap_touching == 0 && gs->tap_released > 0) || gs->tap_released >= drv->tap_max) {
+		foreach_bit(i, ms->touch_used)
+			touch_flag_clear(ms, i, GS_TAP);
 
 		if (gs->tap_released == 1)
 			n = cfg->tap_1touch - 1;
@@ -384,10 +315,11 @@ static void tapping_update(struct Gestures* gs,
 
 static void trigger_move(struct Gestures* gs,
 			const struct MConfig* cfg,
+			const struct MConfigDerived* drv,
 			int dx, int dy)
 {
 	if ((gs->move_type == GS_MOVE || !timercmp(&gs->time, &gs->move_wait, <)) && (dx != 0 || dy != 0)) {
-		if (trigger_drag_start(gs, cfg, dx, dy)) {
+		if (trigger_drag_start(gs, cfg, drv, dx, dy)) {
 			gs->move_dx = (int)(dx*cfg->sensitivity);
 			gs->move_dy = (int)(dy*cfg->sensitivity);
 			gs->move_type = GS_MOVE;
@@ -395,10 +327,8 @@ static void trigger_move(struct Gestures* gs,
 			gs->move_dir = TR_NONE;
 			gs->move_speed = hypot(gs->move_dx, gs->move_dy)/timertomicro(&gs->dt);
 			timerclear(&gs->move_wait);
-#ifdef DEBUG_GESTURES
-			xf86Msg(X_INFO, "trigger_move: %d, %d (speed %f)\n",
+			trace(TRACE_GESTURES, "trigger_move: %d, %d (speed %f)\n",
 				gs->move_dx, gs->move_dy, gs->move_speed);
-#endif
 		}
 	}
 }
@@ -432,10 +362,8 @@ static void trigger_scroll(struct Gestures* gs,
 			else if (dir == TR_DIR_RT)
 				trigger_button_click(gs, cfg->scroll_rt_btn - 1, &tv_tmp);
 		}
-#ifdef DEBUG_GESTURES
-		xf86Msg(X_INFO, "trigger_scroll: scrolling %+f in direction %d (at %d of %d) (speed %f)\n",
+		trace(TRACE_GESTURES, "trigger_scroll: scrolling %+f in direction %d (at %d of %d) (speed %f)\n",
 			dist, dir, gs->move_dist, cfg->scroll_dist, gs->move_speed);
-#endif
 	}
 }
 
@@ -469,10 +397,8 @@ static void trigger_swipe(struct Gestures* gs,
 				else if (dir == TR_DIR_RT)
 					trigger_button_click(gs, cfg->swipe4_rt_btn - 1, &tv_tmp);
 			}
-#ifdef DEBUG_GESTURES
-			xf86Msg(X_INFO, "trigger_swipe4: swiping %+f in direction %d (at %d of %d) (speed %f)\n",
+			trace(TRACE_GESTURES, "trigger_swipe4: swiping %+f in direction %d (at %d of %d) (speed %f)\n",
 				dist, dir, gs->move_dist, cfg->swipe_dist, gs->move_speed);
-#endif
 		}
 		else {
 			if (cfg->swipe_dist > 0 && gs->move_dist >= cfg->swipe_dist) {
@@ -486,9 +412,7 @@ static void trigger_swipe(struct Gestures* gs,
 				else if (dir == TR_DIR_RT)
 					trigger_button_click(gs, cfg->swipe_rt_btn - 1, &tv_tmp);
 			}
-#ifdef DEBUG_GESTURES
-			xf86Msg(X_INFO, "trigger_swipe: swiping %+f in direction %d (at %d of %d)\n", dist, dir, gs->move_dist, cfg->swipe_dist);
-#endif
+			trace(TRACE_GESTURES, "trigger_swipe: swiping %+f in direction %d (at %d of %d)\n", dist, dir, gs->move_dist, cfg->swipe_dist);
 		}
 	}
 }
@@ -517,10 +441,8 @@ static void trigger_scale(struct Gestures* gs,
 			else if (dir == TR_DIR_DN)
 				trigger_button_click(gs, cfg->scale_dn_btn - 1, &tv_tmp);
 		}
-#ifdef DEBUG_GESTURES
-		xf86Msg(X_INFO, "trigger_scale: scaling %+f in direction %d (at %d of %d) (speed %f)\n",
+		trace(TRACE_GESTURES, "trigger_scale: scaling %+f in direction %d (at %d of %d) (speed %f)\n",
 			dist, dir, gs->move_dist, cfg->scale_dist, gs->move_speed);
-#endif
 	}
 }
 
@@ -548,10 +470,8 @@ static void trigger_rotate(struct Gestures* gs,
 			else if (dir == TR_DIR_RT)
 				trigger_button_click(gs, cfg->rotate_rt_btn - 1, &tv_tmp);
 		}
-#ifdef DEBUG_GESTURES
-		xf86Msg(X_INFO, "trigger_rotate: rotating %+f in direction %d (at %d of %d) (speed %f)\n",
+		trace(TRACE_GESTURES, "trigger_rotate: rotating %+f in direction %d (at %d of %d) (speed %f)\n",
 			dist, dir, gs->move_dist, cfg->rotate_dist, gs->move_speed);
-#endif
 	}
 }
 
@@ -578,32 +498,90 @@ static int get_scroll_dir(const struct Touch* t1,
 	return TR_NONE;
 }
 
-static int get_rotate_dir(const struct Touch* t1,
-			const struct Touch* t2)
+/* Forget the pair of fingers.
+ */
+static void pinch_reset(struct Gestures* gs)
 {
-	double v, d1, d2;
-	v = trig_direction(t2->x - t1->x, t2->y - t1->y);
-	d1 = trig_angles_add(v, 2);
-	d2 = trig_angles_sub(v, 2);
-	if (trig_angles_acute(t1->direction, d1) < 2 && trig_angles_acute(t2->direction, d2) < 2)
-		return TR_DIR_RT;
-	else if (trig_angles_acute(t1->direction, d2) < 2 && trig_angles_acute(t2->direction, d1) < 2)
-		return TR_DIR_LT;
-	return TR_NONE;
+	gs->pinch_id[0] = -1;
+	gs->pinch_id[1] = -1;
+	gs->pinch_scale = 1;
+	gs->pinch_angle = 0;
+	gs->pinch_radial = 0;
+	gs->pinch_arc = 0;
 }
 
-static int get_scale_dir(const struct Touch* t1,
-			const struct Touch* t2)
+/* Follow the distance and the angle between touches i1 and i2. The
+ * change since the last frame goes to the scale and the angle, and per
+ * finger, along the line between them and across it, to the change
+ * waiting to be fed to a gesture. A new pair starts from where it is.
+ */
+static void pinch_update(struct Gestures* gs, const struct MTState* ms, int i1, int i2)
 {
-	double v;
-	if (trig_angles_acute(t1->direction, t2->direction) >= 2) {
-		v = trig_direction(t2->x - t1->x, t2->y - t1->y);
-		if (trig_angles_acute(v, t1->direction) < 2)
-			return TR_DIR_DN;
-		else
-			return TR_DIR_UP;
+	const struct TouchMotion* tm = &ms->motion;
+	double x = tm->x[i2] - tm->x[i1];
+	double y = tm->y[i2] - tm->y[i1];
+	double dist = hypot(x, y);
+	double turn = atan2(y, x);
+	double delta;
+
+	if (gs->pinch_id[0] != ms->touch[i1].tracking_id ||
+			gs->pinch_id[1] != ms->touch[i2].tracking_id) {
+		pinch_reset(gs);
+		gs->pinch_id[0] = ms->touch[i1].tracking_id;
+		gs->pinch_id[1] = ms->touch[i2].tracking_id;
+		gs->pinch_start = dist;
+		gs->pinch_dist = dist;
+		gs->pinch_turn = turn;
+		return;
+	}
+
+	delta = remainder(turn - gs->pinch_turn, 2*M_PI);
+	gs->pinch_scale = gs->pinch_start > 0 ? dist/gs->pinch_start : 1;
+	gs->pinch_angle += delta;
+	gs->pinch_radial += (dist - gs->pinch_dist)/2;
+	gs->pinch_arc += delta*dist/2;
+	gs->pinch_dist = dist;
+	gs->pinch_turn = turn;
+}
+
+/* Feed the change between the pair to a scale or a rotation. Once one
+ * is under way it takes every whole unit until it times out. Otherwise
+ * nothing happens until the distance or the angle changed by the
+ * threshold, then the larger of the two decides.
+ */
+static void pinch_trigger(struct Gestures* gs, const struct MConfig* cfg)
+{
+	int type, units;
+
+	if ((gs->move_type == GS_SCALE || gs->move_type == GS_ROTATE) &&
+			timercmp(&gs->time, &gs->move_wait, <))
+		type = gs->move_type;
+	else if (MAXVAL(ABSVAL(gs->pinch_radial), ABSVAL(gs->pinch_arc)) >= cfg->pinch_threshold)
+		type = ABSVAL(gs->pinch_radial) >= ABSVAL(gs->pinch_arc) ? GS_SCALE : GS_ROTATE;
+	else
+		return;
+
+	units = (int)(type == GS_SCALE ? gs->pinch_radial : gs->pinch_arc);
+	if (units == 0)
+		return;
+
+	// The angle grows clockwise, which is a rotation to the left.
+	if (type == GS_SCALE)
+		trigger_scale(gs, cfg, units, units > 0 ? TR_DIR_UP : TR_DIR_DN);
+	else
+		trigger_rotate(gs, cfg, units, units > 0 ? TR_DIR_LT : TR_DIR_RT);
+	if (gs->move_type != type)
+		return;
+
+	// Keep the fraction, drop the change the other way.
+	if (type == GS_SCALE) {
+		gs->pinch_radial -= units;
+		gs->pinch_arc = 0;
+	}
+	else {
+		gs->pinch_arc -= units;
+		gs->pinch_radial = 0;
 	}
-	return TR_NONE;
 }
 
 static int get_swipe_dir(const struct Touch* t1,
@@ -632,78 +610,80 @@ static int get_swipe4_dir(const struct Touch* t1,
 
 static void moving_update(struct Gestures* gs,
 			const struct MConfig* cfg,
+			const struct MConfigDerived* drv,
 			struct MTState* ms)
 {
+	const struct TouchMotion* tm = &ms->motion;
+	const struct TouchGroup* btn = &ms->agg.flagged[GS_BUTTON];
+	touchset_t moving;
 	int i, count, btn_count, dx, dy, dir;
 	double dist;
-	struct Touch* touches[4];
-	count = btn_count = 0;
-	dx = dy = 0;
+	int t[4];
 	dir = 0;
 
 	// Reset movement.
 	gs->move_dx = 0;
 	gs->move_dy = 0;
 
-	// Count touches and aggregate touch movements.
-	foreach_bit(i, ms->touch_used) {
-		if (GETBIT(ms->touch[i].state, MT_INVALID))
-			continue;
-		else if (GETBIT(ms->touch[i].flags, GS_BUTTON)) {
-			btn_count++;
-			dx += ms->touch[i].dx;
-			dy += ms->touch[i].dy;
-		}
-		else if (!GETBIT(ms->touch[i].flags, GS_TAP)) {
-			if (count < 4)
-				touches[count++] = &ms->touch[i];
-		}
+	// Button touches move the pointer together, the first four touches
+	// that are neither button nor tap touches make the gesture.
+	btn_count = touch_group_count(btn);
+	dx = btn->dx;
+	dy = btn->dy;
+	bitset_andnot(moving, ms->agg.valid.set, btn->set);
+	bitset_andnot(moving, moving, ms->agg.flagged[GS_TAP].set);
+	count = 0;
+	foreach_bit(i, moving) {
+		t[count++] = i;
+		if (count == 4)
+			break;
 	}
 
+	if (count != 2 || cfg->trackpad_disable >= 1)
+		pinch_reset(gs);
+
 	// Determine gesture type.
 	if (count == 0) {
 		if (btn_count >= 1 && cfg->trackpad_disable < 2)
-			trigger_move(gs, cfg, dx, dy);
+			trigger_move(gs, cfg, drv, dx, dy);
 		else if (btn_count < 1)
 			trigger_reset(gs);
 	}
 	else if (count == 1 && cfg->trackpad_disable < 2) {
-		dx += touches[0]->dx;
-		dy += touches[0]->dy;
-		trigger_move(gs, cfg, dx, dy);
+		dx += tm->dx[t[0]];
+		dy += tm->dy[t[0]];
+		trigger_move(gs, cfg, drv, dx, dy);
 	}
 	else if (count == 2 && cfg->trackpad_disable < 1) {
 		// scroll, scale, or rotate
-		if ((dir = get_scroll_dir(touches[0], touches[1])) != TR_NONE) {
+		pinch_update(gs, ms, t[0], t[1]);
+		if ((dir = get_scroll_dir(&ms->touch[t[0]], &ms->touch[t[1]])) != TR_NONE) {
 			dist = hypot(
-				touches[0]->dx + touches[1]->dx,
-				touches[0]->dy + touches[1]->dy);
+				tm->dx[t[0]] + tm->dx[t[1]],
+				tm->dy[t[0]] + tm->dy[t[1]]);
 			trigger_scroll(gs, cfg, dist/2, dir);
+			if (gs->move_type == GS_SCROLL) {
+				gs->pinch_radial = 0;
+				gs->pinch_arc = 0;
+			}
 		}
-		else if ((dir = get_rotate_dir(touches[0], touches[1])) != TR_NONE) {
-			dist = ABSVAL(hypot(touches[0]->dx, touches[0]->dy)) +
-				ABSVAL(hypot(touches[1]->dx, touches[1]->dy));
-			trigger_rotate(gs, cfg, dist/2, dir);
-		}
-		else if ((dir = get_scale_dir(touches[0], touches[1])) != TR_NONE) {
-			dist = ABSVAL(hypot(touches[0]->dx, touches[0]->dy)) +
-				ABSVAL(hypot(touches[1]->dx, touches[1]->dy));
-			trigger_scale(gs, cfg, dist/2, dir);
-		}
+		else
+			pinch_trigger(gs, cfg);
 	}
 	else if (count == 3 && cfg->trackpad_disable < 1) {
-		if ((dir = get_swipe_dir(touches[0], touches[1], touches[2])) != TR_NONE) {
+		if ((dir = get_swipe_dir(&ms->touch[t[0]], &ms->touch[t[1]], &ms->touch[t[2]])) != TR_NONE) {
 			dist = hypot(
-				touches[0]->dx + touches[1]->dx + touches[2]->dx,
-				touches[0]->dy + touches[1]->dy + touches[2]->dy);
+				tm->dx[t[0]] + tm->dx[t[1]] + tm->dx[t[2]],
+				tm->dy[t[0]] + tm->dy[t[1]] + tm->dy[t[2]]);
 			trigger_swipe(gs, cfg, dist/3, dir, 0);
 		}
 	}
 	else if (count == 4 && cfg->trackpad_disable < 1) {
-		if ((dir = get_swipe4_dir(touches[0], touches[1], touches[2], touches[3])) != TR_NONE) {
+		if ((dir = get_swipe4_dir(&ms->touch[t[0]], &ms->touch[t[1]],
+					&ms->touch[t[2]], &ms->touch[t[3]])) != TR_NONE) {
 			dist = hypot(
-				touches[0]->dx + touches[1]->dx + touches[2]->dx + touches[3]->dx,
-				touches[0]->dy + touches[1]->dy + touches[2]->dy + touches[3]->dy);
+				tm->dx[t[0]] + tm->dx[t[1]] + tm->dx[t[2]] + tm->dx[t[3]],
+				tm->dy[t[0]] + tm->dy[t[1]] + tm->dy[t[2]] + tm->dy[t[3]]);
 			trigger_swipe(gs, cfg, dist/4, dir, 1);
 		}
 	}
@@ -712,9 +692,7 @@ static void moving_update(struct Gestures* gs,
 static void dragging_update(struct Gestures* gs)
 {
 	if (gs->move_drag == GS_DRAG_READY && timercmp(&gs->time, &gs->move_drag_expire, >)) {
-#ifdef DEBUG_GESTURES
-		xf86Msg(X_INFO, "dragging_update: drag expired\n");
-#endif
+		trace(TRACE_GESTURES, "dragging_update: drag expired\n");
 		trigger_drag_stop(gs, 1);
 	}
 }
@@ -728,9 +706,7 @@ static void delayed_update(struct Gestures* gs)
 		return;
 
 	if (!timercmp(&gs->time, &gs->button_delayed_time, <)) {
-#ifdef DEBUG_GESTURES
-		xf86Msg(X_INFO, "delayed_update: %d delay expired, triggering up\n", gs->button_delayed);
-#endif
+		trace(TRACE_GESTURES, "delayed_update: %d delay expired, triggering up\n", gs->button_delayed);
 		trigger_button_up(gs, gs->button_delayed);
 		gs->button_delayed = 0;
 		timerclear(&gs->button_delayed_time);
@@ -744,22 +720,85 @@ static void delayed_update(struct Gestures* gs)
 void gestures_init(struct MTouch* mt)
 {
 	memset(&mt->gs, 0, sizeof(struct Gestures));
+	pinch_reset(&mt->gs);
 }
 
-void gestures_extract(struct MTouch* mt)
+static void gestures_time(struct MTouch* mt)
 {
 	timersub(&mt->hs.evtime, &mt->gs.time, &mt->gs.dt);
 	timercp(&mt->gs.time, &mt->hs.evtime);
+}
 
+static void gestures_reset(struct Gestures* gs,
+			struct MTState* ms)
+{
+	int i;
+
+	gs->move_dx = 0;
+	gs->move_dy = 0;
+	gs->move_type = GS_NONE;
+	gs->move_dist = 0;
+	gs->move_dir = TR_NONE;
+	timerclear(&gs->move_wait);
+	pinch_reset(gs);
+
+	gs->tap_touching = 0;
+	gs->tap_released = 0;
+	timerclear(&gs->tap_time_down);
+	foreach_bit(i, ms->touch_used)
+		touch_flag_clear(ms, i, GS_TAP);
+}
+
+void gestures_reconfigure(struct MTouch* mt)
+{
+	gestures_reset(&mt->gs, &mt->state);
+	trace(TRACE_GESTURES, "gestures_reconfigure: gesture state reset\n");
+}
+
+void gestures_extract(struct MTouch* mt)
+{
+	gestures_time(mt);
+
+	dragging_update(&mt->gs);
+	buttons_update(&mt->gs, mt->cfg_live, mt->drv_live, &mt->hs, &mt->state);
+	tapping_update(&mt->gs, mt->cfg_live, mt->drv_live, &mt->state);
+	moving_update(&mt->gs, mt->cfg_live, mt->drv_live, &mt->state);
+	delayed_update(&mt->gs);
+}
+
+void gestures_idle(struct MTouch* mt)
+{
+	gestures_time(mt);
+	mt->gs.move_dx = 0;
+	mt->gs.move_dy = 0;
 	dragging_update(&mt->gs);
-	buttons_update(&mt->gs, &mt->cfg, &mt->hs, &mt->state);
-	tapping_update(&mt->gs, &mt->cfg, &mt->state);
-	moving_update(&mt->gs, &mt->cfg, &mt->state);
+	delayed_update(&mt->gs);
+}
+
+void gestures_disabled(struct MTouch* mt)
+{
+	gestures_time(mt);
+	mt->gs.button_prev = mt->hs.button;
+	if (bitset_any(mt->state.touch_used)) {
+		trigger_drag_stop(&mt->gs, 1);
+		gestures_reset(&mt->gs, &mt->state);
+		mtstate_init(&mt->state);
+	}
+	mt->gs.move_dx = 0;
+	mt->gs.move_dy = 0;
 	delayed_update(&mt->gs);
 }
 
 static int gestures_sleep(struct MTouch* mt, const struct timeval* sleep)
 {
+	if (mt->replay) {
+		struct timeval until, now;
+		timeradd(&mt->gs.time, sleep, &until);
+		capture_wait(mt->replay, &until, &now);
+		timersub(&now, &mt->gs.time, &mt->gs.dt);
+		timercp(&mt->gs.time, &now);
+		return 1;
+	}
 	if (mtdev_empty(&mt->dev)) {
 		struct timeval now;
 		mtdev_idle(&mt->dev, mt->fd, timertoms(sleep));
@@ -771,6 +810,17 @@ static int gestures_sleep(struct MTouch* mt, const struct timeval* sleep)
 	return 0;
 }
 
+static void gestures_release_delayed(struct Gestures* gs)
+{
+	trace(TRACE_GESTURES, "gestures_delayed: %d up, timer expired\n", gs->button_delayed);
+	trigger_button_up(gs, gs->button_delayed);
+	gs->move_dx = 0;
+	gs->move_dy = 0;
+	gs->button_delayed = 0;
+	timerclear(&gs->button_delayed_time);
+	timerclear(&gs->button_delayed_delta);
+}
+
 int gestures_delayed(struct MTouch* mt)
 {
 	struct Gestures* gs = &mt->gs;
@@ -779,18 +829,22 @@ int gestures_delayed(struct MTouch* mt)
 
 	if (timercmp(&gs->button_delayed_time, &epoch, >)) {
 		if (gestures_sleep(mt, &gs->button_delayed_delta)) {
-#ifdef DEBUG_GESTURES
-			xf86Msg(X_INFO, "gestures_delayed: %d up, timer expired\n", gs->button_delayed);
-#endif
-			trigger_button_up(gs, gs->button_delayed);
-			gs->move_dx = 0;
-			gs->move_dy = 0;
-			gs->button_delayed = 0;
-			timerclear(&gs->button_delayed_time);
-			timerclear(&gs->button_delayed_delta);
+			gestures_release_delayed(gs);
 			return 1;
 		}
 	}
 	return 0;
 }
 
+int gestures_expire(struct MTouch* mt, const struct timeval* now)
+{
+	struct Gestures* gs = &mt->gs;
+
+	if (!timerisset(&gs->button_delayed_time) || timercmp(now, &gs->button_delayed_time, <))
+		return 0;
+	timersub(now, &gs->time, &gs->dt);
+	timercp(&gs->time, now);
+	gestures_release_delayed(gs);
+	return 1;
+}
+
@@ -20,88 +20,126 @@
  **************************************************************************/
 
 #include "hwstate.h"
+#include <limits.h>
+
+#define COPY_TOUCH_MINOR 0
+#define COPY_WIDTH_MINOR 1
 
 void hwstate_init(struct HWState *s, const struct Capabilities *caps)
 {
+	const struct input_absinfo *abs;
 	int i;
 	memset(s, 0, sizeof(struct HWState));
 	for (i = 0; i < DIM_FINGER; i++)
 		s->data[i].tracking_id = MT_ID_NULL;
+	// Devices are not held to their ranges, and uinput devices may send
+	// anything. Axes without a usable range are not clamped.
+	for (i = 0; i < MT_ABS_SIZE; i++) {
+		abs = &caps->abs[i];
+		if (caps->has_abs[i] && abs->maximum > abs->minimum) {
+			s->range[i].minimum = abs->minimum;
+			s->range[i].maximum = abs->maximum;
+		}
+		else {
+			s->range[i].minimum = INT_MIN;
+			s->range[i].maximum = INT_MAX;
+		}
+	}
+	MODBIT(s->copy_minor, COPY_TOUCH_MINOR, !caps->has_abs[MTDEV_TOUCH_MINOR]);
+	MODBIT(s->copy_minor, COPY_WIDTH_MINOR, !caps->has_abs[MTDEV_WIDTH_MINOR]);
 	s->max_x = get_cap_xsize(caps);
 	s->max_y = get_cap_ysize(caps);
 }
 
-static void finish_packet(struct HWState *s, const struct Capabilities *caps,
-			  const struct input_event *syn)
+static void finish_packet(struct HWState *s, const struct input_event *syn)
 {
-	static const mstime_t ms = 1000;
+	fingerset_t changed;
 	int i;
-	foreach_bit(i, s->used) {
-		if (!caps->has_abs[MTDEV_TOUCH_MINOR])
-			s->data[i].touch_minor = s->data[i].touch_major;
-		if (!caps->has_abs[MTDEV_WIDTH_MINOR])
-			s->data[i].width_minor = s->data[i].width_major;
+	s->dirty = s->pending;
+	bitset_zero(s->pending);
+	bitset_xor(s->button_dirty, s->button, s->button_prev);
+	s->button_prev = s->button;
+	if (s->copy_minor) {
+		bitset_and(changed, s->dirty, s->used);
+		foreach_bit(i, changed) {
+			if (GETBIT(s->copy_minor, COPY_TOUCH_MINOR))
+				s->data[i].touch_minor = s->data[i].touch_major;
+			if (GETBIT(s->copy_minor, COPY_WIDTH_MINOR))
+				s->data[i].width_minor = s->data[i].width_major;
+		}
 	}
 	timercp(&s->evtime, &syn->time);
 }
 
-static int read_event(struct HWState *s, const struct Capabilities *caps,
-                      const struct input_event *ev)
+/* Clamp a value to the range of an axis.
+ */
+static inline int clamp_abs(const struct HWState *s, int axis, int value)
+{
+	return CLAMPVAL(value, s->range[axis].minimum, s->range[axis].maximum);
+}
+
+int hwstate_process(struct HWState *s, const struct input_event *ev)
 {
 	switch (ev->type) {
 	case EV_SYN:
 		switch (ev->code) {
 		case SYN_REPORT:
-			finish_packet(s, caps, ev);
+			finish_packet(s, ev);
 			return 1;
+		case SYN_DROPPED:
+			s->dropped++;
+			break;
 		}
 		break;
 	case EV_KEY:
 		switch (ev->code) {
 		case BTN_LEFT:
-			MODBIT(s->button, MT_BUTTON_LEFT, ev->value);
+			bitset_mod(s->button, MT_BUTTON_LEFT, ev->value);
 			break;
 		case BTN_MIDDLE:
-			MODBIT(s->button, MT_BUTTON_MIDDLE, ev->value);
+			bitset_mod(s->button, MT_BUTTON_MIDDLE, ev->value);
 			break;
 		case BTN_RIGHT:
-			MODBIT(s->button, MT_BUTTON_RIGHT, ev->value);
+			bitset_mod(s->button, MT_BUTTON_RIGHT, ev->value);
 			break;
 		}
 		break;
 	case EV_ABS:
+		if (ev->code >= ABS_MT_TOUCH_MAJOR && ev->code != ABS_MT_SLOT)
+			bitset_set(s->pending, s->slot);
 		switch (ev->code) {
 		case ABS_MT_SLOT:
 			if (ev->value >= 0 && ev->value < DIM_FINGER)
 				s->slot = ev->value;
 			break;
 		case ABS_MT_TOUCH_MAJOR:
-			s->data[s->slot].touch_major = ev->value;
+			s->data[s->slot].touch_major = clamp_abs(s, MTDEV_TOUCH_MAJOR, ev->value);
 			break;
 		case ABS_MT_TOUCH_MINOR:
-			s->data[s->slot].touch_minor = ev->value;
+			s->data[s->slot].touch_minor = clamp_abs(s, MTDEV_TOUCH_MINOR, ev->value);
 			break;
 		case ABS_MT_WIDTH_MAJOR:
-			s->data[s->slot].width_major = ev->value;
+			s->data[s->slot].width_major = clamp_abs(s, MTDEV_WIDTH_MAJOR, ev->value);
 			break;
 		case ABS_MT_WIDTH_MINOR:
-			s->data[s->slot].width_minor = ev->value;
+			s->data[s->slot].width_minor = clamp_abs(s, MTDEV_WIDTH_MINOR, ev->value);
 			break;
 		case ABS_MT_ORIENTATION:
-			s->data[s->slot].orientation = ev->value;
+			s->data[s->slot].orientation = clamp_abs(s, MTDEV_ORIENTATION, ev->value);
 			break;
 		case ABS_MT_PRESSURE:
-			s->data[s->slot].pressure = ev->value;
+			s->data[s->slot].pressure = clamp_abs(s, MTDEV_PRESSURE, ev->value);
 			break;
 		case ABS_MT_POSITION_X:
-			s->data[s->slot].position_x = ev->value;
+			s->data[s->slot].position_x = clamp_abs(s, MTDEV_POSITION_X, ev->value);
 			break;
 		case ABS_MT_POSITION_Y:
-			s->data[s->slot].position_y = ev->value;
+			s->data[s->slot].position_y = clamp_abs(s, MTDEV_POSITION_Y, ev->value);
 			break;
 		case ABS_MT_TRACKING_ID:
-			s->data[s->slot].tracking_id = ev->value;
-			MODBIT(s->used, s->slot, ev->value != MT_ID_NULL);
+			// Only -1 ends a contact, but no negative id is a contact.
+			s->data[s->slot].tracking_id = ev->value < 0 ? MT_ID_NULL : ev->value;
+			bitset_mod(s->used, s->slot, ev->value >= 0);
 			break;
 		}
 		break;
@@ -109,18 +147,6 @@ static int read_event(struct HWState *s, const struct Capabilities *caps,
 	return 0;
 }
 
-int hwstate_modify(struct HWState *s, struct mtdev *dev, int fd,
-		   const struct Capabilities *caps)
-{
-	struct input_event ev;
-	int ret;
-	while ((ret = mtdev_get(dev, fd, &ev, 1)) > 0) {
-		if (read_event(s, caps, &ev))
-			return 1;
-	}
-	return ret;
-}
-
 int find_finger(const struct HWState *s, int tracking_id) {
 	int i;
 	foreach_bit(i, s->used) {
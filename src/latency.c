@@ -0,0 +1,74 @@
+/***************************************************************************
+ *
+ * Multitouch X driver
+ * Copyright (C) 2008 Henrik Rydberg <rydberg@euromail.se>
+ * Copyright (C) 2011 Ryan Bourgeois <bluedragonx@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ **************************************************************************/
+
+#include "latency.h"
+
+static const char* stage_names[LATENCY_STAGES] = {
+	"ingest", "state", "gesture", "post", "total", "delayed"
+};
+
+uint64_t latency_bucket_value(int bucket)
+{
+	int shift;
+	if (bucket < LATENCY_SUB)
+		return bucket;
+	shift = bucket / LATENCY_SUB - 1;
+	return (((uint64_t)(LATENCY_SUB + bucket % LATENCY_SUB) + 1) << shift) - 1;
+}
+
+uint64_t latency_percentile(const struct LatencyHistogram* h, double p)
+{
+	uint64_t want, seen = 0;
+	int i;
+	if (!h->count)
+		return 0;
+	want = (uint64_t)(p * h->count + 0.5);
+	want = CLAMPVAL(want, 1, h->count);
+	for (i = 0; i < LATENCY_BUCKETS; i++) {
+		seen += h->buckets[i];
+		if (seen >= want)
+			return MINVAL(latency_bucket_value(i), h->max);
+	}
+	return h->max;
+}
+
+const char* latency_stage_name(int stage)
+{
+	return stage >= 0 && stage < LATENCY_STAGES ? stage_names[stage] : "unknown";
+}
+
+void latency_print(FILE* file, const struct MLatency* lat)
+{
+	int i;
+	fprintf(file, "%-8s %10s %10s %10s %10s %10s %10s\n",
+		"stage", "count", "mean_us", "p50_us", "p90_us", "p99_us", "max_us");
+	for (i = 0; i < LATENCY_STAGES; i++) {
+		const struct LatencyHistogram* h = &lat->stage[i];
+		fprintf(file, "%-8s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+			stage_names[i], (unsigned long long)h->count,
+			h->count ? h->sum / 1000.0 / h->count : 0.0,
+			latency_percentile(h, 0.50) / 1000.0,
+			latency_percentile(h, 0.90) / 1000.0,
+			latency_percentile(h, 0.99) / 1000.0,
+			h->max / 1000.0);
+	}
+}
@@ -20,6 +20,7 @@
  **************************************************************************/
 
 #include "mconfig.h"
+#include <limits.h>
 
 void mconfig_defaults(struct MConfig* cfg)
 {
@@ -44,6 +45,7 @@ void mconfig_defaults(struct MConfig* cfg)
 	cfg->button_1touch = DEFAULT_BUTTON_1TOUCH;
 	cfg->button_2touch = DEFAULT_BUTTON_2TOUCH;
 	cfg->button_3touch = DEFAULT_BUTTON_3TOUCH;
+	cfg->button_move = DEFAULT_BUTTON_MOVE;
 	cfg->tap_1touch = DEFAULT_TAP_1TOUCH;
 	cfg->tap_2touch = DEFAULT_TAP_2TOUCH;
 	cfg->tap_3touch = DEFAULT_TAP_3TOUCH;
@@ -71,11 +73,16 @@ void mconfig_defaults(struct MConfig* cfg)
 	cfg->scale_dist = DEFAULT_SCALE_DIST;
 	cfg->scale_up_btn = DEFAULT_SCALE_UP_BTN;
 	cfg->scale_dn_btn = DEFAULT_SCALE_DN_BTN;
-	cfg->rotate_dist = SQRVAL(DEFAULT_ROTATE_DIST);
+	cfg->rotate_dist = DEFAULT_ROTATE_DIST;
 	cfg->rotate_lt_btn = DEFAULT_ROTATE_LT_BTN;
 	cfg->rotate_rt_btn = DEFAULT_ROTATE_RT_BTN;
+	cfg->pinch_threshold = DEFAULT_PINCH_THRESHOLD;
 	cfg->drag_enable = DEFAULT_DRAG_ENABLE;
 	cfg->drag_timeout = DEFAULT_DRAG_TIMEOUT;
+	cfg->drag_wait = DEFAULT_DRAG_WAIT;
+	cfg->drag_dist = DEFAULT_DRAG_DIST;
+	cfg->axis_x_invert = DEFAULT_AXIS_X_INVERT;
+	cfg->axis_y_invert = DEFAULT_AXIS_Y_INVERT;
 	cfg->sensitivity = DEFAULT_SENSITIVITY;
 }
 
@@ -90,93 +97,169 @@ void mconfig_init(struct MConfig* cfg,
 		cfg->touch_type = MCFG_SCALE;
 		cfg->touch_min = caps->abs[MTDEV_TOUCH_MAJOR].minimum;
 		cfg->touch_max = caps->abs[MTDEV_TOUCH_MAJOR].maximum;
-		xf86Msg(X_INFO, "Touchpad supports regular and approaching touches.\n");
-		xf86Msg(X_INFO, "  touch_min = %d, touch_max = %d\n", cfg->touch_min, cfg->touch_max);
+		mlog(MLOG_INFO, "Touchpad supports regular and approaching touches.\n");
+		mlog(MLOG_INFO, "  touch_min = %d, touch_max = %d\n", cfg->touch_min, cfg->touch_max);
 	}
 	else if (caps->has_abs[MTDEV_TOUCH_MAJOR]) {
 		cfg->touch_type = MCFG_SIZE;
 		cfg->touch_min = caps->abs[MTDEV_TOUCH_MAJOR].minimum;
 		cfg->touch_max = caps->abs[MTDEV_TOUCH_MAJOR].maximum;
-		xf86Msg(X_INFO, "Touchpad supports regular touches.\n");
-		xf86Msg(X_INFO, "  touch_min = %d, touch_max = %d\n", cfg->touch_min, cfg->touch_max);
+		mlog(MLOG_INFO, "Touchpad supports regular touches.\n");
+		mlog(MLOG_INFO, "  touch_min = %d, touch_max = %d\n", cfg->touch_min, cfg->touch_max);
 	}
 	else if (caps->has_abs[MTDEV_PRESSURE]) {
 		cfg->touch_type = MCFG_PRESSURE;
 		cfg->touch_min = caps->abs[MTDEV_PRESSURE].minimum;
 		cfg->touch_max = caps->abs[MTDEV_PRESSURE].maximum;
-		xf86Msg(X_INFO, "Touchpad is pressure based.\n");
-		xf86Msg(X_INFO, "  touch_min = %d, touch_max = %d\n", cfg->touch_min, cfg->touch_max);
+		mlog(MLOG_INFO, "Touchpad is pressure based.\n");
+		mlog(MLOG_INFO, "  touch_min = %d, touch_max = %d\n", cfg->touch_min, cfg->touch_max);
 	}
 	else {
 		cfg->touch_type = MCFG_NONE;
-		xf86Msg(X_WARNING, "Touchpad has minimal capabilities. Some features will be unavailable.\n");
+		mlog(MLOG_WARNING, "Touchpad has minimal capabilities. Some features will be unavailable.\n");
 	}
 
 	if (cfg->touch_minor)
-		xf86Msg(X_INFO, "Touchpad supports minor touch widths.\n");
+		mlog(MLOG_INFO, "Touchpad supports minor touch widths.\n");
+}
+
+/* Option readers that look each option up once. The option source may
+ * log every lookup or, when fuzzing, return something new each time.
+ */
+static int option_range(const struct MOptions* opts, const char* name, int deflt, int min, int max)
+{
+	int value = moptions_int(opts, name, deflt);
+	return CLAMPVAL(value, min, max);
+}
+
+static int option_min(const struct MOptions* opts, const char* name, int deflt, int min)
+{
+	int value = moptions_int(opts, name, deflt);
+	return MAXVAL(value, min);
+}
+
+static double option_real_min(const struct MOptions* opts, const char* name, double deflt, double min)
+{
+	double value = moptions_real(opts, name, deflt);
+	return MAXVAL(value, min);
 }
 
 void mconfig_configure(struct MConfig* cfg,
-			pointer opts)
+			const struct MOptions* opts)
 {
 	// Configure MTState
-	cfg->touch_down = CLAMPVAL(xf86SetIntOption(opts, "FingerHigh", DEFAULT_TOUCH_DOWN), 0, 100);
-	cfg->touch_up = CLAMPVAL(xf86SetIntOption(opts, "FingerLow", DEFAULT_TOUCH_UP), 0, 100);
-	cfg->ignore_thumb = xf86SetBoolOption(opts, "IgnoreThumb", DEFAULT_IGNORE_THUMB);
-	cfg->ignore_palm = xf86SetBoolOption(opts, "IgnorePalm", DEFAULT_IGNORE_PALM);
-	cfg->disable_on_thumb = xf86SetBoolOption(opts, "DisableOnThumb", DEFAULT_DISABLE_ON_THUMB);
-	cfg->disable_on_palm = xf86SetBoolOption(opts, "DisableOnPalm", DEFAULT_DISABLE_ON_PALM);
-	cfg->thumb_ratio = CLAMPVAL(xf86SetIntOption(opts, "ThumbRatio", DEFAULT_THUMB_RATIO), 0, 100);
-	cfg->thumb_size = CLAMPVAL(xf86SetIntOption(opts, "ThumbSize", DEFAULT_THUMB_SIZE), 0, 100);
-	cfg->palm_size = CLAMPVAL(xf86SetIntOption(opts, "PalmSize", DEFAULT_PALM_SIZE), 0, 100);
-	cfg->bottom_edge = CLAMPVAL(xf86SetIntOption(opts, "BottomEdge", DEFAULT_BOTTOM_EDGE), 0, 100);
+	cfg->touch_down = option_range(opts, "FingerHigh", DEFAULT_TOUCH_DOWN, 0, 100);
+	cfg->touch_up = option_range(opts, "FingerLow", DEFAULT_TOUCH_UP, 0, 100);
+	cfg->ignore_thumb = moptions_bool(opts, "IgnoreThumb", DEFAULT_IGNORE_THUMB);
+	cfg->ignore_palm = moptions_bool(opts, "IgnorePalm", DEFAULT_IGNORE_PALM);
+	cfg->disable_on_thumb = moptions_bool(opts, "DisableOnThumb", DEFAULT_DISABLE_ON_THUMB);
+	cfg->disable_on_palm = moptions_bool(opts, "DisableOnPalm", DEFAULT_DISABLE_ON_PALM);
+	cfg->thumb_ratio = option_range(opts, "ThumbRatio", DEFAULT_THUMB_RATIO, 0, 100);
+	cfg->thumb_size = option_range(opts, "ThumbSize", DEFAULT_THUMB_SIZE, 0, 100);
+	cfg->palm_size = option_range(opts, "PalmSize", DEFAULT_PALM_SIZE, 0, 100);
+	cfg->bottom_edge = option_range(opts, "BottomEdge", DEFAULT_BOTTOM_EDGE, 0, 100);
 
 	// Configure Gestures
-	cfg->trackpad_disable = CLAMPVAL(xf86SetIntOption(opts, "TrackpadDisable", DEFAULT_TRACKPAD_DISABLE), 0, 3);
-	cfg->button_enable = xf86SetBoolOption(opts, "ButtonEnable", DEFAULT_BUTTON_ENABLE);
-	cfg->button_integrated = xf86SetBoolOption(opts, "ButtonIntegrated", DEFAULT_BUTTON_INTEGRATED);
-	cfg->button_expire = MAXVAL(xf86SetIntOption(opts, "ButtonTouchExpire", DEFAULT_BUTTON_EXPIRE), 0);
-	cfg->button_zones = xf86SetBoolOption(opts, "ButtonZonesEnable", DEFAULT_BUTTON_ZONES);
-	cfg->button_1touch = CLAMPVAL(xf86SetIntOption(opts, "ClickFinger1", DEFAULT_BUTTON_1TOUCH), 0, 32);
-	cfg->button_2touch = CLAMPVAL(xf86SetIntOption(opts, "ClickFinger2", DEFAULT_BUTTON_2TOUCH), 0, 32);
-	cfg->button_3touch = CLAMPVAL(xf86SetIntOption(opts, "ClickFinger3", DEFAULT_BUTTON_3TOUCH), 0, 32);
-	cfg->button_move = xf86SetBoolOption(opts, "ButtonMoveEmulate", DEFAULT_BUTTON_MOVE);
-	cfg->tap_1touch = CLAMPVAL(xf86SetIntOption(opts, "TapButton1", DEFAULT_TAP_1TOUCH), 0, 32);
-	cfg->tap_2touch = CLAMPVAL(xf86SetIntOption(opts, "TapButton2", DEFAULT_TAP_2TOUCH), 0, 32);
-	cfg->tap_3touch = CLAMPVAL(xf86SetIntOption(opts, "TapButton3", DEFAULT_TAP_3TOUCH), 0, 32);
-	cfg->tap_4touch = CLAMPVAL(xf86SetIntOption(opts, "TapButton4", DEFAULT_TAP_4TOUCH), 0, 32);
-	cfg->tap_hold = MAXVAL(xf86SetIntOption(opts, "ClickTime", DEFAULT_TAP_HOLD), 1);
-	cfg->tap_timeout = MAXVAL(xf86SetIntOption(opts, "MaxTapTime", DEFAULT_TAP_TIMEOUT), 1);
-	cfg->tap_dist = MAXVAL(xf86SetIntOption(opts, "MaxTapMove", DEFAULT_TAP_DIST), 1);
-	cfg->gesture_hold = MAXVAL(xf86SetIntOption(opts, "GestureClickTime", DEFAULT_GESTURE_HOLD), 1);
-	cfg->gesture_wait = MAXVAL(xf86SetIntOption(opts, "GestureWaitTime", DEFAULT_GESTURE_WAIT), 0);
-	cfg->scroll_dist = MAXVAL(xf86SetIntOption(opts, "ScrollDistance", DEFAULT_SCROLL_DIST), 1);
-	cfg->scroll_up_btn = CLAMPVAL(xf86SetIntOption(opts, "ScrollUpButton", DEFAULT_SCROLL_UP_BTN), 0, 32);
-	cfg->scroll_dn_btn = CLAMPVAL(xf86SetIntOption(opts, "ScrollDownButton", DEFAULT_SCROLL_DN_BTN), 0, 32);
-	cfg->scroll_lt_btn = CLAMPVAL(xf86SetIntOption(opts, "ScrollLeftButton", DEFAULT_SCROLL_LT_BTN), 0, 32);
-	cfg->scroll_rt_btn = CLAMPVAL(xf86SetIntOption(opts, "ScrollRightButton", DEFAULT_SCROLL_RT_BTN), 0, 32);
-	cfg->swipe_dist = MAXVAL(xf86SetIntOption(opts, "SwipeDistance", DEFAULT_SWIPE_DIST), 1);
-	cfg->swipe_up_btn = CLAMPVAL(xf86SetIntOption(opts, "SwipeUpButton", DEFAULT_SWIPE_UP_BTN), 0, 32);
-	cfg->swipe_dn_btn = CLAMPVAL(xf86SetIntOption(opts, "SwipeDownButton", DEFAULT_SWIPE_DN_BTN), 0, 32);
-	cfg->swipe_lt_btn = CLAMPVAL(xf86SetIntOption(opts, "SwipeLeftButton", DEFAULT_SWIPE_LT_BTN), 0, 32);
-	cfg->swipe_rt_btn = CLAMPVAL(xf86SetIntOption(opts, "SwipeRightButton", DEFAULT_SWIPE_RT_BTN), 0, 32);
-	cfg->swipe4_dist = MAXVAL(xf86SetIntOption(opts, "Swipe4Distance", DEFAULT_SWIPE4_DIST), 1);
-	cfg->swipe4_up_btn = CLAMPVAL(xf86SetIntOption(opts, "Swipe4UpButton", DEFAULT_SWIPE4_UP_BTN), 0, 32);
-	cfg->swipe4_dn_btn = CLAMPVAL(xf86SetIntOption(opts, "Swipe4DownButton", DEFAULT_SWIPE4_DN_BTN), 0, 32);
-	cfg->swipe4_lt_btn = CLAMPVAL(xf86SetIntOption(opts, "Swipe4LeftButton", DEFAULT_SWIPE4_LT_BTN), 0, 32);
-	cfg->swipe4_rt_btn = CLAMPVAL(xf86SetIntOption(opts, "Swipe4RightButton", DEFAULT_SWIPE4_RT_BTN), 0, 32);
-	cfg->scale_dist = MAXVAL(xf86SetIntOption(opts, "ScaleDistance", DEFAULT_SCALE_DIST), 1);
-	cfg->scale_up_btn = CLAMPVAL(xf86SetIntOption(opts, "ScaleUpButton", DEFAULT_SCALE_UP_BTN), 0, 32);
-	cfg->scale_dn_btn = CLAMPVAL(xf86SetIntOption(opts, "ScaleDownButton", DEFAULT_SCALE_DN_BTN), 0, 32);
-	cfg->rotate_dist = MAXVAL(xf86SetIntOption(opts, "RotateDistance", DEFAULT_ROTATE_DIST), 1);
-	cfg->rotate_lt_btn = CLAMPVAL(xf86SetIntOption(opts, "RotateLeftButton", DEFAULT_ROTATE_LT_BTN), 0, 32);
-	cfg->rotate_rt_btn = CLAMPVAL(xf86SetIntOption(opts, "RotateRightButton", DEFAULT_ROTATE_RT_BTN), 0, 23);
-	cfg->drag_enable = xf86SetBoolOption(opts, "TapDragEnable", DEFAULT_DRAG_ENABLE);
-	cfg->drag_timeout = MAXVAL(xf86SetIntOption(opts, "TapDragTime", DEFAULT_DRAG_TIMEOUT), 1);
-	cfg->drag_wait = MAXVAL(xf86SetIntOption(opts, "TapDragWait", DEFAULT_DRAG_WAIT), 0);
-	cfg->drag_dist = MAXVAL(xf86SetIntOption(opts, "TapDragDist", DEFAULT_DRAG_DIST), 0);
-	cfg->axis_x_invert = xf86SetBoolOption(opts, "AxisXInvert", DEFAULT_AXIS_X_INVERT);
-	cfg->axis_y_invert = xf86SetBoolOption(opts, "AxisYInvert", DEFAULT_AXIS_Y_INVERT);
-	cfg->sensitivity = MAXVAL(xf86SetRealOption(opts, "Sensitivity", DEFAULT_SENSITIVITY), 0);
+	cfg->trackpad_disable = option_range(opts, "TrackpadDisable", DEFAULT_TRACKPAD_DISABLE, 0, 3);
+	cfg->button_enable = moptions_bool(opts, "ButtonEnable", DEFAULT_BUTTON_ENABLE);
+	cfg->button_integrated = moptions_bool(opts, "ButtonIntegrated", DEFAULT_BUTTON_INTEGRATED);
+	cfg->button_expire = option_min(opts, "ButtonTouchExpire", DEFAULT_BUTTON_EXPIRE, 0);
+	cfg->button_zones = moptions_bool(opts, "ButtonZonesEnable", DEFAULT_BUTTON_ZONES);
+	cfg->button_1touch = option_range(opts, "ClickFinger1", DEFAULT_BUTTON_1TOUCH, 0, 32);
+	cfg->button_2touch = option_range(opts, "ClickFinger2", DEFAULT_BUTTON_2TOUCH, 0, 32);
+	cfg->button_3touch = option_range(opts, "ClickFinger3", DEFAULT_BUTTON_3TOUCH, 0, 32);
+	cfg->button_move = moptions_bool(opts, "ButtonMoveEmulate", DEFAULT_BUTTON_MOVE);
+	cfg->tap_1touch = option_range(opts, "TapButton1", DEFAULT_TAP_1TOUCH, 0, 32);
+	cfg->tap_2touch = option_range(opts, "TapButton2", DEFAULT_TAP_2TOUCH, 0, 32);
+	cfg->tap_3touch = option_range(opts, "TapButton3", DEFAULT_TAP_3TOUCH, 0, 32);
+	cfg->tap_4touch = option_range(opts, "TapButton4", DEFAULT_TAP_4TOUCH, 0, 32);
+	cfg->tap_hold = option_min(opts, "ClickTime", DEFAULT_TAP_HOLD, 1);
+	cfg->tap_timeout = option_min(opts, "MaxTapTime", DEFAULT_TAP_TIMEOUT, 1);
+	cfg->tap_dist = option_min(opts, "MaxTapMove", DEFAULT_TAP_DIST, 1);
+	cfg->gesture_hold = option_min(opts, "GestureClickTime", DEFAULT_GESTURE_HOLD, 1);
+	cfg->gesture_wait = option_min(opts, "GestureWaitTime", DEFAULT_GESTURE_WAIT, 0);
+	cfg->scroll_dist = option_min(opts, "ScrollDistance", DEFAULT_SCROLL_DIST, 1);
+	cfg->scroll_up_btn = option_range(opts, "ScrollUpButton", DEFAULT_SCROLL_UP_BTN, 0, 32);
+	cfg->scroll_dn_btn = option_range(opts, "ScrollDownButton", DEFAULT_SCROLL_DN_BTN, 0, 32);
+	cfg->scroll_lt_btn = option_range(opts, "ScrollLeftButton", DEFAULT_SCROLL_LT_BTN, 0, 32);
+	cfg->scroll_rt_btn = option_range(opts, "ScrollRightButton", DEFAULT_SCROLL_RT_BTN, 0, 32);
+	cfg->swipe_dist = option_min(opts, "SwipeDistance", DEFAULT_SWIPE_DIST, 1);
+	cfg->swipe_up_btn = option_range(opts, "SwipeUpButton", DEFAULT_SWIPE_UP_BTN, 0, 32);
+	cfg->swipe_dn_btn = option_range(opts, "SwipeDownButton", DEFAULT_SWIPE_DN_BTN, 0, 32);
+	cfg->swipe_lt_btn = option_range(opts, "SwipeLeftButton", DEFAULT_SWIPE_LT_BTN, 0, 32);
+	cfg->swipe_rt_btn = option_range(opts, "SwipeRightButton", DEFAULT_SWIPE_RT_BTN, 0, 32);
+	cfg->swipe4_dist = option_min(opts, "Swipe4Distance", DEFAULT_SWIPE4_DIST, 1);
+	cfg->swipe4_up_btn = option_range(opts, "Swipe4UpButton", DEFAULT_SWIPE4_UP_BTN, 0, 32);
+	cfg->swipe4_dn_btn = option_range(opts, "Swipe4DownButton", DEFAULT_SWIPE4_DN_BTN, 0, 32);
+	cfg->swipe4_lt_btn = option_range(opts, "Swipe4LeftButton", DEFAULT_SWIPE4_LT_BTN, 0, 32);
+	cfg->swipe4_rt_btn = option_range(opts, "Swipe4RightButton", DEFAULT_SWIPE4_RT_BTN, 0, 32);
+	cfg->scale_dist = option_min(opts, "ScaleDistance", DEFAULT_SCALE_DIST, 1);
+	cfg->scale_up_btn = option_range(opts, "ScaleUpButton", DEFAULT_SCALE_UP_BTN, 0, 32);
+	cfg->scale_dn_btn = option_range(opts, "ScaleDownButton", DEFAULT_SCALE_DN_BTN, 0, 32);
+	cfg->rotate_dist = option_min(opts, "RotateDistance", DEFAULT_ROTATE_DIST, 1);
+	cfg->rotate_lt_btn = option_range(opts, "RotateLeftButton", DEFAULT_ROTATE_LT_BTN, 0, 32);
+	cfg->rotate_rt_btn = option_range(opts, "RotateRightButton", DEFAULT_ROTATE_RT_BTN, 0, 32);
+	cfg->pinch_threshold = option_min(opts, "PinchThreshold", DEFAULT_PINCH_THRESHOLD, 1);
+	cfg->drag_enable = moptions_bool(opts, "TapDragEnable", DEFAULT_DRAG_ENABLE);
+	cfg->drag_timeout = option_min(opts, "TapDragTime", DEFAULT_DRAG_TIMEOUT, 1);
+	cfg->drag_wait = option_min(opts, "TapDragWait", DEFAULT_DRAG_WAIT, 0);
+	cfg->drag_dist = option_min(opts, "TapDragDist", DEFAULT_DRAG_DIST, 0);
+	cfg->axis_x_invert = moptions_bool(opts, "AxisXInvert", DEFAULT_AXIS_X_INVERT);
+	cfg->axis_y_invert = moptions_bool(opts, "AxisYInvert", DEFAULT_AXIS_Y_INVERT);
+	cfg->sensitivity = option_real_min(opts, "Sensitivity", DEFAULT_SENSITIVITY, 0);
+}
+
+/* Square of a distance, saturated so that huge distances stay huge.
+ */
+static int sqr_dist(int dist)
+{
+	return dist > 46340 ? INT_MAX : SQRVAL(dist);
 }
 
+void mconfig_compile(struct MConfigDerived* drv,
+			const struct MConfig* cfg,
+			const struct Capabilities* caps)
+{
+	const struct input_absinfo* x = &caps->abs[MTDEV_POSITION_X];
+	const struct input_absinfo* y = &caps->abs[MTDEV_POSITION_Y];
+	double width;
+	int i;
+
+	memset(drv, 0, sizeof(struct MConfigDerived));
+
+	drv->x_offset = cfg->axis_x_invert ? x->maximum + x->minimum : 0;
+	drv->x_scale = cfg->axis_x_invert ? -1 : 1;
+	drv->y_offset = cfg->axis_y_invert ? y->maximum + y->minimum : 0;
+	drv->y_scale = cfg->axis_y_invert ? -1 : 1;
+
+	drv->touch_min = cfg->touch_min;
+	drv->touch_span = cfg->touch_max - cfg->touch_min;
+	drv->bottom_edge = (100 - cfg->bottom_edge)*cfg->pad_height/100;
+
+	drv->tap_dist = sqr_dist(cfg->tap_dist);
+	drv->drag_dist = sqr_dist(cfg->drag_dist);
+
+	if (cfg->tap_4touch > 0)
+		drv->tap_max = 4;
+	else if (cfg->tap_3touch > 0)
+		drv->tap_max = 3;
+	else if (cfg->tap_2touch > 0)
+		drv->tap_max = 2;
+	else if (cfg->tap_1touch > 0)
+		drv->tap_max = 1;
+	else
+		drv->tap_max = 0;
+
+	if (cfg->button_1touch > 0)
+		drv->zone_count++;
+	if (cfg->button_2touch > 0)
+		drv->zone_count++;
+	if (cfg->button_3touch > 0)
+		drv->zone_count++;
+	if (drv->zone_count > 0) {
+		width = ((double)cfg->pad_width)/((double)drv->zone_count);
+		for (i = 0; i < drv->zone_count; i++)
+			drv->zone_right[i] = width*(i+1);
+	}
+	drv->zone_offset = cfg->pad_width / 2;
+}
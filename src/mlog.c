@@ -0,0 +1,57 @@
+/***************************************************************************
+ *
+ * Multitouch X driver
+ * Copyright (C) 2008 Henrik Rydberg <rydberg@euromail.se>
+ * Copyright (C) 2011 Ryan Bourgeois <bluedragonx@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ **************************************************************************/
+
+#include "mlog.h"
+#include <stdio.h>
+
+void mlog_stderr(int level, const char* format, va_list args)
+{
+	// Keep the prefix with its message when several threads log.
+	flockfile(stderr);
+	if (level == MLOG_WARNING)
+		fputs("warning: ", stderr);
+	else if (level == MLOG_ERROR)
+		fputs("error: ", stderr);
+	vfprintf(stderr, format, args);
+	funlockfile(stderr);
+}
+
+void mlog_quiet(int level, const char* format, va_list args)
+{
+	if (level == MLOG_ERROR)
+		mlog_stderr(level, format, args);
+}
+
+static mlog_handler_t mlog_handler = mlog_stderr;
+
+void mlog_set_handler(mlog_handler_t handler)
+{
+	mlog_handler = handler ? handler : mlog_stderr;
+}
+
+void mlog(int level, const char* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	mlog_handler(level, format, args);
+	va_end(args);
+}
@@ -0,0 +1,145 @@
+/***************************************************************************
+ *
+ * Multitouch X driver
+ * Copyright (C) 2008 Henrik Rydberg <rydberg@euromail.se>
+ * Copyright (C) 2011 Ryan Bourgeois <bluedragonx@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ **************************************************************************/
+
+#include "common.h"
+#include "moptions.h"
+#include <ctype.h>
+#include <strings.h>
+
+static const char* find_value(const struct MOptionStore* store, const char* name)
+{
+	int i;
+	for (i = 0; i < store->count; i++) {
+		if (!strcasecmp(store->items[i].name, name))
+			return store->items[i].value;
+	}
+	return NULL;
+}
+
+static int store_int(void* data, const char* name, int deflt)
+{
+	const char* value = find_value(data, name);
+	char* end;
+	long v;
+	if (!value)
+		return deflt;
+	v = strtol(value, &end, 0);
+	return end != value && *end == '\0' ? (int)v : deflt;
+}
+
+static int store_bool(void* data, const char* name, int deflt)
+{
+	const char* value = find_value(data, name);
+	if (!value)
+		return deflt;
+	if (!strcasecmp(value, "1") || !strcasecmp(value, "on") ||
+	    !strcasecmp(value, "true") || !strcasecmp(value, "yes"))
+		return 1;
+	if (!strcasecmp(value, "0") || !strcasecmp(value, "off") ||
+	    !strcasecmp(value, "false") || !strcasecmp(value, "no"))
+		return 0;
+	return deflt;
+}
+
+static double store_real(void* data, const char* name, double deflt)
+{
+	const char* value = find_value(data, name);
+	char* end;
+	double v;
+	if (!value)
+		return deflt;
+	v = strtod(value, &end);
+	return end != value && *end == '\0' ? v : deflt;
+}
+
+/* Copy at most len - 1 characters of [begin, end) to dest, dropping
+ * surrounding whitespace. Returns 0 if the text fit.
+ */
+static int copy_trimmed(char* dest, size_t len, const char* begin, const char* end)
+{
+	while (begin < end && isspace((unsigned char)*begin))
+		begin++;
+	while (end > begin && isspace((unsigned char)end[-1]))
+		end--;
+	if ((size_t)(end - begin) >= len)
+		return -1;
+	memcpy(dest, begin, end - begin);
+	dest[end - begin] = '\0';
+	return 0;
+}
+
+int moptions_parse(struct MOptionStore* store, const char* option)
+{
+	char name[MOPTIONS_NAME_LEN];
+	const char* eq = strchr(option, '=');
+	int i;
+
+	if (!eq || copy_trimmed(name, sizeof(name), option, eq) || !name[0])
+		return -EINVAL;
+	for (i = 0; i < store->count; i++) {
+		if (!strcasecmp(store->items[i].name, name))
+			break;
+	}
+	if (i == MOPTIONS_MAX)
+		return -EINVAL;
+	if (copy_trimmed(store->items[i].value, MOPTIONS_VALUE_LEN,
+			 eq + 1, eq + strlen(eq)))
+		return -EINVAL;
+	strcpy(store->items[i].name, name);
+	if (i == store->count)
+		store->count++;
+	return 0;
+}
+
+int moptions_load(struct MOptionStore* store, const char* path)
+{
+	char line[256];
+	FILE* file = fopen(path, "r");
+	int ret = 0, lineno = 0;
+	char* p;
+
+	if (!file)
+		return -errno;
+	while (fgets(line, sizeof(line), file)) {
+		lineno++;
+		line[strcspn(line, "\r\n")] = '\0';
+		for (p = line; isspace((unsigned char)*p); p++)
+			;
+		if (*p == '\0' || *p == '#')
+			continue;
+		if (moptions_parse(store, p)) {
+			mlog(MLOG_ERROR, "%s:%d: invalid option \"%s\"\n", path, lineno, p);
+			ret = -EINVAL;
+			break;
+		}
+	}
+	fclose(file);
+	return ret;
+}
+
+void moptions_bind(struct MOptions* opts, const struct MOptionStore* store)
+{
+	opts->data = (void*)store;
+	opts->get_int = store_int;
+	opts->get_bool = store_bool;
+	opts->get_real = store_real;
+}
@@ -22,7 +22,27 @@
 
 #include "mtouch.h"
 
-static const int use_grab = 0;
+void mtouch_init(struct MTouch* mt)
+{
+	memset(mt, 0, sizeof(struct MTouch));
+	// Frames read buffer 0, the others start with the publisher.
+	mt->cfg_shared = 1;
+	mt->cfg_back = 2;
+}
+
+struct MTouch* mtouch_alloc(void)
+{
+	struct MTouch* mt;
+	if (posix_memalign((void**)&mt, CACHELINE, sizeof(struct MTouch)))
+		return NULL;
+	mtouch_init(mt);
+	return mt;
+}
+
+void mtouch_free(struct MTouch* mt)
+{
+	free(mt);
+}
 
 int mtouch_configure(struct MTouch* mt, int fd)
 {
@@ -30,23 +50,79 @@ int mtouch_configure(struct MTouch* mt, int fd)
 	int rc = read_capabilities(&mt->caps, mt->fd);
 	if (rc < 0)
 		return rc;
+	mt->caps_valid = 1;
 	output_capabilities(&mt->caps);
 	return 0;
 }
 
+void mtouch_publish_config(struct MTouch* mt)
+{
+	struct MConfigPub* pub = &mt->pub[mt->cfg_back];
+	unsigned int prev;
+	memcpy(&pub->cfg, &mt->cfg, sizeof(struct MConfig));
+	mconfig_compile(&pub->drv, &pub->cfg, &mt->caps);
+	// A publication the input path has not taken yet comes back to be
+	// written over, the buffer it is reading never does.
+	prev = __atomic_exchange_n(&mt->cfg_shared, mt->cfg_back | MCONFIG_FRESH, __ATOMIC_ACQ_REL);
+	mt->cfg_back = prev & ~MCONFIG_FRESH;
+}
+
+/* Switch to the most recently published configuration, if any. Returns
+ * 1 if the configuration changed.
+ */
+static int mtouch_update_config(struct MTouch* mt)
+{
+	unsigned int shared;
+	if (!(__atomic_load_n(&mt->cfg_shared, __ATOMIC_RELAXED) & MCONFIG_FRESH))
+		return 0;
+	shared = __atomic_exchange_n(&mt->cfg_shared, mt->cfg_front, __ATOMIC_ACQ_REL);
+	mt->cfg_front = shared & ~MCONFIG_FRESH;
+	mt->cfg_live = &mt->pub[mt->cfg_front].cfg;
+	mt->drv_live = &mt->pub[mt->cfg_front].drv;
+	gestures_reconfigure(mt);
+	return 1;
+}
 
-int mtouch_open(struct MTouch* mt, int fd)
+static void mtouch_start(struct MTouch* mt, int cached)
 {
-	int ret;
-	mt->fd = fd;
-	ret = mtdev_open(&mt->dev, mt->fd);
-	if (ret)
-		goto error;
-	mconfig_init(&mt->cfg, &mt->caps);
+	// The published configuration was compiled for these capabilities.
+	if (!cached || !mt->cfg_live) {
+		mconfig_init(&mt->cfg, &mt->caps);
+		mtouch_publish_config(mt);
+	}
 	hwstate_init(&mt->hs, &mt->caps);
 	mtstate_init(&mt->state);
 	gestures_init(mt);
-	if (use_grab) {
+	mtouch_update_config(mt);
+}
+
+int mtouch_open(struct MTouch* mt, int fd)
+{
+	int ret, cached;
+	mt->fd = fd;
+	mt->replay = NULL;
+
+	// Reuse the capabilities read earlier if this is still the same device,
+	// as is the case after a VT switch or resume.
+	cached = mt->caps_valid && match_capabilities(&mt->caps, mt->fd);
+	if (cached) {
+		ret = mtdev_init(&mt->dev);
+		if (ret)
+			goto error;
+		copy_mtdev_capabilities(&mt->dev.caps, &mt->caps);
+	}
+	else {
+		ret = read_capabilities(&mt->caps, mt->fd);
+		if (ret < 0)
+			goto error;
+		mt->caps_valid = 1;
+		ret = mtdev_open(&mt->dev, mt->fd);
+		if (ret)
+			goto error;
+	}
+
+	mtouch_start(mt, cached);
+	if (mt->grab) {
 		SYSCALL(ret = ioctl(fd, EVIOCGRAB, 1));
 		if (ret)
 			goto close;
@@ -58,31 +134,210 @@ int mtouch_open(struct MTouch* mt, int fd)
 	return ret;
 }
 
+int mtouch_open_replay(struct MTouch* mt, struct CaptureReader* replay)
+{
+	mt->fd = -1;
+	mt->replay = replay;
+	memcpy(&mt->caps, &replay->caps, sizeof(struct Capabilities));
+	mt->caps_valid = 1;
+	capture_rewind(replay);
+	mtouch_start(mt, 0);
+	return 0;
+}
 
 int mtouch_close(struct MTouch* mt)
 {
 	int ret;
-	if (use_grab) {
+	if (mt->replay)
+		return 0;
+	if (mt->grab) {
 		SYSCALL(ret = ioctl(mt->fd, EVIOCGRAB, 0));
 		if (ret)
-			xf86Msg(X_WARNING, "mtouch: ungrab failed\n");
+			mlog(MLOG_WARNING, "mtouch: ungrab failed\n");
 	}
 	mtdev_close(&mt->dev);
 	return 0;
 }
 
+static int mtouch_next_event(struct MTouch* mt, struct input_event* ev)
+{
+	if (mt->replay)
+		return capture_read(mt->replay, ev);
+	return mtdev_get(&mt->dev, mt->fd, ev, 1);
+}
+
+static const int latency_stages[MTOUCH_STAGES] = {
+	-1, LATENCY_STATE, LATENCY_GESTURE
+};
+
+/* Nonzero when anything wants the stages of a frame timed.
+ */
+static inline int mtouch_timed(const struct MTouch* mt)
+{
+	return mt->profile || mt->latency || mt->flight;
+}
+
+/* Charge the time since *t to a stage of the profile, the latency
+ * histograms and the flight recorder, if there are any.
+ */
+static inline void mtouch_lap(struct MTouch* mt, int stage, uint64_t* t)
+{
+	uint64_t now;
+	if (!mtouch_timed(mt))
+		return;
+	now = nanotime();
+	if (mt->profile)
+		mt->profile->ns[stage] += now - *t;
+	if (mt->latency && latency_stages[stage] >= 0)
+		latency_record(&mt->latency->stage[latency_stages[stage]], now - *t);
+	if (mt->flight)
+		flight_span(mt->flight, stage, *t, now - *t);
+	*t = now;
+}
+
+/* Nanoseconds since the kernel timestamp of the current frame.
+ */
+static uint64_t mtouch_age(const struct MTouch* mt)
+{
+	struct timeval now, age;
+	microtime(&now);
+	timersub(&now, &mt->hs.evtime, &age);
+	return age.tv_sec < 0 ? 0 : (uint64_t)timertomicro(&age) * 1000;
+}
+
+/* Run the touch state and gestures on a complete frame.
+ */
+static void mtouch_process(struct MTouch* mt, uint64_t* t)
+{
+	int changed = mtouch_update_config(mt);
+
+	// A fully disabled trackpad only follows the physical buttons.
+	if (mt->cfg_live->trackpad_disable >= 3) {
+		gestures_disabled(mt);
+		mtouch_lap(mt, MTOUCH_STAGE_GESTURES, t);
+		return;
+	}
+
+	// Nothing changed since a frame that was already at rest, so the
+	// touch state would come out the same. Only the timers need to run.
+	if (!changed && !bitset_any(mt->hs.dirty) && !bitset_any(mt->hs.button_dirty) &&
+			mt->state.settled) {
+		gestures_idle(mt);
+		mtouch_lap(mt, MTOUCH_STAGE_GESTURES, t);
+		return;
+	}
+
+	mtstate_extract(&mt->state, mt->cfg_live, mt->drv_live, &mt->hs);
+	mtouch_lap(mt, MTOUCH_STAGE_MTSTATE, t);
+	gestures_extract(mt);
+	mtouch_lap(mt, MTOUCH_STAGE_GESTURES, t);
+}
+
 int mtouch_read(struct MTouch* mt)
 {
-	int ret = hwstate_modify(&mt->hs, &mt->dev, mt->fd, &mt->caps);
+	struct input_event ev;
+	uint64_t t = mtouch_timed(mt) ? nanotime() : 0;
+	int ret;
+	while ((ret = mtouch_next_event(mt, &ev)) > 0) {
+		if (mt->record)
+			capture_write(mt->record, &ev);
+		if (mt->flight)
+			flight_event(mt->flight, &ev);
+		if (hwstate_process(&mt->hs, &ev))
+			break;
+	}
 	if (ret <= 0)
 		return ret;
-	mtstate_extract(&mt->state, &mt->cfg, &mt->hs, &mt->caps);
-	gestures_extract(mt);
+	mtouch_lap(mt, MTOUCH_STAGE_HWSTATE, &t);
+	if (mt->profile)
+		mt->profile->frames++;
+	// Capture timestamps say nothing about the latency of a replay.
+	if (mt->latency && !mt->replay) {
+		latency_record(&mt->latency->stage[LATENCY_INGEST], mtouch_age(mt));
+		mt->latency_frame = 1;
+	}
+	mtouch_process(mt, &t);
+	if (mt->flight)
+		flight_decisions(mt->flight, &mt->gs, &mt->state);
+	if (mt->telemetry)
+		telemetry_publish(mt->telemetry, &mt->hs, &mt->state, &mt->gs, mt->latency);
 	return 1;
 }
 
+/* Account for a delayed button that was released after being due at due.
+ */
+static void mtouch_released(struct MTouch* mt, const struct timeval* due)
+{
+	struct timeval late;
+	if (mt->latency && !mt->replay) {
+		timersub(&mt->gs.time, due, &late);
+		latency_record(&mt->latency->stage[LATENCY_DELAYED],
+			late.tv_sec < 0 ? 0 : (uint64_t)timertomicro(&late) * 1000);
+	}
+	if (mt->flight)
+		flight_decisions(mt->flight, &mt->gs, &mt->state);
+	if (mt->telemetry)
+		telemetry_publish(mt->telemetry, &mt->hs, &mt->state, &mt->gs, mt->latency);
+}
+
 int mtouch_delayed(struct MTouch* mt)
 {
-	return gestures_delayed(mt);
+	struct timeval due;
+	timercp(&due, &mt->gs.button_delayed_time);
+	if (!gestures_delayed(mt))
+		return 0;
+	mtouch_released(mt, &due);
+	return 1;
+}
+
+int mtouch_deadline(const struct MTouch* mt, struct timeval* deadline)
+{
+	if (!timerisset(&mt->gs.button_delayed_time))
+		return 0;
+	timercp(deadline, &mt->gs.button_delayed_time);
+	return 1;
+}
+
+int mtouch_expire(struct MTouch* mt, const struct timeval* now)
+{
+	struct timeval due;
+	timercp(&due, &mt->gs.button_delayed_time);
+	if (!gestures_expire(mt, now))
+		return 0;
+	mtouch_released(mt, &due);
+	return 1;
 }
 
+void mtouch_output(struct MTouch* mt, const struct MSink* sink)
+{
+	const struct Gestures* gs = &mt->gs;
+	buttonset_t changed;
+	uint64_t t = mt->latency || mt->flight ? nanotime() : 0;
+	int i, posted;
+
+	bitset_xor(changed, gs->buttons, mt->buttons_posted);
+	posted = bitset_any(changed);
+	foreach_bit(i, changed) {
+		sink->button(sink->data, i + 1, bitset_get(gs->buttons, i));
+	}
+	mt->buttons_posted = gs->buttons;
+
+	if (gs->move_dx != 0 || gs->move_dy != 0) {
+		sink->motion(sink->data, gs->move_dx, gs->move_dy);
+		posted = 1;
+	}
+
+	if (posted && sink->flush)
+		sink->flush(sink->data);
+
+	if (posted && mt->flight)
+		flight_span(mt->flight, FLIGHT_STAGE_POST, t, nanotime() - t);
+	if (mt->latency) {
+		if (posted) {
+			latency_record(&mt->latency->stage[LATENCY_POST], nanotime() - t);
+			if (mt->latency_frame)
+				latency_record(&mt->latency->stage[LATENCY_TOTAL], mtouch_age(mt));
+		}
+		mt->latency_frame = 0;
+	}
+}
@@ -21,29 +21,33 @@
  **************************************************************************/
 
 #include "mtstate.h"
+#include "simd.h"
+#include "trace.h"
 #include "trig.h"
+#include <math.h>
 
 static int inline percentage(int dividend, int divisor)
 {
 	return (double)dividend / (double)divisor * 100;
 }
 
-static int inline touch_range_ratio(const struct MConfig* cfg, int value)
+static int inline touch_range_ratio(const struct MConfigDerived* drv, int value)
 {
-	return (double)(value - cfg->touch_min) / (double)(cfg->touch_max - cfg->touch_min) * 100;
+	return (double)(value - drv->touch_min) / (double)drv->touch_span * 100;
 }
 
 /* Check if a finger is touching the trackpad.
  */
 static int is_touch(const struct MConfig* cfg,
+			const struct MConfigDerived* drv,
 			const struct FingerState* hw)
 {
 	if (cfg->touch_type == MCFG_SCALE)
 		return percentage(hw->touch_major, hw->width_major) > cfg->touch_down;
 	else if (cfg->touch_type == MCFG_SIZE)
-		return touch_range_ratio(cfg, hw->touch_major) > cfg->touch_down;
+		return touch_range_ratio(drv, hw->touch_major) > cfg->touch_down;
 	else if (cfg->touch_type == MCFG_PRESSURE)
-		return touch_range_ratio(cfg, hw->pressure) > cfg->touch_down;
+		return touch_range_ratio(drv, hw->pressure) > cfg->touch_down;
 	else
 		return 1;
 }
@@ -51,19 +55,21 @@ static int is_touch(const struct MConfig* cfg,
 /* Check if a finger is released from the touchpad.
  */
 static int is_release(const struct MConfig* cfg,
+			const struct MConfigDerived* drv,
 			const struct FingerState* hw)
 {
 	if (cfg->touch_type == MCFG_SCALE)
 		return percentage(hw->touch_major, hw->width_major) < cfg->touch_up;
 	else if (cfg->touch_type == MCFG_SIZE)
-		return touch_range_ratio(cfg, hw->touch_major) < cfg->touch_up;
+		return touch_range_ratio(drv, hw->touch_major) < cfg->touch_up;
 	else if (cfg->touch_type == MCFG_PRESSURE)
-		return touch_range_ratio(cfg, hw->pressure) < cfg->touch_up;
+		return touch_range_ratio(drv, hw->pressure) < cfg->touch_up;
 	else
 		return 0;
 }
 
 static int is_thumb(const struct MConfig* cfg,
+			const struct MConfigDerived* drv,
 			const struct FingerState* hw)
 {
 	if (!cfg->touch_minor)
@@ -72,41 +78,34 @@ static int is_thumb(const struct MConfig* cfg,
 	int min = MINVAL(hw->touch_minor, hw->touch_major);
 	int max = MAXVAL(hw->touch_minor, hw->touch_major);
 	int pct = percentage(min, max);
-	int size = touch_range_ratio(cfg, hw->touch_major);
+	int size = touch_range_ratio(drv, hw->touch_major);
 
 	if (pct < cfg->thumb_ratio && size > cfg->thumb_size) {
-#if DEBUG_MTSTATE
-		xf86Msg(X_INFO, "is_thumb: yes %d > %d && %d > %d\n",
+		trace(TRACE_MTSTATE, "is_thumb: yes %d > %d && %d > %d\n",
 			pct, cfg->thumb_ratio, size, cfg->thumb_size);
-#endif
 		return 1;
 	}
 	else {
-#if DEBUG_MTSTATE
-		xf86Msg(X_INFO, "is_thumb: no  %d > %d && %d > %d\n",
+		trace(TRACE_MTSTATE, "is_thumb: no  %d > %d && %d > %d\n",
 			pct, cfg->thumb_ratio, size, cfg->thumb_size);
-#endif
 		return 0;
 	}
 }
 
 static int is_palm(const struct MConfig* cfg,
+			const struct MConfigDerived* drv,
 			const struct FingerState* hw)
 {
 	if (cfg->touch_type != MCFG_SCALE && cfg->touch_type != MCFG_SIZE)
 		return 0;
 
-	int size = touch_range_ratio(cfg, hw->touch_major);
+	int size = touch_range_ratio(drv, hw->touch_major);
 	if (size > cfg->palm_size) {
-#if DEBUG_MTSTATE
-		xf86Msg(X_INFO, "is_palm: yes %d > %d\n", size, cfg->palm_size);
-#endif
+		trace(TRACE_MTSTATE, "is_palm: yes %d > %d\n", size, cfg->palm_size);
 		return 1;
 	}
 	else {
-#if DEBUG_MTSTATE
-		xf86Msg(X_INFO, "is_palm: no  %d > %d\n", size, cfg->palm_size);
-#endif
+		trace(TRACE_MTSTATE, "is_palm: no  %d > %d\n", size, cfg->palm_size);
 		return 0;
 	}
 }
@@ -124,67 +123,132 @@ static int find_touch(struct MTState* ms,
 	return -1;
 }
 
+#ifdef SIMD_LANES
+_Static_assert(DIM_MOTION % SIMD_LANES == 0, "touches must fill whole vectors");
+
+/* The bits of the touches in the vector starting at touch i.
+ */
+#define touch_lanes(s, i) \
+	((unsigned int)((s).w[(i) / BITWORD_BITS] >> ((i) % BITWORD_BITS)) & BITONES(SIMD_LANES))
+#endif
+
+/* Move the touches in moved to the positions in nx and ny, updating
+ * their deltas and totals, and stop the touches in stopped.
+ */
+static void touches_move(struct TouchMotion* tm, const int* nx, const int* ny,
+			const touchset_t* moved, const touchset_t* stopped)
+{
+	int i;
+#ifdef SIMD_LANES
+	simd_t m, s, d;
+	for (i = 0; i < DIM_MOTION; i += SIMD_LANES) {
+		if (!(touch_lanes(*moved, i) | touch_lanes(*stopped, i)))
+			continue;
+		m = simd_expand(touch_lanes(*moved, i));
+		s = simd_expand(touch_lanes(*stopped, i));
+		d = simd_and(m, simd_sub(simd_load(&nx[i]), simd_load(&tm->x[i])));
+		simd_store(&tm->dx[i], simd_or(d, simd_andnot(simd_or(m, s), simd_load(&tm->dx[i]))));
+		simd_store(&tm->total_dx[i], simd_add(simd_load(&tm->total_dx[i]), d));
+		simd_store(&tm->x[i], simd_select(m, simd_load(&nx[i]), simd_load(&tm->x[i])));
+		d = simd_and(m, simd_sub(simd_load(&ny[i]), simd_load(&tm->y[i])));
+		simd_store(&tm->dy[i], simd_or(d, simd_andnot(simd_or(m, s), simd_load(&tm->dy[i]))));
+		simd_store(&tm->total_dy[i], simd_add(simd_load(&tm->total_dy[i]), d));
+		simd_store(&tm->y[i], simd_select(m, simd_load(&ny[i]), simd_load(&tm->y[i])));
+	}
+#else
+	foreach_bit(i, *moved) {
+		tm->dx[i] = nx[i] - tm->x[i];
+		tm->dy[i] = ny[i] - tm->y[i];
+		tm->total_dx[i] += tm->dx[i];
+		tm->total_dy[i] += tm->dy[i];
+		tm->x[i] = nx[i];
+		tm->y[i] = ny[i];
+	}
+	foreach_bit(i, *stopped) {
+		tm->dx[i] = 0;
+		tm->dy[i] = 0;
+	}
+#endif
+}
+
+/* Check whether any of the touches in used moved in the last frame.
+ */
+static int touches_moving(const struct TouchMotion* tm, const touchset_t* used)
+{
+	int i;
+#ifdef SIMD_LANES
+	simd_t v, zero = simd_set1(0);
+	for (i = 0; i < DIM_MOTION; i += SIMD_LANES) {
+		if (!touch_lanes(*used, i))
+			continue;
+		v = simd_cmpeq(simd_or(simd_load(&tm->dx[i]), simd_load(&tm->dy[i])), zero);
+		if (~simd_movemask(v) & touch_lanes(*used, i))
+			return 1;
+	}
+#else
+	foreach_bit(i, *used) {
+		if (tm->dx[i] != 0 || tm->dy[i] != 0)
+			return 1;
+	}
+#endif
+	return 0;
+}
+
+/* Mask of the touches in used below the line y = edge.
+ */
+static touchset_t touches_below(const struct TouchMotion* tm, const touchset_t* used, int edge)
+{
+	touchset_t mask;
+	int i;
+	bitset_zero(mask);
+#ifdef SIMD_LANES
+	simd_t e = simd_set1(edge);
+	for (i = 0; i < DIM_MOTION; i += SIMD_LANES) {
+		if (touch_lanes(*used, i))
+			mask.w[i / BITWORD_BITS] |= (bitword_t)(simd_movemask(simd_cmpgt(simd_load(&tm->y[i]), e)) &
+				touch_lanes(*used, i)) << (i % BITWORD_BITS);
+	}
+#else
+	foreach_bit(i, *used)
+		bitset_mod(mask, i, tm->y[i] > edge);
+#endif
+	return mask;
+}
+
 /* Add a touch to the MTState.  Return the new index of the touch.
  */
 static int touch_append(struct MTState* ms,
-			const struct MConfig* cfg,
-			const struct Capabilities* caps,
+			const struct MConfigDerived* drv,
 			const struct HWState* hs,
 			int fn)
 {
-	int x, y;
-	int n = firstbit(~ms->touch_used);
+	int n = bitset_first_zero(ms->touch_used, DIM_TOUCHES);
 	const struct FingerState* fs = &hs->data[fn];
 	if (n < 0)
-		xf86Msg(X_WARNING, "Too many touches to track. Ignoring touch %d.\n", fs->tracking_id);
+		mlog(MLOG_WARNING, "Too many touches to track. Ignoring touch %d.\n", fs->tracking_id);
 	else {
-		x = cfg->axis_x_invert ? get_cap_xflip(caps, fs->position_x) : fs->position_x;
-		y = cfg->axis_y_invert ? get_cap_yflip(caps, fs->position_y) : fs->position_y;
 		ms->touch[n].state = 0U;
 		ms->touch[n].flags = 0U;
 		timercp(&ms->touch[n].down, &hs->evtime);
 		ms->touch[n].direction = TR_NONE;
 		ms->touch[n].tracking_id = fs->tracking_id;
-		ms->touch[n].x = x;
-		ms->touch[n].y = y;
-		ms->touch[n].dx = 0;
-		ms->touch[n].dy = 0;
-		ms->touch[n].total_dx = 0;
-		ms->touch[n].total_dy = 0;
+		ms->motion.x[n] = drv->x_offset + drv->x_scale*fs->position_x;
+		ms->motion.y[n] = drv->y_offset + drv->y_scale*fs->position_y;
+		ms->motion.dx[n] = 0;
+		ms->motion.dy[n] = 0;
+		ms->motion.total_dx[n] = 0;
+		ms->motion.total_dy[n] = 0;
 		SETBIT(ms->touch[n].state, MT_NEW);
-		SETBIT(ms->touch_used, n);
+		bitset_set(ms->touch_used, n);
 	}
 	return n;
 }
 
-/* Update a touch.
- */
-static void touch_update(struct MTState* ms,
-			const struct MConfig* cfg,
-			const struct Capabilities* caps,
-			const struct FingerState* fs,
-			int touch)
-{
-	int x, y;
-	x = cfg->axis_x_invert ? get_cap_xflip(caps, fs->position_x) : fs->position_x;
-	y = cfg->axis_y_invert ? get_cap_yflip(caps, fs->position_y) : fs->position_y;
-	ms->touch[touch].dx = x - ms->touch[touch].x;
-	ms->touch[touch].dy = y - ms->touch[touch].y;
-	ms->touch[touch].total_dx += ms->touch[touch].dx;
-	ms->touch[touch].total_dy += ms->touch[touch].dy;
-	ms->touch[touch].x = x;
-	ms->touch[touch].y = y;
-	ms->touch[touch].direction = trig_direction(ms->touch[touch].dx, ms->touch[touch].dy);
-	CLEARBIT(ms->touch[touch].state, MT_NEW);
-}
-
-/* Release a touch.
+/* Release a touch. Its motion is stopped by touches_move.
  */
 static void touch_release(struct MTState* ms,
 			int touch)
 {
-	ms->touch[touch].dx = 0;
-	ms->touch[touch].dy = 0;
 	ms->touch[touch].direction = TR_NONE;
 	CLEARBIT(ms->touch[touch].state, MT_NEW);
 	SETBIT(ms->touch[touch].state, MT_RELEASED);
@@ -199,61 +263,100 @@ static void touches_invalidate(struct MTState* ms)
 		SETBIT(ms->touch[i].state, MT_INVALID);
 }
 
-/* Update all touches.
+/* Classify a touch by the size of its finger and its position.
+ * Returns 1 if the touch should disable the trackpad.
+ */
+static int touch_classify(struct MTState* ms,
+			const struct MConfig* cfg,
+			const struct MConfigDerived* drv,
+			const struct FingerState* fs,
+			int below,
+			int n)
+{
+	struct Touch* t = &ms->touch[n];
+
+	// Track and invalidate thumb, palm, and bottom edge touches.
+	MODBIT(t->state, MT_THUMB, is_thumb(cfg, drv, fs));
+	MODBIT(t->state, MT_PALM, is_palm(cfg, drv, fs));
+	if (below) {
+		if (GETBIT(t->state, MT_NEW))
+			SETBIT(t->state, MT_BOTTOM_EDGE);
+	}
+	else
+		CLEARBIT(t->state, MT_BOTTOM_EDGE);
+
+	MODBIT(t->state, MT_INVALID,
+		GETBIT(t->state, MT_THUMB) && cfg->ignore_thumb ||
+		GETBIT(t->state, MT_PALM) && cfg->ignore_palm ||
+		GETBIT(t->state, MT_BOTTOM_EDGE));
+
+	return cfg->disable_on_thumb && GETBIT(t->state, MT_THUMB) ||
+		cfg->disable_on_palm && GETBIT(t->state, MT_PALM);
+}
+
+/* Update all touches. Fingers are matched to touches one at a time, then
+ * the motion of all touches is updated at once and the touches are
+ * classified.
  */
 static void touches_update(struct MTState* ms,
 			const struct MConfig* cfg,
-			const struct HWState* hs,
-			const struct Capabilities* caps)
+			const struct MConfigDerived* drv,
+			const struct HWState* hs)
 {
+	int nx[DIM_MOTION], ny[DIM_MOTION], finger[DIM_TOUCHES];
+	touchset_t moved, stopped, seen, below;
 	int i, n, disable = 0;
+
+	bitset_zero(moved);
+	bitset_zero(stopped);
+	bitset_zero(seen);
+
+	// Lanes that don't move are read and put back as they were.
+	memset(nx, 0, sizeof(nx));
+	memset(ny, 0, sizeof(ny));
+
 	// Release missing touches.
 	foreach_bit(i, ms->touch_used) {
-		if (find_finger(hs, ms->touch[i].tracking_id) == -1)
+		if (find_finger(hs, ms->touch[i].tracking_id) == -1) {
 			touch_release(ms, i);
+			bitset_set(stopped, i);
+		}
 	}
 
 	// Add and update touches.
 	foreach_bit(i, hs->used) {
 		n = find_touch(ms, hs->data[i].tracking_id);
 		if (n >= 0) {
-			if (is_release(cfg, &hs->data[i]))
+			if (is_release(cfg, drv, &hs->data[i])) {
 				touch_release(ms, n);
-			else
-				touch_update(ms, cfg, caps, &hs->data[i], n);
+				bitset_set(stopped, n);
+				bitset_clear(moved, n);
+			}
+			else {
+				nx[n] = drv->x_offset + drv->x_scale*hs->data[i].position_x;
+				ny[n] = drv->y_offset + drv->y_scale*hs->data[i].position_y;
+				CLEARBIT(ms->touch[n].state, MT_NEW);
+				bitset_set(moved, n);
+				bitset_clear(stopped, n);
+			}
 		}
-		else if (is_touch(cfg, &hs->data[i]))
-			n = touch_append(ms, cfg, caps, hs, i);
+		else if (is_touch(cfg, drv, &hs->data[i]))
+			n = touch_append(ms, drv, hs, i);
 
 		if (n >= 0) {
-			// Track and invalidate thumb, palm, and bottom edge touches.
-			if (is_thumb(cfg, &hs->data[i]))
-				SETBIT(ms->touch[n].state, MT_THUMB);
-			else
-				CLEARBIT(ms->touch[n].state, MT_THUMB);
-			
-			if (is_palm(cfg, &hs->data[i]))
-				SETBIT(ms->touch[n].state, MT_PALM);
-			else
-				CLEARBIT(ms->touch[n].state, MT_PALM);
-			
-			if (ms->touch[n].y > (100 - cfg->bottom_edge)*cfg->pad_height/100) {
-				if (GETBIT(ms->touch[n].state, MT_NEW))
-					SETBIT(ms->touch[n].state, MT_BOTTOM_EDGE);
-			}
-			else
-				CLEARBIT(ms->touch[n].state, MT_BOTTOM_EDGE);
-			
-			MODBIT(ms->touch[n].state, MT_INVALID,
-				GETBIT(ms->touch[n].state, MT_THUMB) && cfg->ignore_thumb ||
-				GETBIT(ms->touch[n].state, MT_PALM) && cfg->ignore_palm ||
-				GETBIT(ms->touch[n].state, MT_BOTTOM_EDGE));
-			
-			disable |= cfg->disable_on_thumb && GETBIT(ms->touch[n].state, MT_THUMB);
-			disable |= cfg->disable_on_palm && GETBIT(ms->touch[n].state, MT_PALM);
+			finger[n] = i;
+			bitset_set(seen, n);
 		}
 	}
 
+	touches_move(&ms->motion, nx, ny, &moved, &stopped);
+	foreach_bit(i, moved)
+		ms->touch[i].direction = trig_direction(ms->motion.dx[i], ms->motion.dy[i]);
+
+	below = touches_below(&ms->motion, &seen, drv->bottom_edge);
+	foreach_bit(n, seen)
+		disable |= touch_classify(ms, cfg, drv, &hs->data[finger[n]], bitset_get(below, n), n);
+
 	if (disable)
 		touches_invalidate(ms);
 }
@@ -262,72 +365,171 @@ static void touches_update(struct MTState* ms,
  */
 static void touches_clean(struct MTState* ms)
 {
-	int i, used;
-	used = ms->touch_used;
-	foreach_bit(i, used) {
+	int i;
+	foreach_bit(i, ms->touch_used) {
 		if (GETBIT(ms->touch[i].state, MT_RELEASED))
-			CLEARBIT(ms->touch_used, i);
+			bitset_clear(ms->touch_used, i);
 	}
 }
 
-#if DEBUG_MTSTATE
+/* Check whether any touch changed in the last update.
+ */
+static int touches_settled(const struct MTState* ms)
+{
+	int i;
+	if (touches_moving(&ms->motion, &ms->touch_used))
+		return 0;
+	foreach_bit(i, ms->touch_used) {
+		if (GETBIT(ms->touch[i].state, MT_NEW) ||
+				GETBIT(ms->touch[i].state, MT_RELEASED))
+			return 0;
+	}
+	return 1;
+}
+
+/* Add touch i to a group, or take it out again with sign -1.
+ */
+static void touch_group_add(struct TouchGroup* g, const struct TouchMotion* tm,
+			int i, int sign)
+{
+	bitset_mod(g->set, i, sign > 0);
+	g->dx += sign * tm->dx[i];
+	g->dy += sign * tm->dy[i];
+}
+
+/* Bring the aggregates up to date with the touches of this frame. Every
+ * touch moved or changed state in touches_update, so they are gathered
+ * afresh in a single pass.
+ */
+static void touches_aggregate(struct MTState* ms)
+{
+	struct TouchAggregate* agg = &ms->agg;
+	const struct TouchMotion* tm = &ms->motion;
+	const struct Touch* t;
+	int i, f, x, y;
+
+	memset(agg, 0, sizeof(struct TouchAggregate));
+	agg->earliest = -1;
+	agg->latest = -1;
+	foreach_bit(i, ms->touch_used) {
+		t = &ms->touch[i];
+		if (GETBIT(t->state, MT_INVALID))
+			continue;
+		touch_group_add(&agg->valid, tm, i, 1);
+		for (f = 0; f < MT_FLAGS; f++) {
+			if (GETBIT(t->flags, f))
+				touch_group_add(&agg->flagged[f], tm, i, 1);
+		}
+		x = tm->x[i];
+		y = tm->y[i];
+		agg->sum_x += x;
+		agg->sum_y += y;
+		agg->sum_sq += (int64_t)x * x + (int64_t)y * y;
+		if (agg->earliest < 0 || timercmp(&t->down, &ms->touch[agg->earliest].down, <))
+			agg->earliest = i;
+		if (agg->latest < 0 || timercmp(&t->down, &ms->touch[agg->latest].down, >))
+			agg->latest = i;
+	}
+}
+
+void touch_flag_set(struct MTState* ms, int i, int flag)
+{
+	if (GETBIT(ms->touch[i].flags, flag))
+		return;
+	SETBIT(ms->touch[i].flags, flag);
+	if (bitset_get(ms->agg.valid.set, i))
+		touch_group_add(&ms->agg.flagged[flag], &ms->motion, i, 1);
+}
+
+void touch_flag_clear(struct MTState* ms, int i, int flag)
+{
+	if (!GETBIT(ms->touch[i].flags, flag))
+		return;
+	CLEARBIT(ms->touch[i].flags, flag);
+	if (bitset_get(ms->agg.valid.set, i))
+		touch_group_add(&ms->agg.flagged[flag], &ms->motion, i, -1);
+}
+
+int mtstate_centroid(const struct MTState* ms, int* x, int* y)
+{
+	int n = touch_group_count(&ms->agg.valid);
+	if (n == 0)
+		return 0;
+	*x = ms->agg.sum_x / n;
+	*y = ms->agg.sum_y / n;
+	return 1;
+}
+
+double mtstate_spread(const struct MTState* ms)
+{
+	int n = touch_group_count(&ms->agg.valid);
+	double cx, cy, var;
+	if (n == 0)
+		return 0;
+	cx = (double)ms->agg.sum_x / n;
+	cy = (double)ms->agg.sum_y / n;
+	var = (double)ms->agg.sum_sq / n - cx * cx - cy * cy;
+	return var > 0 ? sqrt(var) : 0;
+}
+
 static void mtstate_output(const struct MTState* ms,
 			const struct HWState* hs)
 {
 	int i, n;
-	char* type;
 	struct timeval tv;
-	n = bitcount(ms->touch_used);
-	if (bitcount(ms->touch_used) > 0) {
+	n = bitset_count(ms->touch_used);
+	if (n > 0) {
 		microtime(&tv);
-		xf86Msg(X_INFO, "mtstate: %d touches at event time %llu (rt %llu)\n",
+		trace(TRACE_MTSTATE, "mtstate: %d touches at event time %llu (rt %llu)\n",
 			n, timertoms(&hs->evtime), timertoms(&tv));
 	}
 	foreach_bit(i, ms->touch_used) {
 		if (GETBIT(ms->touch[i].state, MT_RELEASED)) {
 			timersub(&hs->evtime, &ms->touch[i].down, &tv);
-			xf86Msg(X_INFO, "  released p(%d, %d) d(%+d, %+d) dir(%f) down(%llu) time(%lld)\n",
-						ms->touch[i].x, ms->touch[i].y, ms->touch[i].dx, ms->touch[i].dy,
+			trace(TRACE_MTSTATE, "  released p(%d, %d) d(%+d, %+d) dir(%f) down(%llu) time(%lld)\n",
+						ms->motion.x[i], ms->motion.y[i], ms->motion.dx[i], ms->motion.dy[i],
 						ms->touch[i].direction, timertoms(&ms->touch[i].down), timertoms(&tv));
 		}
 		else if (GETBIT(ms->touch[i].state, MT_NEW)) {
-			xf86Msg(X_INFO, "  new      p(%d, %d) d(%+d, %+d) dir(%f) down(%llu)\n",
-						ms->touch[i].x, ms->touch[i].y, ms->touch[i].dx, ms->touch[i].dy,
+			trace(TRACE_MTSTATE, "  new      p(%d, %d) d(%+d, %+d) dir(%f) down(%llu)\n",
+						ms->motion.x[i], ms->motion.y[i], ms->motion.dx[i], ms->motion.dy[i],
 						ms->touch[i].direction, timertoms(&ms->touch[i].down));
 		}
 		else if (GETBIT(ms->touch[i].state, MT_INVALID)) {
 			timersub(&hs->evtime, &ms->touch[i].down, &tv);
-			xf86Msg(X_INFO, "  invalid  p(%d, %d) d(%+d, %+d) dir(%f) down(%llu) time(%lld)\n",
-						ms->touch[i].x, ms->touch[i].y, ms->touch[i].dx, ms->touch[i].dy,
+			trace(TRACE_MTSTATE, "  invalid  p(%d, %d) d(%+d, %+d) dir(%f) down(%llu) time(%lld)\n",
+						ms->motion.x[i], ms->motion.y[i], ms->motion.dx[i], ms->motion.dy[i],
 						ms->touch[i].direction, timertoms(&ms->touch[i].down), timertoms(&tv));
 		}
 		else {
-			xf86Msg(X_INFO, "  touching p(%d, %d) d(%+d, %+d) dir(%f) down(%llu)\n",
-						ms->touch[i].x, ms->touch[i].y, ms->touch[i].dx, ms->touch[i].dy,
+			trace(TRACE_MTSTATE, "  touching p(%d, %d) d(%+d, %+d) dir(%f) down(%llu)\n",
+						ms->motion.x[i], ms->motion.y[i], ms->motion.dx[i], ms->motion.dy[i],
 						ms->touch[i].direction, timertoms(&ms->touch[i].down));
 		}
 	}
 }
-#endif
 
 void mtstate_init(struct MTState* ms)
 {
 	memset(ms, 0, sizeof(struct MTState));
+	ms->agg.earliest = -1;
+	ms->agg.latest = -1;
 }
 
 // Process changes in touch state.
 void mtstate_extract(struct MTState* ms,
 			const struct MConfig* cfg,
-			const struct HWState* hs,
-			const struct Capabilities* caps)
+			const struct MConfigDerived* drv,
+			const struct HWState* hs)
 {
 	ms->state = 0;
 
 	touches_clean(ms);
-	touches_update(ms, cfg, hs, caps);
+	touches_update(ms, cfg, drv, hs);
+	touches_aggregate(ms);
+	ms->settled = touches_settled(ms);
 
-#if DEBUG_MTSTATE
-	mtstate_output(ms, hs);
-#endif
+	if (trace_enabled(TRACE_MTSTATE))
+		mtstate_output(ms, hs);
 }
 
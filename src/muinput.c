@@ -0,0 +1,197 @@
+/***************************************************************************
+ *
+ * Multitouch X driver
+ * Copyright (C) 2008 Henrik Rydberg <rydberg@euromail.se>
+ * Copyright (C) 2011 Ryan Bourgeois <bluedragonx@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ **************************************************************************/
+
+#include "muinput.h"
+#include <fcntl.h>
+#include <linux/uinput.h>
+
+#define BUTTON_LAST 32
+
+/* The key code of an X button number, or 0 for the wheel buttons.
+ */
+static int button_code(int button)
+{
+	static const int codes[] = {
+		BTN_LEFT, BTN_MIDDLE, BTN_RIGHT, 0, 0, 0, 0,
+		BTN_SIDE, BTN_EXTRA, BTN_FORWARD, BTN_BACK, BTN_TASK
+	};
+	if (button < 1 || button > BUTTON_LAST)
+		return 0;
+	if (button <= (int)(sizeof(codes) / sizeof(codes[0])))
+		return codes[button - 1];
+	return BTN_TRIGGER_HAPPY1 + button - 13;
+}
+
+static void append_event(struct MUinput* u, int type, int code, int value)
+{
+	struct input_event* ev = &u->queue[u->count++];
+	memset(ev, 0, sizeof(*ev));
+	ev->type = type;
+	ev->code = code;
+	ev->value = value;
+}
+
+static void queue_event(struct MUinput* u, int type, int code, int value)
+{
+	// Keep the last slot for the SYN_REPORT. When the queue is full the
+	// frame is split in two rather than dropped.
+	if (u->count == MUINPUT_QUEUE - 1)
+		muinput_flush(u);
+	append_event(u, type, code, value);
+}
+
+static void queue_wheel(struct MUinput* u, int code, int hires, int value)
+{
+	queue_event(u, EV_REL, code, value);
+	queue_event(u, EV_REL, hires, value * MUINPUT_WHEEL_HI_RES);
+}
+
+static void uinput_button(void* data, int button, int down)
+{
+	struct MUinput* u = data;
+	int code = button_code(button);
+	if (code) {
+		queue_event(u, EV_KEY, code, down);
+		return;
+	}
+	// Each press of a wheel button is one click; releases carry nothing.
+	if (!down)
+		return;
+	switch (button) {
+	case 4:
+		queue_wheel(u, REL_WHEEL, REL_WHEEL_HI_RES, 1);
+		break;
+	case 5:
+		queue_wheel(u, REL_WHEEL, REL_WHEEL_HI_RES, -1);
+		break;
+	case 6:
+		queue_wheel(u, REL_HWHEEL, REL_HWHEEL_HI_RES, -1);
+		break;
+	case 7:
+		queue_wheel(u, REL_HWHEEL, REL_HWHEEL_HI_RES, 1);
+		break;
+	}
+}
+
+static void uinput_motion(void* data, int dx, int dy)
+{
+	struct MUinput* u = data;
+	if (dx)
+		queue_event(u, EV_REL, REL_X, dx);
+	if (dy)
+		queue_event(u, EV_REL, REL_Y, dy);
+}
+
+static void uinput_flush(void* data)
+{
+	muinput_flush(data);
+}
+
+static int set_bit(int fd, unsigned long request, int bit)
+{
+	int ret;
+	SYSCALL(ret = ioctl(fd, request, bit));
+	return ret < 0 ? -errno : 0;
+}
+
+static int setup_device(int fd, const char* name)
+{
+	static const int rels[] = {
+		REL_X, REL_Y, REL_WHEEL, REL_HWHEEL, REL_WHEEL_HI_RES, REL_HWHEEL_HI_RES
+	};
+	struct uinput_setup setup;
+	int i, code, ret = 0;
+
+	ret = set_bit(fd, UI_SET_EVBIT, EV_KEY);
+	if (!ret)
+		ret = set_bit(fd, UI_SET_EVBIT, EV_REL);
+	if (!ret)
+		ret = set_bit(fd, UI_SET_PROPBIT, INPUT_PROP_POINTER);
+	for (i = 1; !ret && i <= BUTTON_LAST; i++) {
+		code = button_code(i);
+		if (code)
+			ret = set_bit(fd, UI_SET_KEYBIT, code);
+	}
+	for (i = 0; !ret && i < (int)(sizeof(rels) / sizeof(rels[0])); i++)
+		ret = set_bit(fd, UI_SET_RELBIT, rels[i]);
+	if (ret)
+		return ret;
+
+	memset(&setup, 0, sizeof(setup));
+	setup.id.bustype = BUS_VIRTUAL;
+	snprintf(setup.name, sizeof(setup.name), "%s", name);
+	SYSCALL(ret = ioctl(fd, UI_DEV_SETUP, &setup));
+	if (ret < 0)
+		return -errno;
+	SYSCALL(ret = ioctl(fd, UI_DEV_CREATE));
+	return ret < 0 ? -errno : 0;
+}
+
+int muinput_open(struct MUinput* u, const char* path, const char* name)
+{
+	int ret;
+	memset(u, 0, sizeof(struct MUinput));
+	SYSCALL(u->fd = open(path ? path : MUINPUT_PATH, O_WRONLY | O_CLOEXEC));
+	if (u->fd < 0)
+		return -errno;
+	ret = setup_device(u->fd, name ? name : MUINPUT_NAME);
+	if (ret) {
+		close(u->fd);
+		u->fd = -1;
+		mlog(MLOG_ERROR, "muinput: could not create device: %s\n", strerror(-ret));
+	}
+	return ret;
+}
+
+void muinput_sink(struct MUinput* u, struct MSink* sink)
+{
+	sink->data = u;
+	sink->button = uinput_button;
+	sink->motion = uinput_motion;
+	sink->flush = uinput_flush;
+}
+
+int muinput_flush(struct MUinput* u)
+{
+	ssize_t n;
+	int ret = 0;
+	if (!u->count || u->fd < 0)
+		return 0;
+	append_event(u, EV_SYN, SYN_REPORT, 0);
+	SYSCALL(n = write(u->fd, u->queue, u->count * sizeof(struct input_event)));
+	u->count = 0;
+	if (n < 0) {
+		ret = -errno;
+		mlog(MLOG_WARNING, "muinput: write failed: %s\n", strerror(-ret));
+	}
+	return ret;
+}
+
+void muinput_close(struct MUinput* u)
+{
+	if (u->fd < 0)
+		return;
+	muinput_flush(u);
+	ioctl(u->fd, UI_DEV_DESTROY);
+	close(u->fd);
+	u->fd = -1;
+}
@@ -0,0 +1,145 @@
+/***************************************************************************
+ *
+ * Multitouch X driver
+ * Copyright (C) 2008 Henrik Rydberg <rydberg@euromail.se>
+ * Copyright (C) 2011 Ryan Bourgeois <bluedragonx@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ **************************************************************************/
+
+#include "telemetry.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Snapshots a reader gives up after, so a reader never spins for long.
+#define TELEMETRY_RETRIES 64
+
+_Static_assert(MAX_BUTTONS <= 32, "buttons must fit the page");
+
+int telemetry_open(struct MTelemetry* t, const char* path)
+{
+	struct TelemetryPage* page;
+	int fd, ret = 0;
+
+	memset(t, 0, sizeof(struct MTelemetry));
+	// Never map a file someone else made: another user could shrink it
+	// under the input path. In a sticky directory the unlink fails for
+	// their files, and then so does the exclusive create.
+	if (unlink(path) && errno != ENOENT)
+		mlog(MLOG_WARNING, "%s: could not replace: %s\n", path, strerror(errno));
+	fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+	if (fd < 0)
+		return -errno;
+	if (ftruncate(fd, sizeof(struct TelemetryPage))) {
+		ret = -errno;
+		close(fd);
+		return ret;
+	}
+	page = mmap(NULL, sizeof(struct TelemetryPage), PROT_READ | PROT_WRITE,
+			MAP_SHARED, fd, 0);
+	if (page == MAP_FAILED)
+		ret = -errno;
+	close(fd);
+	if (ret)
+		return ret;
+
+	memset(page, 0, sizeof(struct TelemetryPage));
+	page->version = TELEMETRY_VERSION;
+	page->size = sizeof(struct TelemetryPage);
+	__atomic_store_n(&page->magic, TELEMETRY_MAGIC, __ATOMIC_RELEASE);
+	t->page = page;
+	return 0;
+}
+
+void telemetry_publish(struct MTelemetry* t, const struct HWState* hs,
+			const struct MTState* ms, const struct Gestures* gs,
+			const struct MLatency* lat)
+{
+	struct TelemetryPage* page = t->page;
+	uint32_t seq = page->seq;
+	int i;
+
+	__atomic_store_n(&page->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	page->frames = ++t->frames;
+	page->dropped = hs->dropped;
+	page->time = timertomicro(&gs->time);
+	page->buttons = gs->buttons.w[0];
+	page->move_type = gs->move_type;
+	page->move_dir = gs->move_dir;
+	page->pinch_scale = gs->pinch_scale;
+	page->pinch_angle = gs->pinch_angle;
+	page->touch_used = ms->touch_used;
+	for (i = 0; i < LATENCY_STAGES; i++)
+		page->latency[i] = lat ? lat->stage[i].last : 0;
+	foreach_bit(i, ms->touch_used) {
+		const struct Touch* touch = &ms->touch[i];
+		page->touch[i].tracking_id = touch->tracking_id;
+		page->touch[i].state = touch->state;
+		page->touch[i].x = ms->motion.x[i];
+		page->touch[i].y = ms->motion.y[i];
+		page->touch[i].dx = ms->motion.dx[i];
+		page->touch[i].dy = ms->motion.dy[i];
+	}
+
+	__atomic_store_n(&page->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+int telemetry_read(const struct TelemetryPage* page, struct TelemetryPage* snap)
+{
+	uint32_t seq;
+	int i;
+
+	if (__atomic_load_n(&page->magic, __ATOMIC_ACQUIRE) != TELEMETRY_MAGIC ||
+	    page->version != TELEMETRY_VERSION || page->size != sizeof(struct TelemetryPage))
+		return -EINVAL;
+	for (i = 0; i < TELEMETRY_RETRIES; i++) {
+		seq = __atomic_load_n(&page->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1)
+			continue;
+		memcpy(snap, page, sizeof(struct TelemetryPage));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&page->seq, __ATOMIC_RELAXED) == seq)
+			return 0;
+	}
+	return -EAGAIN;
+}
+
+const struct TelemetryPage* telemetry_map(const char* path)
+{
+	void* page;
+	struct stat st;
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+	if (fstat(fd, &st) || st.st_size < (off_t)sizeof(struct TelemetryPage)) {
+		close(fd);
+		errno = EINVAL;
+		return NULL;
+	}
+	page = mmap(NULL, sizeof(struct TelemetryPage), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	return page == MAP_FAILED ? NULL : page;
+}
+
+void telemetry_close(struct MTelemetry* t)
+{
+	if (t->page)
+		munmap(t->page, sizeof(struct TelemetryPage));
+	t->page = NULL;
+}
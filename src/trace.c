@@ -0,0 +1,114 @@
+/***************************************************************************
+ *
+ * Multitouch X driver
+ * Copyright (C) 2008 Henrik Rydberg <rydberg@euromail.se>
+ * Copyright (C) 2011 Ryan Bourgeois <bluedragonx@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ **************************************************************************/
+
+#include "trace.h"
+
+#ifdef DEBUG_GESTURES
+#define TRACE_DEFAULT_GESTURES BITMASK(TRACE_GESTURES)
+#else
+#define TRACE_DEFAULT_GESTURES 0
+#endif
+#ifdef DEBUG_MTSTATE
+#define TRACE_DEFAULT_MTSTATE BITMASK(TRACE_MTSTATE)
+#else
+#define TRACE_DEFAULT_MTSTATE 0
+#endif
+#ifdef DEBUG_PROPS
+#define TRACE_DEFAULT_PROPS BITMASK(TRACE_PROPS)
+#else
+#define TRACE_DEFAULT_PROPS 0
+#endif
+#ifdef DEBUG_DRIVER
+#define TRACE_DEFAULT_DRIVER BITMASK(TRACE_DRIVER)
+#else
+#define TRACE_DEFAULT_DRIVER 0
+#endif
+
+struct TraceLine {
+	unsigned int seq;	// Index of the line plus one once it is complete.
+	int category;
+	char text[TRACE_LINE_SIZE];
+};
+
+static const char* category_names[TRACE_CATEGORIES] = {
+	"gestures", "mtstate", "props", "driver"
+};
+
+unsigned int trace_mask = TRACE_DEFAULT_GESTURES | TRACE_DEFAULT_MTSTATE |
+	TRACE_DEFAULT_PROPS | TRACE_DEFAULT_DRIVER;
+
+// Writers claim lines at the head, trace_drain consumes them at the tail.
+static struct TraceLine lines[TRACE_LINES];
+static unsigned int head, tail, dropped;
+
+void trace_printf(int category, const char* format, ...)
+{
+	struct TraceLine* line;
+	unsigned int n;
+	va_list args;
+	int len;
+
+	n = __atomic_load_n(&head, __ATOMIC_RELAXED);
+	do {
+		if (n - __atomic_load_n(&tail, __ATOMIC_ACQUIRE) >= TRACE_LINES) {
+			__atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+			return;
+		}
+	} while (!__atomic_compare_exchange_n(&head, &n, n + 1, 1,
+			__ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+	line = &lines[n % TRACE_LINES];
+	line->category = category;
+	va_start(args, format);
+	len = vsnprintf(line->text, TRACE_LINE_SIZE, format, args);
+	va_end(args);
+	// Keep truncated lines terminated.
+	if (len >= TRACE_LINE_SIZE)
+		line->text[TRACE_LINE_SIZE - 2] = '\n';
+	__atomic_store_n(&line->seq, n + 1, __ATOMIC_RELEASE);
+}
+
+void trace_set_mask(unsigned int mask)
+{
+	__atomic_store_n(&trace_mask, mask & TRACE_ALL, __ATOMIC_RELAXED);
+}
+
+int trace_drain(void)
+{
+	struct TraceLine* line;
+	unsigned int t = tail, n;
+	int count = 0;
+
+	for (;;) {
+		line = &lines[t % TRACE_LINES];
+		if (__atomic_load_n(&line->seq, __ATOMIC_ACQUIRE) != t + 1)
+			break;
+		mlog(MLOG_INFO, "%s: %s", category_names[line->category], line->text);
+		__atomic_store_n(&tail, ++t, __ATOMIC_RELEASE);
+		count++;
+	}
+
+	n = __atomic_exchange_n(&dropped, 0, __ATOMIC_RELAXED);
+	if (n)
+		mlog(MLOG_WARNING, "trace: %u lines dropped\n", n);
+	return count;
+}
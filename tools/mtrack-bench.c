@@ -0,0 +1,277 @@
+/***************************************************************************
+ *
+ * Multitouch X driver
+ * Copyright (C) 2008 Henrik Rydberg <rydberg@euromail.se>
+ * Copyright (C) 2011 Ryan Bourgeois <bluedragonx@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ **************************************************************************/
+
+/* Replay captures through the pipeline as fast as possible and report
+ * the throughput of each stage, one JSON object per capture.
+ *
+ * Where the kernel allows it, the L1 data cache and last level cache
+ * misses of the pipeline are counted as well. Replaying a capture over
+ * and over keeps everything in cache, so -c evicts the given number of
+ * kilobytes from the caches before every frame, as the rest of the X
+ * server would. The misses then show how many lines a frame touches.
+ */
+
+#include "mtouch.h"
+#include <getopt.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+
+#define COUNTER_L1D 0
+#define COUNTER_LLC 1
+#define COUNTERS 2
+
+struct Output {
+	uint64_t buttons;
+	uint64_t motions;
+};
+
+struct Bench {
+	int fd[COUNTERS];		// -1 for counters the kernel refused.
+	char* evict;			// Walked before every frame, if set.
+	size_t evict_size;
+	uint64_t evict_ns;		// Time spent evicting, not benchmarked.
+};
+
+static void count_button(void* data, int button, int down)
+{
+	((struct Output*)data)->buttons++;
+}
+
+static void count_motion(void* data, int dx, int dy)
+{
+	((struct Output*)data)->motions++;
+}
+
+static int counter_open(uint32_t type, uint64_t config)
+{
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	return syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+static void counters_open(struct Bench* b)
+{
+	b->fd[COUNTER_L1D] = counter_open(PERF_TYPE_HW_CACHE,
+		PERF_COUNT_HW_CACHE_L1D |
+		PERF_COUNT_HW_CACHE_OP_READ << 8 |
+		PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+	b->fd[COUNTER_LLC] = counter_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+	if (b->fd[COUNTER_L1D] < 0 && b->fd[COUNTER_LLC] < 0)
+		fprintf(stderr, "warning: no cache miss counters: %s\n", strerror(errno));
+}
+
+static void counters_close(struct Bench* b)
+{
+	int i;
+	for (i = 0; i < COUNTERS; i++) {
+		if (b->fd[i] >= 0)
+			close(b->fd[i]);
+	}
+}
+
+static void counters_switch(const struct Bench* b, unsigned long request)
+{
+	int i;
+	for (i = 0; i < COUNTERS; i++) {
+		if (b->fd[i] >= 0)
+			ioctl(b->fd[i], request, 0);
+	}
+}
+
+/* Read a counter, -1 if it is not available.
+ */
+static int64_t counter_read(const struct Bench* b, int counter)
+{
+	uint64_t value;
+	if (b->fd[counter] < 0 || read(b->fd[counter], &value, sizeof(value)) != sizeof(value))
+		return -1;
+	return value;
+}
+
+/* Push the pipeline out of the caches, without counting the misses.
+ */
+static void evict(struct Bench* b)
+{
+	volatile char* p = b->evict;
+	uint64_t start;
+	size_t i;
+	if (!p)
+		return;
+	start = nanotime();
+	counters_switch(b, PERF_EVENT_IOC_DISABLE);
+	for (i = 0; i < b->evict_size; i += CACHELINE)
+		p[i]++;
+	counters_switch(b, PERF_EVENT_IOC_ENABLE);
+	b->evict_ns += nanotime() - start;
+}
+
+static void replay_once(struct Bench* b, struct MTouch* mt,
+			struct CaptureReader* reader, const struct MSink* sink)
+{
+	int ret;
+	mtouch_open_replay(mt, reader);
+	for (;;) {
+		evict(b);
+		while ((ret = mtouch_read(mt)) > 0) {
+			mtouch_output(mt, sink);
+			evict(b);
+		}
+		if (ret == 0)
+			break;
+		if (mtouch_delayed(mt))
+			mtouch_output(mt, sink);
+	}
+	mtouch_close(mt);
+}
+
+/* Format a count per frame as JSON, null if it was not counted.
+ */
+static const char* per_frame(char* buf, size_t size, int64_t count, double frames)
+{
+	if (count < 0)
+		return "null";
+	snprintf(buf, size, "%.2f", count / frames);
+	return buf;
+}
+
+static int bench_capture(struct Bench* b, const char* path, int iterations)
+{
+	struct CaptureReader reader;
+	struct MTouchProfile prof;
+	struct Output out;
+	const struct MSink sink = { &out, count_button, count_motion, NULL };
+	struct MTouch* mt;
+	uint64_t start, total;
+	int64_t l1d, llc;
+	char l1d_buf[32], llc_buf[32];
+	double frames;
+	int i, ret;
+
+	ret = capture_open(&reader, path, CAPTURE_FAST);
+	if (ret) {
+		fprintf(stderr, "error: %s: %s\n", path, strerror(-ret));
+		return ret;
+	}
+	mt = mtouch_alloc();
+	if (!mt) {
+		capture_free(&reader);
+		return -ENOMEM;
+	}
+	mconfig_defaults(&mt->cfg);
+
+	// One untimed pass to warm up the caches and branch predictors.
+	replay_once(b, mt, &reader, &sink);
+
+	memset(&prof, 0, sizeof(prof));
+	memset(&out, 0, sizeof(out));
+	mt->profile = &prof;
+	b->evict_ns = 0;
+	counters_switch(b, PERF_EVENT_IOC_RESET);
+	counters_switch(b, PERF_EVENT_IOC_ENABLE);
+	start = nanotime();
+	for (i = 0; i < iterations; i++)
+		replay_once(b, mt, &reader, &sink);
+	total = nanotime() - start - b->evict_ns;
+	counters_switch(b, PERF_EVENT_IOC_DISABLE);
+	l1d = counter_read(b, COUNTER_L1D);
+	llc = counter_read(b, COUNTER_LLC);
+
+	frames = prof.frames ? prof.frames : 1;
+	printf("{\"capture\": \"%s\", \"events\": %zu, \"iterations\": %d, "
+		"\"frames\": %llu, \"buttons\": %llu, \"motions\": %llu, "
+		"\"total_ns\": %llu, \"frames_per_sec\": %.0f, \"ns_per_frame\": %.1f, "
+		"\"hwstate_ns_per_frame\": %.1f, \"mtstate_ns_per_frame\": %.1f, "
+		"\"gestures_ns_per_frame\": %.1f, \"evict_kb\": %zu, "
+		"\"l1d_misses_per_frame\": %s, \"llc_misses_per_frame\": %s}\n",
+		path, reader.count, iterations,
+		(unsigned long long)prof.frames,
+		(unsigned long long)out.buttons,
+		(unsigned long long)out.motions,
+		(unsigned long long)total,
+		total ? prof.frames * 1e9 / total : 0.0,
+		total / frames,
+		prof.ns[MTOUCH_STAGE_HWSTATE] / frames,
+		prof.ns[MTOUCH_STAGE_MTSTATE] / frames,
+		prof.ns[MTOUCH_STAGE_GESTURES] / frames,
+		b->evict_size / 1024,
+		per_frame(l1d_buf, sizeof(l1d_buf), l1d, frames),
+		per_frame(llc_buf, sizeof(llc_buf), llc, frames));
+
+	mtouch_free(mt);
+	capture_free(&reader);
+	return 0;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "Usage: mtrack-bench [-n iterations] [-c evict-kb] <capture>...\n");
+}
+
+int main(int argc, char *argv[])
+{
+	struct Bench b;
+	int iterations = 100, opt, i, ret = 0;
+
+	memset(&b, 0, sizeof(b));
+	while ((opt = getopt(argc, argv, "n:c:")) != -1) {
+		switch (opt) {
+		case 'n':
+			iterations = MAXVAL(atoi(optarg), 1);
+			break;
+		case 'c':
+			b.evict_size = (size_t)MAXVAL(atoi(optarg), 0) * 1024;
+			break;
+		default:
+			usage();
+			return -1;
+		}
+	}
+	if (optind >= argc) {
+		usage();
+		return -1;
+	}
+
+	if (b.evict_size) {
+		b.evict = calloc(1, b.evict_size);
+		if (!b.evict) {
+			fprintf(stderr, "error: %s\n", strerror(ENOMEM));
+			return -1;
+		}
+	}
+	counters_open(&b);
+
+	// Keep the pipeline's own messages out of the measurements.
+	mlog_set_handler(mlog_quiet);
+	for (i = optind; i < argc; i++) {
+		if (bench_capture(&b, argv[i], iterations))
+			ret = -1;
+	}
+	counters_close(&b);
+	free(b.evict);
+	return ret;
+}
@@ -0,0 +1,353 @@
+/***************************************************************************
+ *
+ * Multitouch X driver
+ * Copyright (C) 2008 Henrik Rydberg <rydberg@euromail.se>
+ * Copyright (C) 2011 Ryan Bourgeois <bluedragonx@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ **************************************************************************/
+
+/* Fuzz target for the whole pipeline. An input is a flags byte, then
+ * the configuration and finally a stream of events:
+ *
+ *   flags    bit 0 set to skip the configuration and use the defaults,
+ *            bits 1-5 drop the minor touch, width major, width minor,
+ *            orientation and pressure axes, bit 6 drops the right button
+ *   config   the values of the options in the order mconfig_configure
+ *            asks for them: one byte for booleans, four for integers and
+ *            reals, the latter in thousandths
+ *   events   eight bytes each: type selector, code, then a byte whose
+ *            low bit asks for a raw value and whose other bits are the
+ *            milliseconds to the next frame, the value, and one more
+ *            byte of milliseconds in units of 128
+ *
+ * Built with libFuzzer by --enable-fuzzing. A compiler without libFuzzer
+ * gets a main that runs the inputs named on the command line instead,
+ * which is also how crashes are reproduced.
+ */
+
+#include "mtouch.h"
+#include <endian.h>
+#include <math.h>
+
+#define PAD_WIDTH 4000
+#define PAD_HEIGHT 2600
+#define TOUCH_MAX 1020
+#define PRESSURE_MAX 255
+#define EVENT_SIZE 8
+#define MAX_EVENTS 4096
+#define START_TIME 1000
+#define MAX_BUTTON 32
+
+/* libFuzzer entry point, also called by main for standalone runs.
+ */
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+struct FuzzInput {
+	const uint8_t* data;
+	size_t size, pos;
+};
+
+static const int event_types[8] = {
+	EV_SYN, EV_KEY, EV_ABS, EV_ABS, EV_ABS, EV_ABS, EV_ABS, EV_MSC
+};
+
+static const int optional_axes[5] = {
+	MTDEV_TOUCH_MINOR, MTDEV_WIDTH_MAJOR, MTDEV_WIDTH_MINOR,
+	MTDEV_ORIENTATION, MTDEV_PRESSURE
+};
+
+/* Capability axis of an event code, or -1.
+ */
+static int code_axis(int code)
+{
+	switch (code) {
+	case ABS_MT_TOUCH_MAJOR: return MTDEV_TOUCH_MAJOR;
+	case ABS_MT_TOUCH_MINOR: return MTDEV_TOUCH_MINOR;
+	case ABS_MT_WIDTH_MAJOR: return MTDEV_WIDTH_MAJOR;
+	case ABS_MT_WIDTH_MINOR: return MTDEV_WIDTH_MINOR;
+	case ABS_MT_ORIENTATION: return MTDEV_ORIENTATION;
+	case ABS_MT_POSITION_X: return MTDEV_POSITION_X;
+	case ABS_MT_POSITION_Y: return MTDEV_POSITION_Y;
+	case ABS_MT_PRESSURE: return MTDEV_PRESSURE;
+	default: return -1;
+	}
+}
+
+static int take(struct FuzzInput* in, void* buf, size_t n)
+{
+	if (in->size - in->pos < n)
+		return 0;
+	memcpy(buf, in->data + in->pos, n);
+	in->pos += n;
+	return 1;
+}
+
+static int fuzz_int(void* data, const char* name, int deflt)
+{
+	int32_t v;
+	return take(data, &v, sizeof(v)) ? (int)le32toh(v) : deflt;
+}
+
+static int fuzz_bool(void* data, const char* name, int deflt)
+{
+	uint8_t v;
+	return take(data, &v, sizeof(v)) ? v & 1 : deflt;
+}
+
+static double fuzz_real(void* data, const char* name, double deflt)
+{
+	int32_t v;
+	return take(data, &v, sizeof(v)) ? (int)le32toh(v) / 1000.0 : deflt;
+}
+
+static void set_abs(struct Capabilities* caps, int axis, int min, int max)
+{
+	caps->has_abs[axis] = 1;
+	caps->abs[axis].minimum = min;
+	caps->abs[axis].maximum = max;
+}
+
+static void init_caps(struct Capabilities* caps, int flags)
+{
+	int i;
+	memset(caps, 0, sizeof(struct Capabilities));
+	strcpy(caps->devname, "mtrack-fuzz");
+	caps->devid.bustype = BUS_VIRTUAL;
+	caps->has_left = 1;
+	caps->has_right = !(flags & 0x40);
+	caps->has_mtdata = 1;
+	caps->has_slot = 1;
+	caps->slot.maximum = DIM_FINGER - 1;
+	set_abs(caps, MTDEV_POSITION_X, 0, PAD_WIDTH);
+	set_abs(caps, MTDEV_POSITION_Y, 0, PAD_HEIGHT);
+	set_abs(caps, MTDEV_TOUCH_MAJOR, 0, TOUCH_MAX);
+	set_abs(caps, MTDEV_TOUCH_MINOR, 0, TOUCH_MAX);
+	set_abs(caps, MTDEV_WIDTH_MAJOR, 0, TOUCH_MAX);
+	set_abs(caps, MTDEV_WIDTH_MINOR, 0, TOUCH_MAX);
+	set_abs(caps, MTDEV_ORIENTATION, -31, 32);
+	set_abs(caps, MTDEV_PRESSURE, 0, PRESSURE_MAX);
+	set_abs(caps, MTDEV_TRACKING_ID, 0, 65535);
+	for (i = 0; i < 5; i++) {
+		if (flags & (2 << i))
+			caps->has_abs[optional_axes[i]] = 0;
+	}
+}
+
+/* Decode the event stream. Values of known axes are folded into their
+ * range unless the input asks for a raw value, so that most inputs
+ * describe touches the pipeline would actually see.
+ */
+static size_t read_events(struct FuzzInput* in, const struct Capabilities* caps,
+			struct input_event* events)
+{
+	struct timeval time = { START_TIME, 0 };
+	uint8_t b[EVENT_SIZE];
+	const struct input_absinfo* abs;
+	int32_t value;
+	size_t n = 0;
+	int axis;
+
+	while (n < MAX_EVENTS && take(in, b, EVENT_SIZE)) {
+		struct input_event* ev = &events[n++];
+		memcpy(&value, &b[3], sizeof(value));
+		value = le32toh(value);
+		ev->type = event_types[b[0] & 7];
+		ev->code = b[1];
+		if (ev->type == EV_SYN && !(b[0] & 0x80))
+			ev->code = SYN_REPORT;
+		else if (ev->type == EV_KEY && !(b[0] & 0x80))
+			ev->code = BTN_LEFT + b[1] % 3;
+		else if (ev->type == EV_ABS && !(b[0] & 0x80))
+			ev->code = ABS_MT_SLOT + b[1] % (ABS_MT_PRESSURE - ABS_MT_SLOT + 1);
+		if (ev->type == EV_ABS && !(b[2] & 1)) {
+			axis = code_axis(ev->code);
+			if (ev->code == ABS_MT_SLOT)
+				value = (uint32_t)value % DIM_FINGER;
+			else if (ev->code == ABS_MT_TRACKING_ID)
+				value = (value & 0x100) ? MT_ID_NULL : (uint32_t)value % 64;
+			else if (axis >= 0 && caps->has_abs[axis]) {
+				abs = &caps->abs[axis];
+				value = abs->minimum + (int)((uint32_t)value % (abs->maximum - abs->minimum + 1));
+			}
+		}
+		else if (ev->type == EV_KEY && !(b[2] & 1))
+			value = value & 1;
+		ev->value = value;
+		timercp(&ev->time, &time);
+		if (ev->type == EV_SYN && ev->code == SYN_REPORT)
+			timeraddms(&time, (b[2] >> 1) + b[7] * 128, &time);
+	}
+	return n;
+}
+
+#define CHECK(cond) \
+	do { if (!(cond)) { \
+		fprintf(stderr, "invariant failed: %s (%s:%d)\n", #cond, __FILE__, __LINE__); \
+		abort(); \
+	} } while (0)
+
+/* A deadline that is set lies no further than ms past now.
+ */
+static int deadline_ok(const struct timeval* deadline, const struct timeval* now, int ms)
+{
+	struct timeval limit;
+	if (!timerisset(deadline))
+		return 1;
+	timeraddms(now, ms, &limit);
+	return !timercmp(deadline, &limit, >);
+}
+
+static void check_invariants(const struct MTouch* mt)
+{
+	const struct HWState* hs = &mt->hs;
+	const struct MTState* ms = &mt->state;
+	const struct Gestures* gs = &mt->gs;
+	const struct MConfig* cfg = mt->cfg_live;
+	int i, j, f, in, dx, dy, hold;
+
+	// Hardware state: a slot is used exactly when it has a tracking id.
+	CHECK(hs->slot >= 0 && hs->slot < DIM_FINGER);
+	for (i = 0; i < DIM_FINGER; i++)
+		CHECK(bitset_get(hs->used, i) == (hs->data[i].tracking_id != MT_ID_NULL));
+
+	// Touch state: every touch belongs to a distinct live contact.
+	foreach_bit(i, ms->touch_used) {
+		CHECK(i < DIM_TOUCHES);
+		CHECK(ms->touch[i].tracking_id != MT_ID_NULL);
+		for (j = i + 1; j < DIM_TOUCHES; j++)
+			CHECK(!bitset_get(ms->touch_used, j) ||
+				ms->touch[j].tracking_id != ms->touch[i].tracking_id);
+	}
+
+	// Aggregates: the valid and flagged groups match the touches.
+	for (f = -1; f < MT_FLAGS; f++) {
+		const struct TouchGroup* g = f < 0 ? &ms->agg.valid : &ms->agg.flagged[f];
+		dx = dy = 0;
+		for (i = 0; i < DIM_TOUCHES; i++) {
+			in = bitset_get(ms->touch_used, i) &&
+				!GETBIT(ms->touch[i].state, MT_INVALID) &&
+				(f < 0 || GETBIT(ms->touch[i].flags, f));
+			CHECK(bitset_get(g->set, i) == in);
+			if (in) {
+				dx += ms->motion.dx[i];
+				dy += ms->motion.dy[i];
+			}
+		}
+		CHECK(g->dx == dx && g->dy == dy);
+	}
+	CHECK(bitset_any(ms->agg.valid.set) == (ms->agg.earliest >= 0));
+	CHECK(ms->agg.earliest < 0 || bitset_get(ms->agg.valid.set, ms->agg.earliest));
+	CHECK(ms->agg.latest < 0 || bitset_get(ms->agg.valid.set, ms->agg.latest));
+
+	// Gestures: counters are sane and deadlines are not in the far future.
+	CHECK(gs->tap_touching >= 0 && gs->tap_touching <= DIM_TOUCHES);
+	CHECK(gs->tap_released >= 0 && gs->tap_released <= DIM_TOUCHES);
+	CHECK(gs->move_type >= GS_NONE && gs->move_type <= GS_ROTATE);
+	CHECK(isfinite(gs->pinch_scale) && gs->pinch_scale >= 0);
+	CHECK(isfinite(gs->pinch_angle));
+	CHECK(gs->move_drag == GS_NONE || gs->move_drag == GS_DRAG_READY ||
+		gs->move_drag == GS_DRAG_WAIT || gs->move_drag == GS_DRAG_ACTIVE);
+	CHECK(gs->button_delayed >= 0 && gs->button_delayed < MAX_BUTTON);
+	CHECK(!timercmp(&gs->tap_time_down, &gs->time, >));
+	hold = MAXVAL(cfg->tap_timeout, cfg->gesture_hold);
+	CHECK(deadline_ok(&gs->button_delayed_time, &gs->time, hold));
+	CHECK(deadline_ok(&gs->move_wait, &gs->time, cfg->gesture_wait));
+	CHECK(deadline_ok(&gs->move_drag_expire, &gs->time, cfg->drag_timeout));
+	CHECK(deadline_ok(&gs->move_drag_wait, &gs->time, cfg->drag_wait));
+}
+
+static void check_button(void* data, int button, int down)
+{
+	CHECK(button >= 1 && button <= MAX_BUTTON);
+}
+
+static void check_motion(void* data, int dx, int dy)
+{
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+	static struct input_event events[MAX_EVENTS];
+	struct MTouch* mt;
+	const struct MSink sink = { NULL, check_button, check_motion, NULL };
+	struct FuzzInput in = { data, size, 0 };
+	const struct MOptions opts = { &in, fuzz_int, fuzz_bool, fuzz_real };
+	struct CaptureReader reader;
+	uint8_t flags = 0;
+	int ret;
+
+	mlog_set_handler(mlog_quiet);
+	take(&in, &flags, 1);
+	mt = mtouch_alloc();
+	if (!mt)
+		return 0;
+	memset(&reader, 0, sizeof(struct CaptureReader));
+	init_caps(&reader.caps, flags);
+	if (flags & 1)
+		mconfig_defaults(&mt->cfg);
+	else
+		mconfig_configure(&mt->cfg, &opts);
+	reader.events = events;
+	reader.count = read_events(&in, &reader.caps, events);
+	reader.mode = CAPTURE_FAST;
+
+	mtouch_open_replay(mt, &reader);
+	mtouch_publish_config(mt);
+	do {
+		while ((ret = mtouch_read(mt)) > 0) {
+			check_invariants(mt);
+			mtouch_output(mt, &sink);
+		}
+		if (mtouch_delayed(mt)) {
+			check_invariants(mt);
+			mtouch_output(mt, &sink);
+		}
+	} while (ret != 0);
+	mtouch_close(mt);
+	mtouch_free(mt);
+	return 0;
+}
+
+#ifdef FUZZ_STANDALONE
+int main(int argc, char* argv[])
+{
+	uint8_t* data;
+	FILE* file;
+	long size;
+	int i;
+
+	for (i = 1; i < argc; i++) {
+		file = fopen(argv[i], "rb");
+		if (!file) {
+			fprintf(stderr, "error: could not open %s\n", argv[i]);
+			return 1;
+		}
+		fseek(file, 0, SEEK_END);
+		size = ftell(file);
+		rewind(file);
+		data = malloc(size > 0 ? size : 1);
+		if (!data || fread(data, 1, size, file) != (size_t)size) {
+			fprintf(stderr, "error: could not read %s\n", argv[i]);
+			return 1;
+		}
+		fclose(file);
+		LLVMFuzzerTestOneInput(data, size);
+		free(data);
+	}
+	return 0;
+}
+#endif
@@ -0,0 +1,412 @@
+/***************************************************************************
+ *
+ * Multitouch X driver
+ * Copyright (C) 2008 Henrik Rydberg <rydberg@euromail.se>
+ * Copyright (C) 2011 Ryan Bourgeois <bluedragonx@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ **************************************************************************/
+
+/* Write synthetic captures of scripted multi-finger scenarios.
+ *
+ *   mtrack-gen [options] -o capture scenario
+ *
+ * Scenarios are line, scroll, arc, pinch, rotate, tap and palm. Every
+ * scenario moves N fingers over a virtual pad with the given report rate,
+ * adds noise within the fuzz of each axis and can churn tracking IDs by
+ * periodically lifting fingers and putting them back as new contacts.
+ * There may be more fingers than the pad tracks contacts, the extra ones
+ * go to slots beyond its range.
+ */
+
+#include "capture.h"
+#include <getopt.h>
+#include <math.h>
+
+/* Pad geometry, roughly that of a large clickpad.
+ */
+#define PAD_WIDTH 4000
+#define PAD_HEIGHT 2600
+#define TOUCH_MAX 1020
+#define PRESSURE_MAX 255
+
+/* Event time of the first frame, in seconds.
+ */
+#define START_TIME 1000
+
+struct Contact {
+	int down;
+	double x, y;		// Normalized to [0, 1].
+	double major, minor;	// Fraction of TOUCH_MAX.
+	int pressure;
+};
+
+struct Generator;
+typedef void (*scenario_t)(const struct Generator* g, int i, double t, struct Contact* c);
+
+struct Generator {
+	struct CaptureWriter w;
+	struct Capabilities caps;
+	struct timeval time;
+	unsigned int seed;
+	scenario_t scenario;
+	int fingers;
+	int rate;
+	int duration;
+	int churn;
+	double angle;
+	int next_id;
+	int slot;
+	int* id;		// Tracking ID of each finger.
+};
+
+/* Xorshift, so traces are identical on every libc.
+ */
+static unsigned int gen_random(struct Generator* g)
+{
+	g->seed ^= g->seed << 13;
+	g->seed ^= g->seed >> 17;
+	g->seed ^= g->seed << 5;
+	return g->seed;
+}
+
+/* Jitter of up to half the fuzz either way, which is about what passes
+ * the hysteresis filter of evdev.
+ */
+static int gen_noise(struct Generator* g, int fuzz)
+{
+	int amp = fuzz / 2;
+	if (amp <= 0)
+		return 0;
+	return (int)(gen_random(g) % (2 * amp + 1)) - amp;
+}
+
+static void finger(struct Contact* c, double x, double y)
+{
+	c->down = 1;
+	c->x = x;
+	c->y = y;
+	c->major = 0.20;
+	c->minor = 0.18;
+	c->pressure = 120;
+}
+
+/* Horizontal spacing of finger i in a row of n.
+ */
+static double spread(const struct Generator* g, int i)
+{
+	return (i - (g->fingers - 1) / 2.0) * 0.6 / MAXVAL(g->fingers, 4);
+}
+
+static void scenario_line(const struct Generator* g, int i, double t, struct Contact* c)
+{
+	double u = t / g->duration - 0.5;
+	finger(c, 0.5 + spread(g, i) + 0.6 * u * cos(g->angle),
+		0.5 - 0.6 * u * sin(g->angle));
+}
+
+/* Quick strokes up and down with a short lift in between.
+ */
+static void scenario_scroll(const struct Generator* g, int i, double t, struct Contact* c)
+{
+	static const double stroke = 200, lift = 50;
+	double phase = fmod(t, stroke + lift);
+	int up = (int)(t / (stroke + lift)) % 2;
+	double u = phase / stroke;
+	if (phase >= stroke) {
+		c->down = 0;
+		return;
+	}
+	finger(c, 0.5 + spread(g, i), up ? 0.75 - 0.5 * u : 0.25 + 0.5 * u);
+}
+
+static void scenario_arc(const struct Generator* g, int i, double t, struct Contact* c)
+{
+	double a = M_PI * t / g->duration + g->angle;
+	double r = 0.2 + 0.04 * i;
+	finger(c, 0.5 + r * cos(a), 0.5 - r * sin(a));
+}
+
+static void scenario_pinch(const struct Generator* g, int i, double t, struct Contact* c)
+{
+	double a = 2 * M_PI * i / g->fingers + g->angle;
+	double r = 0.35 - 0.25 * t / g->duration;
+	finger(c, 0.5 + r * cos(a), 0.5 - r * sin(a));
+}
+
+static void scenario_rotate(const struct Generator* g, int i, double t, struct Contact* c)
+{
+	double a = 2 * M_PI * i / g->fingers + g->angle + M_PI / 2 * t / g->duration;
+	finger(c, 0.5 + 0.25 * cos(a), 0.5 - 0.25 * sin(a));
+}
+
+/* Taps of all fingers at once, 60 ms down every 200 ms.
+ */
+static void scenario_tap(const struct Generator* g, int i, double t, struct Contact* c)
+{
+	if (fmod(t, 200) >= 60) {
+		c->down = 0;
+		return;
+	}
+	finger(c, 0.5 + spread(g, i), 0.5);
+}
+
+/* A palm resting near the bottom while the other fingers move.
+ */
+static void scenario_palm(const struct Generator* g, int i, double t, struct Contact* c)
+{
+	if (i == 0) {
+		finger(c, 0.2, 0.85);
+		c->major = 0.60;
+		c->minor = 0.45;
+		c->pressure = 230;
+		return;
+	}
+	scenario_line(g, i, t, c);
+}
+
+static const struct {
+	const char* name;
+	scenario_t scenario;
+} scenarios[] = {
+	{ "line", scenario_line },
+	{ "scroll", scenario_scroll },
+	{ "arc", scenario_arc },
+	{ "pinch", scenario_pinch },
+	{ "rotate", scenario_rotate },
+	{ "tap", scenario_tap },
+	{ "palm", scenario_palm },
+};
+
+static void set_abs(struct Capabilities* caps, int axis, int max, int sn)
+{
+	caps->has_abs[axis] = 1;
+	caps->abs[axis].minimum = 0;
+	caps->abs[axis].maximum = max;
+	caps->abs[axis].fuzz = sn ? max / sn : 0;
+}
+
+static void init_caps(struct Generator* g)
+{
+	struct Capabilities* caps = &g->caps;
+	memset(caps, 0, sizeof(struct Capabilities));
+	strcpy(caps->devname, "mtrack-gen");
+	caps->devid.bustype = BUS_VIRTUAL;
+	caps->has_left = 1;
+	caps->has_slot = 1;
+	caps->slot.maximum = g->fingers - 1;
+	set_abs(caps, MTDEV_POSITION_X, PAD_WIDTH, 250);
+	set_abs(caps, MTDEV_POSITION_Y, PAD_HEIGHT, 250);
+	set_abs(caps, MTDEV_TOUCH_MAJOR, TOUCH_MAX, 100);
+	set_abs(caps, MTDEV_TOUCH_MINOR, TOUCH_MAX, 100);
+	set_abs(caps, MTDEV_PRESSURE, PRESSURE_MAX, 0);
+	set_abs(caps, MTDEV_TRACKING_ID, 65535, 0);
+	caps->has_mtdata = 1;
+}
+
+static int emit(struct Generator* g, int type, int code, int value)
+{
+	struct input_event ev;
+	ev.time = g->time;
+	ev.type = type;
+	ev.code = code;
+	ev.value = value;
+	return capture_write(&g->w, &ev);
+}
+
+static int emit_slot(struct Generator* g, int slot)
+{
+	if (g->slot == slot)
+		return 0;
+	g->slot = slot;
+	return emit(g, EV_ABS, ABS_MT_SLOT, slot);
+}
+
+static int axis_value(struct Generator* g, int axis, double v)
+{
+	const struct input_absinfo* abs = &g->caps.abs[axis];
+	int value = abs->minimum + (int)(v * (abs->maximum - abs->minimum));
+	value += gen_noise(g, abs->fuzz);
+	return CLAMPVAL(value, abs->minimum, abs->maximum);
+}
+
+/* Churned fingers are lifted for one frame every churn milliseconds,
+ * staggered so they do not all change at once.
+ */
+static int churned(const struct Generator* g, int i, long frame)
+{
+	long period = (long)g->churn * g->rate / 1000;
+	if (!g->churn || period < 2)
+		return 0;
+	return (frame + i * period / g->fingers) % period == period - 1;
+}
+
+static int generate_frame(struct Generator* g, long frame)
+{
+	double t = frame * 1000.0 / g->rate;
+	struct Contact c;
+	int i, ret = 0;
+
+	for (i = 0; i < g->fingers && !ret; i++) {
+		memset(&c, 0, sizeof(c));
+		g->scenario(g, i, t, &c);
+		if (churned(g, i, frame))
+			c.down = 0;
+
+		if (!c.down) {
+			if (g->id[i] != MT_ID_NULL) {
+				g->id[i] = MT_ID_NULL;
+				ret = emit_slot(g, i) ||
+					emit(g, EV_ABS, ABS_MT_TRACKING_ID, MT_ID_NULL);
+			}
+			continue;
+		}
+		ret = emit_slot(g, i);
+		if (!ret && g->id[i] == MT_ID_NULL) {
+			g->id[i] = g->next_id;
+			g->next_id = (g->next_id + 1) % 65536;
+			ret = emit(g, EV_ABS, ABS_MT_TRACKING_ID, g->id[i]);
+		}
+		ret = ret ||
+			emit(g, EV_ABS, ABS_MT_POSITION_X, axis_value(g, MTDEV_POSITION_X, c.x)) ||
+			emit(g, EV_ABS, ABS_MT_POSITION_Y, axis_value(g, MTDEV_POSITION_Y, c.y)) ||
+			emit(g, EV_ABS, ABS_MT_TOUCH_MAJOR, axis_value(g, MTDEV_TOUCH_MAJOR, c.major)) ||
+			emit(g, EV_ABS, ABS_MT_TOUCH_MINOR, axis_value(g, MTDEV_TOUCH_MINOR, c.minor)) ||
+			emit(g, EV_ABS, ABS_MT_PRESSURE, c.pressure);
+	}
+	return ret || emit(g, EV_SYN, SYN_REPORT, 0);
+}
+
+static int generate(struct Generator* g, const char* path)
+{
+	long frames = (long)g->duration * g->rate / 1000, frame;
+	int i, ret;
+
+	init_caps(g);
+	g->id = calloc(g->fingers, sizeof(int));
+	if (!g->id)
+		return -ENOMEM;
+	ret = capture_create(&g->w, path, &g->caps);
+	if (ret) {
+		free(g->id);
+		return ret;
+	}
+	for (i = 0; i < g->fingers; i++)
+		g->id[i] = MT_ID_NULL;
+	g->slot = -1;
+
+	for (frame = 0; frame <= frames && !ret; frame++) {
+		uint64_t usec = (uint64_t)frame * 1000000 / g->rate;
+		g->time.tv_sec = START_TIME + usec / 1000000;
+		g->time.tv_usec = usec % 1000000;
+		if (frame < frames)
+			ret = generate_frame(g, frame);
+	}
+
+	// Lift everything and leave some idle time for the timers to expire.
+	for (i = 0; i < g->fingers && !ret; i++) {
+		if (g->id[i] != MT_ID_NULL)
+			ret = emit_slot(g, i) ||
+				emit(g, EV_ABS, ABS_MT_TRACKING_ID, MT_ID_NULL);
+	}
+	if (!ret)
+		ret = emit(g, EV_SYN, SYN_REPORT, 0);
+	g->time.tv_sec++;
+	if (!ret)
+		ret = emit(g, EV_SYN, SYN_REPORT, 0);
+
+	if (capture_close(&g->w) && !ret)
+		ret = -EIO;
+	free(g->id);
+	return ret;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "Usage: mtrack-gen [options] -o <capture> <scenario>\n");
+	fprintf(stderr, "  -n fingers   number of fingers (default 1)\n");
+	fprintf(stderr, "  -r rate      reports per second (1-1000, default 100)\n");
+	fprintf(stderr, "  -d ms        duration (default 1000)\n");
+	fprintf(stderr, "  -c ms        lift and replace each finger this often\n");
+	fprintf(stderr, "  -a degrees   direction or starting angle (default 0)\n");
+	fprintf(stderr, "  -s seed      noise seed (default 1)\n");
+	fprintf(stderr, "Scenarios: line scroll arc pinch rotate tap palm\n");
+}
+
+int main(int argc, char *argv[])
+{
+	struct Generator g;
+	const char* path = NULL;
+	int opt, ret;
+	size_t i;
+
+	memset(&g, 0, sizeof(g));
+	g.fingers = 1;
+	g.rate = 100;
+	g.duration = 1000;
+	g.seed = 1;
+
+	while ((opt = getopt(argc, argv, "n:r:d:c:a:s:o:")) != -1) {
+		switch (opt) {
+		case 'n':
+			g.fingers = MAXVAL(atoi(optarg), 1);
+			break;
+		case 'r':
+			g.rate = CLAMPVAL(atoi(optarg), 1, 1000);
+			break;
+		case 'd':
+			g.duration = MAXVAL(atoi(optarg), 1);
+			break;
+		case 'c':
+			g.churn = MAXVAL(atoi(optarg), 0);
+			break;
+		case 'a':
+			g.angle = atof(optarg) * M_PI / 180;
+			break;
+		case 's':
+			g.seed = strtoul(optarg, NULL, 0);
+			if (!g.seed)
+				g.seed = 1;
+			break;
+		case 'o':
+			path = optarg;
+			break;
+		default:
+			usage();
+			return -1;
+		}
+	}
+	if (!path || optind + 1 != argc) {
+		usage();
+		return -1;
+	}
+	for (i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+		if (!strcmp(scenarios[i].name, argv[optind]))
+			g.scenario = scenarios[i].scenario;
+	}
+	if (!g.scenario) {
+		fprintf(stderr, "error: unknown scenario %s\n", argv[optind]);
+		usage();
+		return -1;
+	}
+
+	ret = generate(&g, path);
+	if (ret) {
+		fprintf(stderr, "error: %s: %s\n", path, strerror(-ret));
+		return -1;
+	}
+	return 0;
+}
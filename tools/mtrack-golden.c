@@ -0,0 +1,349 @@
+/***************************************************************************
+ *
+ * Multitouch X driver
+ * Copyright (C) 2008 Henrik Rydberg <rydberg@euromail.se>
+ * Copyright (C) 2011 Ryan Bourgeois <bluedragonx@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ **************************************************************************/
+
+/* Replay captures under each configuration profile and compare every
+ * button edge and motion delta with the checked-in golden output.
+ *
+ *   mtrack-golden [-u] [-t usec] [-m delta] [-s drift] -g dir capture...
+ *
+ * Profiles are read from dir/profiles/NAME.conf and the output of a
+ * capture under a profile lives in dir/CAPTURE.NAME.golden. With -u the
+ * golden files are rewritten instead of compared. By default outputs
+ * must match exactly; -t allows timestamps to differ by up to usec, -m
+ * allows each motion component to differ by up to delta and -s bounds
+ * the drift of the accumulated motion.
+ */
+
+#include "mtouch.h"
+#include <dirent.h>
+#include <getopt.h>
+#include <libgen.h>
+
+#define OUT_BUTTON 0
+#define OUT_MOTION 1
+#define MAX_REPORTED 10
+
+struct OutputEntry {
+	long long usec;
+	int kind;
+	int a, b;	// button and state, or dx and dy
+};
+
+struct Output {
+	const struct MTouch* mt;
+	struct OutputEntry* entries;
+	size_t count, size;
+};
+
+struct Tolerance {
+	long long usec;
+	int delta;
+	int drift;
+};
+
+static int output_add(struct Output* out, long long usec, int kind, int a, int b)
+{
+	if (out->count == out->size) {
+		size_t size = out->size ? 2 * out->size : 1024;
+		struct OutputEntry* entries = realloc(out->entries, size * sizeof(*entries));
+		if (!entries)
+			return -ENOMEM;
+		out->entries = entries;
+		out->size = size;
+	}
+	out->entries[out->count].usec = usec;
+	out->entries[out->count].kind = kind;
+	out->entries[out->count].a = a;
+	out->entries[out->count].b = b;
+	out->count++;
+	return 0;
+}
+
+static long long output_time(const struct Output* out)
+{
+	return (long long)out->mt->gs.time.tv_sec * 1000000 + out->mt->gs.time.tv_usec;
+}
+
+static void record_button(void* data, int button, int down)
+{
+	struct Output* out = data;
+	output_add(out, output_time(out), OUT_BUTTON, button, down);
+}
+
+static void record_motion(void* data, int dx, int dy)
+{
+	struct Output* out = data;
+	output_add(out, output_time(out), OUT_MOTION, dx, dy);
+}
+
+static int replay(struct CaptureReader* reader, const struct MOptionStore* profile,
+			struct Output* out)
+{
+	const struct MSink sink = { out, record_button, record_motion, NULL };
+	struct MOptions opts;
+	struct MTouch* mt;
+	int ret;
+
+	mt = mtouch_alloc();
+	if (!mt)
+		return -ENOMEM;
+	moptions_bind(&opts, profile);
+	mconfig_configure(&mt->cfg, &opts);
+	out->mt = mt;
+	out->count = 0;
+
+	mtouch_open_replay(mt, reader);
+	for (;;) {
+		while ((ret = mtouch_read(mt)) > 0)
+			mtouch_output(mt, &sink);
+		if (ret == 0)
+			break;
+		if (mtouch_delayed(mt))
+			mtouch_output(mt, &sink);
+	}
+	mtouch_close(mt);
+	mtouch_free(mt);
+	return 0;
+}
+
+static int write_golden(const char* path, const struct Output* out)
+{
+	FILE* file = fopen(path, "w");
+	size_t i;
+	if (!file)
+		return -errno;
+	for (i = 0; i < out->count; i++) {
+		const struct OutputEntry* e = &out->entries[i];
+		if (e->kind == OUT_BUTTON)
+			fprintf(file, "%lld button %d %s\n", e->usec, e->a, e->b ? "down" : "up");
+		else
+			fprintf(file, "%lld motion %+d %+d\n", e->usec, e->a, e->b);
+	}
+	return fclose(file) ? -errno : 0;
+}
+
+static int read_golden(const char* path, struct Output* out)
+{
+	char line[128], kind[16], state[8];
+	long long usec;
+	int a, b, ret = 0;
+	FILE* file = fopen(path, "r");
+	if (!file)
+		return -errno;
+	out->count = 0;
+	while (!ret && fgets(line, sizeof(line), file)) {
+		if (sscanf(line, "%lld %15s %d %7s", &usec, kind, &a, state) == 4 &&
+		    !strcmp(kind, "button"))
+			ret = output_add(out, usec, OUT_BUTTON, a, !strcmp(state, "down"));
+		else if (sscanf(line, "%lld %15s %d %d", &usec, kind, &a, &b) == 4 &&
+			 !strcmp(kind, "motion"))
+			ret = output_add(out, usec, OUT_MOTION, a, b);
+		else
+			ret = -EINVAL;
+	}
+	fclose(file);
+	return ret;
+}
+
+static void describe(char* buf, size_t len, const struct OutputEntry* e)
+{
+	if (!e)
+		snprintf(buf, len, "nothing");
+	else if (e->kind == OUT_BUTTON)
+		snprintf(buf, len, "%lld button %d %s", e->usec, e->a, e->b ? "down" : "up");
+	else
+		snprintf(buf, len, "%lld motion %+d %+d", e->usec, e->a, e->b);
+}
+
+static int entries_match(const struct OutputEntry* want, const struct OutputEntry* got,
+			const struct Tolerance* tol, long long sum_dx, long long sum_dy)
+{
+	if (want->kind != got->kind || ABSVAL(want->usec - got->usec) > tol->usec)
+		return 0;
+	if (want->kind == OUT_BUTTON)
+		return want->a == got->a && want->b == got->b;
+	return ABSVAL(want->a - got->a) <= tol->delta &&
+		ABSVAL(want->b - got->b) <= tol->delta &&
+		ABSVAL(sum_dx) <= tol->drift && ABSVAL(sum_dy) <= tol->drift;
+}
+
+/* Compare outputs entry by entry. Returns the number of mismatches.
+ */
+static int compare(const char* name, const struct Output* want, const struct Output* got,
+			const struct Tolerance* tol)
+{
+	char wbuf[64], gbuf[64];
+	long long sum_dx = 0, sum_dy = 0;
+	size_t i, n = MAXVAL(want->count, got->count);
+	int errors = 0;
+
+	for (i = 0; i < n; i++) {
+		const struct OutputEntry* w = i < want->count ? &want->entries[i] : NULL;
+		const struct OutputEntry* g = i < got->count ? &got->entries[i] : NULL;
+		if (w && g && w->kind == OUT_MOTION && g->kind == OUT_MOTION) {
+			sum_dx += g->a - w->a;
+			sum_dy += g->b - w->b;
+		}
+		if (w && g && entries_match(w, g, tol, sum_dx, sum_dy))
+			continue;
+		// Report a drift once rather than on every entry after it.
+		sum_dx = 0;
+		sum_dy = 0;
+		if (errors++ < MAX_REPORTED) {
+			describe(wbuf, sizeof(wbuf), w);
+			describe(gbuf, sizeof(gbuf), g);
+			printf("%s: %zu: expected %s, got %s\n", name, i + 1, wbuf, gbuf);
+		}
+	}
+	if (errors > MAX_REPORTED)
+		printf("%s: %d more differences\n", name, errors - MAX_REPORTED);
+	return errors;
+}
+
+static int is_profile(const struct dirent* ent)
+{
+	size_t len = strlen(ent->d_name);
+	return len > 5 && !strcmp(ent->d_name + len - 5, ".conf");
+}
+
+static int run_capture(const char* dir, const char* path, struct dirent** profiles,
+			int nprofiles, int update, const struct Tolerance* tol)
+{
+	struct CaptureReader reader;
+	struct Output got = { NULL, NULL, 0, 0 }, want = { NULL, NULL, 0, 0 };
+	char name[256], file[PATH_MAX], base[PATH_MAX], *dot;
+	int i, ret, failed = 0;
+
+	ret = capture_open(&reader, path, CAPTURE_FAST);
+	if (ret) {
+		fprintf(stderr, "error: %s: %s\n", path, strerror(-ret));
+		return 1;
+	}
+	snprintf(base, sizeof(base), "%s", path);
+	snprintf(name, sizeof(name), "%s", basename(base));
+	dot = strrchr(name, '.');
+	if (dot)
+		*dot = '\0';
+
+	for (i = 0; i < nprofiles; i++) {
+		struct MOptionStore profile;
+		char label[512];
+		int plen = strlen(profiles[i]->d_name) - 5;
+
+		memset(&profile, 0, sizeof(profile));
+		snprintf(file, sizeof(file), "%s/profiles/%s", dir, profiles[i]->d_name);
+		if (moptions_load(&profile, file)) {
+			fprintf(stderr, "error: could not load profile %s\n", file);
+			failed++;
+			continue;
+		}
+		if (replay(&reader, &profile, &got)) {
+			failed++;
+			continue;
+		}
+		snprintf(file, sizeof(file), "%s/%s.%.*s.golden", dir, name, plen, profiles[i]->d_name);
+		snprintf(label, sizeof(label), "%s.%.*s", name, plen, profiles[i]->d_name);
+		if (update) {
+			ret = write_golden(file, &got);
+			if (ret) {
+				fprintf(stderr, "error: %s: %s\n", file, strerror(-ret));
+				failed++;
+			}
+			continue;
+		}
+		ret = read_golden(file, &want);
+		if (ret) {
+			fprintf(stderr, "error: %s: %s\n", file, strerror(-ret));
+			failed++;
+		}
+		else if (compare(label, &want, &got, tol)) {
+			printf("FAIL %s\n", label);
+			failed++;
+		}
+		else {
+			printf("PASS %s\n", label);
+		}
+	}
+	free(got.entries);
+	free(want.entries);
+	capture_free(&reader);
+	return failed;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "Usage: mtrack-golden [-u] [-t usec] [-m delta] [-s drift] -g dir <capture>...\n");
+}
+
+int main(int argc, char *argv[])
+{
+	struct Tolerance tol = { 0, 0, 0 };
+	struct dirent** profiles;
+	const char* dir = NULL;
+	char path[PATH_MAX];
+	int update = 0, nprofiles, opt, i, failed = 0;
+
+	while ((opt = getopt(argc, argv, "ug:t:m:s:")) != -1) {
+		switch (opt) {
+		case 'u':
+			update = 1;
+			break;
+		case 'g':
+			dir = optarg;
+			break;
+		case 't':
+			tol.usec = MAXVAL(atoll(optarg), 0);
+			break;
+		case 'm':
+			tol.delta = MAXVAL(atoi(optarg), 0);
+			break;
+		case 's':
+			tol.drift = MAXVAL(atoi(optarg), 0);
+			break;
+		default:
+			usage();
+			return 2;
+		}
+	}
+	if (!dir || optind >= argc) {
+		usage();
+		return 2;
+	}
+
+	snprintf(path, sizeof(path), "%s/profiles", dir);
+	nprofiles = scandir(path, &profiles, is_profile, alphasort);
+	if (nprofiles <= 0) {
+		fprintf(stderr, "error: no profiles in %s\n", path);
+		return 2;
+	}
+
+	mlog_set_handler(mlog_quiet);
+	for (i = optind; i < argc; i++)
+		failed += run_capture(dir, argv[i], profiles, nprofiles, update, &tol);
+
+	for (i = 0; i < nprofiles; i++)
+		free(profiles[i]);
+	free(profiles);
+	if (failed)
+		printf("%d of %d outputs differ\n", failed, nprofiles * (argc - optind));
+	return failed ? 1 : 0;
+}
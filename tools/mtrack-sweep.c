@@ -0,0 +1,486 @@
+/***************************************************************************
+ *
+ * Multitouch X driver
+ * Copyright (C) 2008 Henrik Rydberg <rydberg@euromail.se>
+ * Copyright (C) 2011 Ryan Bourgeois <bluedragonx@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ **************************************************************************/
+
+/* Replay labeled captures under every combination of a grid of options
+ * and report how many captures each combination misclassifies, and how
+ * quickly it recognizes the rest.
+ *
+ *   mtrack-sweep [-j threads] [-o Name=Value] [-c file] [-L dir] [-n rows] [-v]
+ *                -s Name=v1,v2,... capture...
+ *
+ * Each -s adds an axis to the grid; -o and -c set the options shared by
+ * every combination. The label of a capture is read from dir/NAME.label,
+ * or from the capture path with its extension replaced by .label. Label
+ * files hold one of "button N" per expected button, "motion" or "none",
+ * and a capture is classified by the set of buttons pressed while it is
+ * replayed, or by whether the pointer moved if none were. The latency is
+ * the capture time from the first contact to the first output that
+ * matches the label. Combinations run in parallel, one MTouch per thread.
+ */
+
+#include "mtouch.h"
+#include <getopt.h>
+#include <libgen.h>
+#include <limits.h>
+#include <pthread.h>
+
+#define MAX_AXES 8
+#define MAX_VALUES 32
+#define MAX_COMBINATIONS (1 << 20)
+
+#define LABEL_NONE 0
+#define LABEL_MOTION 1
+#define LABEL_BUTTONS 2
+
+struct Axis {
+	char name[MOPTIONS_NAME_LEN];
+	char values[MAX_VALUES][MOPTIONS_VALUE_LEN];
+	int count;
+};
+
+struct Trace {
+	char name[64];
+	struct CaptureReader reader;	// Shared; each replay uses a copy.
+	int label;
+	unsigned int buttons;		// Expected buttons, bit 0 is button 1.
+};
+
+struct Result {
+	int misses;
+	int recognized;
+	long long latency_sum, latency_max;	// Microseconds of capture time.
+	uint64_t ns, frames;
+};
+
+struct Sweep {
+	struct MOptionStore base;
+	struct Axis axes[MAX_AXES];
+	int naxes;
+	struct Trace* traces;
+	int ntraces;
+	size_t count;
+	size_t next;
+	struct Result* results;
+	unsigned char* wrong;		// count * ntraces misclassification flags.
+};
+
+/* What a replay produced, as far as the labels are concerned.
+ */
+struct Observation {
+	const struct MTouch* mt;
+	const struct Trace* trace;
+	unsigned int buttons;
+	int moved;
+	long long start, first;
+};
+
+static long long observe_time(const struct Observation* obs)
+{
+	return timertomicro(&obs->mt->gs.time);
+}
+
+static void observe_button(void* data, int button, int down)
+{
+	struct Observation* obs = data;
+	if (!down || button < 1 || button > 32)
+		return;
+	obs->buttons |= 1U << (button - 1);
+	if (obs->first < 0 && obs->trace->label == LABEL_BUTTONS &&
+	    (obs->trace->buttons >> (button - 1) & 1U))
+		obs->first = observe_time(obs);
+}
+
+static void observe_motion(void* data, int dx, int dy)
+{
+	struct Observation* obs = data;
+	obs->moved = 1;
+	if (obs->first < 0 && obs->trace->label == LABEL_MOTION)
+		obs->first = observe_time(obs);
+}
+
+static int classified(const struct Observation* obs)
+{
+	const struct Trace* trace = obs->trace;
+	switch (trace->label) {
+	case LABEL_BUTTONS:
+		return obs->buttons == trace->buttons;
+	case LABEL_MOTION:
+		return !obs->buttons && obs->moved;
+	default:
+		return !obs->buttons && !obs->moved;
+	}
+}
+
+/* Replay one capture with the configuration in mt->cfg and fold the
+ * outcome into res. Returns 1 if the capture was misclassified.
+ */
+static int replay(struct MTouch* mt, const struct Trace* trace, struct Result* res)
+{
+	struct Observation obs = { mt, trace, 0, 0, -1, -1 };
+	const struct MSink sink = { &obs, observe_button, observe_motion, NULL };
+	struct CaptureReader reader = trace->reader;
+	uint64_t start = nanotime();
+	int ret;
+
+	mtouch_open_replay(mt, &reader);
+	for (;;) {
+		while ((ret = mtouch_read(mt)) > 0) {
+			res->frames++;
+			if (obs.start < 0 && bitset_any(mt->hs.used))
+				obs.start = timertomicro(&mt->hs.evtime);
+			mtouch_output(mt, &sink);
+		}
+		if (ret == 0)
+			break;
+		if (mtouch_delayed(mt))
+			mtouch_output(mt, &sink);
+	}
+	mtouch_close(mt);
+	res->ns += nanotime() - start;
+
+	if (!classified(&obs)) {
+		res->misses++;
+		return 1;
+	}
+	if (obs.start >= 0 && obs.first >= 0) {
+		long long latency = MAXVAL(obs.first - obs.start, 0);
+		res->recognized++;
+		res->latency_sum += latency;
+		res->latency_max = MAXVAL(res->latency_max, latency);
+	}
+	return 0;
+}
+
+/* Build the options of combination n, taking the first axis as the
+ * fastest changing digit.
+ */
+static int combination(const struct Sweep* sw, size_t n, struct MOptionStore* store)
+{
+	char option[MOPTIONS_NAME_LEN + MOPTIONS_VALUE_LEN + 1];
+	int i;
+	memcpy(store, &sw->base, sizeof(struct MOptionStore));
+	for (i = 0; i < sw->naxes; i++) {
+		const struct Axis* axis = &sw->axes[i];
+		snprintf(option, sizeof(option), "%s=%s", axis->name, axis->values[n % axis->count]);
+		if (moptions_parse(store, option))
+			return -EINVAL;
+		n /= axis->count;
+	}
+	return 0;
+}
+
+static void* worker(void* data)
+{
+	struct Sweep* sw = data;
+	struct MOptionStore* store = calloc(1, sizeof(struct MOptionStore));
+	struct MTouch* mt = mtouch_alloc();
+	struct MOptions opts;
+	size_t n;
+	int i;
+
+	moptions_bind(&opts, store);
+	while (store && mt &&
+	       (n = __atomic_fetch_add(&sw->next, 1, __ATOMIC_RELAXED)) < sw->count) {
+		struct Result* res = &sw->results[n];
+		if (combination(sw, n, store)) {
+			res->misses = sw->ntraces;
+			continue;
+		}
+		for (i = 0; i < sw->ntraces; i++) {
+			mtouch_init(mt);
+			mconfig_configure(&mt->cfg, &opts);
+			sw->wrong[n * sw->ntraces + i] = replay(mt, &sw->traces[i], res);
+		}
+	}
+	free(store);
+	mtouch_free(mt);
+	return NULL;
+}
+
+/* Run every combination on nthreads threads. Returns 0 or a negative
+ * errno if no thread could be started.
+ */
+static int run_sweep(struct Sweep* sw, int nthreads)
+{
+	pthread_t* threads = calloc(nthreads, sizeof(pthread_t));
+	int i, started = 0;
+	if (!threads)
+		return -ENOMEM;
+	for (i = 0; i < nthreads; i++) {
+		if (pthread_create(&threads[started], NULL, worker, sw) == 0)
+			started++;
+	}
+	// Whatever could not be started, the calling thread does itself.
+	if (!started)
+		worker(sw);
+	for (i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+	return 0;
+}
+
+/* Parse "Name=v1,v2,..." into an axis of the grid.
+ */
+static int parse_axis(struct Axis* axis, const char* arg)
+{
+	const char *eq = strchr(arg, '='), *p;
+	size_t len;
+	if (!eq || eq == arg || eq - arg >= MOPTIONS_NAME_LEN)
+		return -EINVAL;
+	memset(axis, 0, sizeof(struct Axis));
+	memcpy(axis->name, arg, eq - arg);
+	for (p = eq + 1; ; p += len + 1) {
+		len = strcspn(p, ",");
+		if (!len || len >= MOPTIONS_VALUE_LEN || axis->count == MAX_VALUES)
+			return -EINVAL;
+		memcpy(axis->values[axis->count++], p, len);
+		if (!p[len])
+			return 0;
+	}
+}
+
+static int read_label(struct Trace* trace, const char* path)
+{
+	char line[128], kind[16];
+	int button, ret = 0;
+	FILE* file = fopen(path, "r");
+	if (!file)
+		return -errno;
+	trace->label = LABEL_NONE;
+	trace->buttons = 0;
+	while (!ret && fgets(line, sizeof(line), file)) {
+		if (line[0] == '#' || sscanf(line, "%15s", kind) != 1)
+			continue;
+		if (!strcmp(kind, "button") && sscanf(line, "%*s %d", &button) == 1 &&
+		    button >= 1 && button <= 32) {
+			trace->label = LABEL_BUTTONS;
+			trace->buttons |= 1U << (button - 1);
+		}
+		else if (!strcmp(kind, "motion"))
+			trace->label = trace->buttons ? trace->label : LABEL_MOTION;
+		else if (strcmp(kind, "none"))
+			ret = -EINVAL;
+	}
+	fclose(file);
+	return ret;
+}
+
+/* Load a capture and its label. Returns 0, or a negative errno if the
+ * capture should be left out.
+ */
+static int load_trace(struct Trace* trace, const char* path, const char* labels)
+{
+	char base[PATH_MAX], label[PATH_MAX], *dot;
+	int ret;
+
+	snprintf(base, sizeof(base), "%s", path);
+	snprintf(trace->name, sizeof(trace->name), "%s", basename(base));
+	dot = strrchr(trace->name, '.');
+	if (dot)
+		*dot = '\0';
+	if (labels) {
+		snprintf(label, sizeof(label), "%s/%s.label", labels, trace->name);
+	}
+	else {
+		snprintf(label, sizeof(label), "%s", path);
+		dot = strrchr(label, '.');
+		if (dot && !strchr(dot, '/'))
+			*dot = '\0';
+		strncat(label, ".label", sizeof(label) - strlen(label) - 1);
+	}
+	ret = read_label(trace, label);
+	if (ret) {
+		fprintf(stderr, "warning: %s: no usable label in %s\n", path, label);
+		return ret;
+	}
+	ret = capture_open(&trace->reader, path, CAPTURE_FAST);
+	if (ret)
+		fprintf(stderr, "error: %s: %s\n", path, strerror(-ret));
+	return ret;
+}
+
+static const struct Sweep* sort_sweep;
+
+static double mean_latency(const struct Result* res)
+{
+	return res->recognized ? (double)res->latency_sum / res->recognized : 0.0;
+}
+
+static int compare_results(const void* a, const void* b)
+{
+	const struct Result* ra = &sort_sweep->results[*(const size_t*)a];
+	const struct Result* rb = &sort_sweep->results[*(const size_t*)b];
+	double la = mean_latency(ra), lb = mean_latency(rb);
+	if (ra->misses != rb->misses)
+		return ra->misses - rb->misses;
+	if (la != lb)
+		return la < lb ? -1 : 1;
+	return *(const size_t*)a < *(const size_t*)b ? -1 : 1;
+}
+
+/* Print the combinations from best to worst: fewest misclassifications
+ * first, then the lowest mean latency.
+ */
+static void print_results(const struct Sweep* sw, size_t rows, int verbose)
+{
+	size_t* order = malloc(sw->count * sizeof(size_t));
+	size_t i, n;
+	int a, t;
+
+	if (!order)
+		return;
+	for (i = 0; i < sw->count; i++)
+		order[i] = i;
+	sort_sweep = sw;
+	qsort(order, sw->count, sizeof(size_t), compare_results);
+
+	printf("%-9s %6s %10s %10s %10s  %s\n",
+		"missed", "rate", "lat-mean", "lat-max", "ns/frame", "settings");
+	for (i = 0; i < MINVAL(rows, sw->count); i++) {
+		const struct Result* res = &sw->results[order[i]];
+		printf("%4d/%-4d %5.1f%% %8.1fms %8.1fms %10.1f ",
+			res->misses, sw->ntraces, 100.0 * res->misses / sw->ntraces,
+			mean_latency(res) / 1000, res->latency_max / 1000.0,
+			res->frames ? (double)res->ns / res->frames : 0.0);
+		for (n = order[i], a = 0; a < sw->naxes; a++) {
+			printf(" %s=%s", sw->axes[a].name, sw->axes[a].values[n % sw->axes[a].count]);
+			n /= sw->axes[a].count;
+		}
+		printf("\n");
+		if (!verbose || !res->misses)
+			continue;
+		printf("   missed:");
+		for (t = 0; t < sw->ntraces; t++) {
+			if (sw->wrong[order[i] * sw->ntraces + t])
+				printf(" %s", sw->traces[t].name);
+		}
+		printf("\n");
+	}
+	free(order);
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "Usage: mtrack-sweep [options] -s Name=v1,v2,... <capture>...\n");
+	fprintf(stderr, "  -s  add an option to the grid with the values to try\n");
+	fprintf(stderr, "  -o  set an option for every combination\n");
+	fprintf(stderr, "  -c  read options for every combination from a file\n");
+	fprintf(stderr, "  -L  read labels from dir/NAME.label\n");
+	fprintf(stderr, "  -j  number of threads, one per processor by default\n");
+	fprintf(stderr, "  -n  only print the best rows\n");
+	fprintf(stderr, "  -v  list the misclassified captures\n");
+}
+
+int main(int argc, char *argv[])
+{
+	static struct Sweep sw;
+	const char* labels = NULL;
+	size_t rows = (size_t)-1;
+	long nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	int verbose = 0, opt, i, ret;
+
+	while ((opt = getopt(argc, argv, "s:o:c:L:j:n:v")) != -1) {
+		switch (opt) {
+		case 's':
+			if (sw.naxes == MAX_AXES || parse_axis(&sw.axes[sw.naxes], optarg)) {
+				fprintf(stderr, "error: bad grid: %s\n", optarg);
+				return 2;
+			}
+			sw.naxes++;
+			break;
+		case 'o':
+			if (moptions_parse(&sw.base, optarg)) {
+				fprintf(stderr, "error: bad option: %s\n", optarg);
+				return 2;
+			}
+			break;
+		case 'c':
+			ret = moptions_load(&sw.base, optarg);
+			if (ret) {
+				fprintf(stderr, "error: could not read options: %s\n", strerror(-ret));
+				return 2;
+			}
+			break;
+		case 'L':
+			labels = optarg;
+			break;
+		case 'j':
+			nthreads = atoi(optarg);
+			break;
+		case 'n':
+			rows = MAXVAL(atoi(optarg), 1);
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		default:
+			usage();
+			return 2;
+		}
+	}
+	if (optind >= argc) {
+		usage();
+		return 2;
+	}
+	nthreads = CLAMPVAL(nthreads, 1, 256);
+
+	sw.count = 1;
+	for (i = 0; i < sw.naxes; i++) {
+		sw.count *= sw.axes[i].count;
+		if (sw.count > MAX_COMBINATIONS) {
+			fprintf(stderr, "error: more than %d combinations\n", MAX_COMBINATIONS);
+			return 2;
+		}
+	}
+
+	sw.traces = calloc(argc - optind, sizeof(struct Trace));
+	if (!sw.traces)
+		return 2;
+	for (i = optind; i < argc; i++) {
+		if (!load_trace(&sw.traces[sw.ntraces], argv[i], labels))
+			sw.ntraces++;
+	}
+	if (!sw.ntraces) {
+		fprintf(stderr, "error: no labeled captures\n");
+		return 2;
+	}
+
+	sw.results = calloc(sw.count, sizeof(struct Result));
+	sw.wrong = calloc(sw.count, sw.ntraces);
+	if (!sw.results || !sw.wrong)
+		return 2;
+
+	mlog_set_handler(mlog_quiet);
+	ret = run_sweep(&sw, nthreads);
+	if (ret) {
+		fprintf(stderr, "error: %s\n", strerror(-ret));
+		return 2;
+	}
+	print_results(&sw, rows, verbose);
+
+	for (i = 0; i < sw.ntraces; i++)
+		capture_free(&sw.traces[i].reader);
+	free(sw.traces);
+	free(sw.results);
+	free(sw.wrong);
+	return 0;
+}
@@ -0,0 +1,118 @@
+/***************************************************************************
+ *
+ * Multitouch X driver
+ * Copyright (C) 2008 Henrik Rydberg <rydberg@euromail.se>
+ * Copyright (C) 2011 Ryan Bourgeois <bluedragonx@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ **************************************************************************/
+
+/* Sample the telemetry a running driver or mtrackd shares and print one
+ * line per sample.
+ *
+ *   mtrack-telemetry [-i usec] [-n samples] [-t] file
+ *
+ * Samples are taken every usec microseconds, 100000 by default, and only
+ * printed when a frame was published since the last one. With -t every
+ * active touch is printed too.
+ */
+
+#include "telemetry.h"
+#include <getopt.h>
+#include <signal.h>
+
+static volatile sig_atomic_t stop;
+
+static void handle_signal(int sig)
+{
+	stop = 1;
+}
+
+static void print_sample(const struct TelemetryPage* s, int touches)
+{
+	int i;
+	printf("%lld.%06lld frames %llu dropped %llu buttons %#x move %d dir %d "
+		"scale %.3f angle %+.3f touches %d total %.1fus\n",
+		(long long)(s->time / 1000000), (long long)(s->time % 1000000),
+		(unsigned long long)s->frames, (unsigned long long)s->dropped,
+		s->buttons, s->move_type, s->move_dir, s->pinch_scale, s->pinch_angle,
+		bitset_count(s->touch_used), s->latency[LATENCY_TOTAL] / 1e3);
+	if (!touches)
+		return;
+	foreach_bit(i, s->touch_used) {
+		const struct TelemetryTouch* t = &s->touch[i];
+		printf("  touch %d id %d state %#x at (%d, %d) moved (%+d, %+d)\n",
+			i, t->tracking_id, t->state, t->x, t->y, t->dx, t->dy);
+	}
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "Usage: mtrack-telemetry [-i usec] [-n samples] [-t] <file>\n");
+}
+
+int main(int argc, char *argv[])
+{
+	const struct TelemetryPage* page;
+	struct TelemetryPage snap;
+	uint64_t last = 0;
+	long interval = 100000, samples = -1;
+	int touches = 0, opt, ret;
+
+	while ((opt = getopt(argc, argv, "i:n:t")) != -1) {
+		switch (opt) {
+		case 'i':
+			interval = MAXVAL(atol(optarg), 1);
+			break;
+		case 'n':
+			samples = atol(optarg);
+			break;
+		case 't':
+			touches = 1;
+			break;
+		default:
+			usage();
+			return 2;
+		}
+	}
+	if (optind != argc - 1) {
+		usage();
+		return 2;
+	}
+
+	page = telemetry_map(argv[optind]);
+	if (!page) {
+		fprintf(stderr, "error: %s: %s\n", argv[optind], strerror(errno));
+		return 1;
+	}
+	signal(SIGINT, handle_signal);
+	signal(SIGTERM, handle_signal);
+
+	while (!stop && samples-- != 0) {
+		ret = telemetry_read(page, &snap);
+		if (ret == -EINVAL) {
+			fprintf(stderr, "error: %s: not a telemetry file\n", argv[optind]);
+			return 1;
+		}
+		if (!ret && snap.frames != last) {
+			print_sample(&snap, touches);
+			fflush(stdout);
+			last = snap.frames;
+		}
+		usleep(interval);
+	}
+	return 0;
+}
@@ -20,95 +20,398 @@
  *
  **************************************************************************/
 
+/* Run a device or a capture through the pipeline and print every button
+ * edge and motion it produces, with statistics on exit.
+ *
+ *   mtrack-test [options] <device>
+ *   mtrack-test [options] [-t] -p capture
+ *
+ * Options take the same names as in xorg.conf and can be given with -o
+ * or read from a file with -c, later ones overriding earlier ones. A
+ * device is driven from an epoll loop, with a timerfd releasing delayed
+ * buttons on time. With -u the output also drives a uinput pointer, so
+ * a capture can be played back into the running desktop.
+ */
+
 #include "mtouch.h"
+#include "muinput.h"
+#include "trace.h"
 #include <fcntl.h>
-#include <stdarg.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+struct TestStats {
+	uint64_t buttons;
+	uint64_t motions;
+	uint64_t delayed;
+	long long dx, dy;	// Total distance moved along each axis.
+};
+
+static volatile sig_atomic_t stop, save;
+static struct FlightRecorder flight;
+static struct TestStats stats;
+static struct MSink forward;
+static int quiet, chrome;
+
+static void handle_signal(int sig)
+{
+	if (sig == SIGUSR1)
+		save = 1;
+	else
+		stop = 1;
+}
 
-void xf86Msg(int type, const char *format, ...)
+static void save_flight(int format)
 {
-	va_list args;
-	va_start(args, format);
-	vfprintf(stderr, format, args);
-	va_end(args);
+	char saved[sizeof(flight.path) + 16];
+	int n = flight_save(&flight, format, saved, sizeof(saved));
+	if (n < 0)
+		fprintf(stderr, "error: could not save flight recorder: %s\n", strerror(-n));
+	else
+		fprintf(stderr, "saved %d flight records to %s\n", n, saved);
 }
 
-#if GET_ABI_MAJOR(ABI_XINPUT_VERSION) <= 13
-typedef XF86OptionPtr pointer;
-#endif
+static void print_button(void* data, int button, int down)
+{
+	stats.buttons++;
+	if (!quiet)
+		printf("button %d %s\n", button, down ? "down" : "up");
+	if (forward.button)
+		forward.button(forward.data, button, down);
+}
 
-int xf86SetIntOption(XF86OptionPtr opts, const char *name, int deflt)
+static void print_motion(void* data, int dx, int dy)
 {
-	return deflt;
+	stats.motions++;
+	stats.dx += abs(dx);
+	stats.dy += abs(dy);
+	if (!quiet)
+		printf("moving (%+4d, %+4d)\n", dx, dy);
+	if (forward.motion)
+		forward.motion(forward.data, dx, dy);
 }
 
-int xf86SetBoolOption(XF86OptionPtr opts, const char *name, int deflt)
+static void print_flush(void* data)
 {
-	return deflt;
+	if (forward.flush)
+		forward.flush(forward.data);
 }
 
-double xf86SetRealOption(XF86OptionPtr opts, const char *name, double deflt)
+static const struct MSink sink = { NULL, print_button, print_motion, print_flush };
+
+static void post_frame(struct MTouch* mt)
 {
-	return deflt;
+	trace_drain();
+	mtouch_output(mt, &sink);
 }
 
-static void print_gestures(const struct Gestures* gs)
+static void check_save(void)
 {
-	int i;
-	static bitmask_t buttons_prev = 0U;
-	for (i = 0; i < 32; i++) {
-		if (GETBIT(gs->buttons, i) == GETBIT(buttons_prev, i))
-			continue;
+	if (save) {
+		save = 0;
+		save_flight(FLIGHT_TEXT);
+		if (chrome)
+			save_flight(FLIGHT_CHROME);
+	}
+}
+
+static int run_replay(struct MTouch* mt)
+{
+	int ret;
+	while (!stop) {
+		check_save();
+		while ((ret = mtouch_read(mt)) > 0)
+			post_frame(mt);
+		if (ret == 0)
+			break;
+		if (mtouch_delayed(mt)) {
+			stats.delayed++;
+			post_frame(mt);
+		}
+	}
+	return 0;
+}
+
+/* Arm the timer for the delayed button, or disarm it if there is none.
+ * Deadlines are in the timebase of evdev timestamps, CLOCK_REALTIME.
+ */
+static void arm_timer(const struct MTouch* mt, int tfd)
+{
+	struct itimerspec its;
+	struct timeval deadline;
+	memset(&its, 0, sizeof(its));
+	if (mtouch_deadline(mt, &deadline)) {
+		its.it_value.tv_sec = deadline.tv_sec;
+		its.it_value.tv_nsec = deadline.tv_usec * 1000;
+	}
+	timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, NULL);
+}
 
-		if (GETBIT(gs->buttons, i))
-			printf("button %d down\n", i+1);
-		else
-			printf("button %d up\n", i+1);
+static int run_device(struct MTouch* mt)
+{
+	struct epoll_event ev, events[2];
+	struct timeval now;
+	uint64_t expirations;
+	int epfd, tfd, i, n, ret = 0;
+
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+	tfd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (epfd < 0 || tfd < 0) {
+		ret = -errno;
+		goto out;
+	}
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = mt->fd;
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, mt->fd, &ev)) {
+		ret = -errno;
+		goto out;
+	}
+	ev.data.fd = tfd;
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, tfd, &ev)) {
+		ret = -errno;
+		goto out;
+	}
+
+	while (!stop) {
+		check_save();
+		n = epoll_wait(epfd, events, 2, -1);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			ret = -errno;
+			break;
+		}
+		for (i = 0; i < n; i++) {
+			if (events[i].data.fd == tfd) {
+				if (read(tfd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+					continue;
+				microtime(&now);
+				if (mtouch_expire(mt, &now)) {
+					stats.delayed++;
+					post_frame(mt);
+				}
+				continue;
+			}
+			while ((ret = mtouch_read(mt)) > 0)
+				post_frame(mt);
+			// The device is gone.
+			if (ret == 0)
+				stop = 1;
+			else if (ret == -EAGAIN)
+				ret = 0;
+			else
+				stop = 1;
+		}
+		arm_timer(mt, tfd);
 	}
+ out:
+	if (tfd >= 0)
+		close(tfd);
+	if (epfd >= 0)
+		close(epfd);
+	return ret;
+}
 
-	if (gs->move_dx != 0 || gs->move_dy != 0)
-		printf("moving (%+4d, %+4d)\n", gs->move_dx, gs->move_dy);
+static void print_stats(const struct MTouchProfile* profile, uint64_t ns)
+{
+	static const char* stage_names[MTOUCH_STAGES] = { "hwstate", "mtstate", "gestures" };
+	double secs = ns / 1e9;
+	int i;
 
-	buttons_prev = gs->buttons;
+	fprintf(stderr, "frames:    %llu in %.2f s (%.1f per second)\n",
+		(unsigned long long)profile->frames, secs, secs > 0 ? profile->frames / secs : 0.0);
+	fprintf(stderr, "buttons:   %llu edges, %llu delayed releases\n",
+		(unsigned long long)stats.buttons, (unsigned long long)stats.delayed);
+	fprintf(stderr, "motion:    %llu events, %lld x %lld\n",
+		(unsigned long long)stats.motions, stats.dx, stats.dy);
+	for (i = 0; i < MTOUCH_STAGES; i++) {
+		fprintf(stderr, "%-10s %.1f ns per frame\n", stage_names[i],
+			profile->frames ? (double)profile->ns[i] / profile->frames : 0.0);
+	}
 }
 
-static void loop_device(int fd)
+static void usage(void)
 {
-	struct MTouch mt;
-	if (mtouch_configure(&mt, fd)) {
-		fprintf(stderr, "error: could not configure device\n");
-		return;
-	}
-	if (mtouch_open(&mt, fd)) {
-		fprintf(stderr, "error: could not open device\n");
-		return;
-	}
-	
-	mconfig_defaults(&mt.cfg);
-	printf("width:  %d\n", mt.hs.max_x);
-	printf("height: %d\n", mt.hs.max_y);
-
-	//while (!mtdev_idle(&mt.dev, fd, 5000)) {
-	while (1) {
-		while (mtouch_read(&mt) > 0)
-			print_gestures(&mt.gs);
-		if (mtouch_delayed(&mt))
-			print_gestures(&mt.gs);
-	}
-	mtouch_close(&mt);
+	fprintf(stderr, "Usage: mtrack-test [options] [-w capture] <device>\n");
+	fprintf(stderr, "       mtrack-test [options] [-t] -p capture\n");
+	fprintf(stderr, "  -o  set an option, as Name=Value\n");
+	fprintf(stderr, "  -c  read options from a file, one Name=Value per line\n");
+	fprintf(stderr, "  -w  record the device events to a capture file\n");
+	fprintf(stderr, "  -p  replay a capture file instead of a device\n");
+	fprintf(stderr, "  -t  replay at the recorded pace\n");
+	fprintf(stderr, "  -q  only print statistics\n");
+	fprintf(stderr, "  -l  print latency statistics on exit\n");
+	fprintf(stderr, "  -d  trace categories: 1 gestures, 2 mtstate, 4 props, 8 driver\n");
+	fprintf(stderr, "  -f  save the flight recorder to new files named after this on SIGUSR1\n");
+	fprintf(stderr, "  -e  also save it as a Chrome trace, on SIGUSR1 and on exit\n");
+	fprintf(stderr, "  -u  also send the output to a uinput pointer\n");
+	fprintf(stderr, "  -T  share the live state in a telemetry file\n");
 }
 
 int main(int argc, char *argv[])
 {
-	if (argc < 2) {
-		fprintf(stderr, "Usage: test <mtdev>\n");
+	const char *record = NULL, *replay = NULL, *path = "mtrack-flight";
+	const char* share = NULL;
+	int realtime = 0, latency = 0, use_uinput = 0, opt, fd = -1, ret;
+	static struct MOptionStore store;
+	struct CaptureWriter writer;
+	struct CaptureReader reader;
+	struct MUinput uinput;
+	struct MTelemetry telemetry;
+	struct MTouchProfile profile;
+	struct MLatency lat;
+	struct MOptions opts;
+	struct MTouch* mt;
+	uint64_t start;
+
+	while ((opt = getopt(argc, argv, "o:c:w:p:tqld:f:euT:")) != -1) {
+		switch (opt) {
+		case 'o':
+			if (moptions_parse(&store, optarg)) {
+				fprintf(stderr, "error: bad option: %s\n", optarg);
+				return -1;
+			}
+			break;
+		case 'c':
+			ret = moptions_load(&store, optarg);
+			if (ret) {
+				fprintf(stderr, "error: could not read options: %s\n", strerror(-ret));
+				return -1;
+			}
+			break;
+		case 'w':
+			record = optarg;
+			break;
+		case 'p':
+			replay = optarg;
+			break;
+		case 't':
+			realtime = 1;
+			break;
+		case 'q':
+			quiet = 1;
+			break;
+		case 'l':
+			latency = 1;
+			break;
+		case 'd':
+			trace_set_mask(strtoul(optarg, NULL, 0));
+			break;
+		case 'f':
+			path = optarg;
+			break;
+		case 'e':
+			chrome = 1;
+			break;
+		case 'u':
+			use_uinput = 1;
+			break;
+		case 'T':
+			share = optarg;
+			break;
+		default:
+			usage();
+			return -1;
+		}
+	}
+	if (!replay && optind >= argc) {
+		usage();
 		return -1;
 	}
-	int fd = open(argv[1], O_RDONLY | O_NONBLOCK);
-	if (fd < 0) {
-		fprintf(stderr, "error: could not open file\n");
+
+	mt = mtouch_alloc();
+	if (!mt) {
+		fprintf(stderr, "error: out of memory\n");
 		return -1;
 	}
-	loop_device(fd);
-	close(fd);
-	return 0;
+	memset(&profile, 0, sizeof(struct MTouchProfile));
+	moptions_bind(&opts, &store);
+	mconfig_configure(&mt->cfg, &opts);
+	mt->profile = &profile;
+	if (latency) {
+		memset(&lat, 0, sizeof(struct MLatency));
+		mt->latency = &lat;
+	}
+	flight_init(&flight, path);
+	mt->flight = &flight;
+	signal(SIGINT, handle_signal);
+	signal(SIGTERM, handle_signal);
+	signal(SIGUSR1, handle_signal);
+
+	if (replay) {
+		ret = capture_open(&reader, replay, realtime ? CAPTURE_REALTIME : CAPTURE_FAST);
+		if (ret) {
+			fprintf(stderr, "error: could not read capture: %s\n", strerror(-ret));
+			return -1;
+		}
+		mtouch_open_replay(mt, &reader);
+	}
+	else {
+		fd = open(argv[optind], O_RDONLY | O_NONBLOCK);
+		if (fd < 0) {
+			fprintf(stderr, "error: could not open file\n");
+			return -1;
+		}
+		if (mtouch_configure(mt, fd)) {
+			fprintf(stderr, "error: could not configure device\n");
+			return -1;
+		}
+		if (mtouch_open(mt, fd)) {
+			fprintf(stderr, "error: could not open device\n");
+			return -1;
+		}
+	}
+	if (record) {
+		ret = capture_create(&writer, record, &mt->caps);
+		if (ret) {
+			fprintf(stderr, "error: could not create capture: %s\n", strerror(-ret));
+			return -1;
+		}
+		mt->record = &writer;
+	}
+	if (share) {
+		ret = telemetry_open(&telemetry, share);
+		if (ret) {
+			fprintf(stderr, "error: could not share telemetry: %s\n", strerror(-ret));
+			return -1;
+		}
+		mt->telemetry = &telemetry;
+	}
+	if (use_uinput) {
+		ret = muinput_open(&uinput, NULL, NULL);
+		if (ret) {
+			fprintf(stderr, "error: could not create uinput device: %s\n", strerror(-ret));
+			return -1;
+		}
+		muinput_sink(&uinput, &forward);
+	}
+	printf("width:  %d\n", mt->hs.max_x);
+	printf("height: %d\n", mt->hs.max_y);
+
+	start = nanotime();
+	ret = replay ? run_replay(mt) : run_device(mt);
+	trace_drain();
+	mtouch_close(mt);
+	if (ret)
+		fprintf(stderr, "error: %s\n", strerror(-ret));
+
+	print_stats(&profile, nanotime() - start);
+	if (chrome)
+		save_flight(FLIGHT_CHROME);
+	if (mt->latency)
+		latency_print(stderr, mt->latency);
+	if (use_uinput)
+		muinput_close(&uinput);
+	if (share)
+		telemetry_close(&telemetry);
+	if (record)
+		capture_close(&writer);
+	if (replay)
+		capture_free(&reader);
+	else
+		close(fd);
+	mtouch_free(mt);
+	return ret ? -1 : 0;
 }
@@ -0,0 +1,374 @@
+/***************************************************************************
+ *
+ * Multitouch X driver
+ * Copyright (C) 2008 Henrik Rydberg <rydberg@euromail.se>
+ * Copyright (C) 2011 Ryan Bourgeois <bluedragonx@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ **************************************************************************/
+
+/* Run the gesture engine without an X server on one or more devices and
+ * send the output of all of them to a single uinput pointer.
+ *
+ *   mtrackd [-o Name=Value] [-c file] [-n name] [-p] [-d mask] [-T dir] <device>...
+ *
+ * Every device gets its own thread with an epoll loop and a timerfd for
+ * delayed buttons, so a busy device never holds up another. The threads
+ * only meet at the output, which takes a lock for the few calls a frame
+ * makes. The devices are grabbed, so that the desktop does not move its
+ * own pointer as well. With -p the output is printed instead and the
+ * devices are left alone. With -T every device
+ * shares its live state in dir/mtrack-NAME.tlm, NAME being the base name
+ * of the device. The daemon exits on SIGINT or SIGTERM, or when the last
+ * device goes away.
+ */
+
+#include "mtouch.h"
+#include "muinput.h"
+#include "trace.h"
+#include <fcntl.h>
+#include <libgen.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#define MAX_DEVICES 16
+
+/* How often the main thread logs the trace ring.
+ */
+#define TRACE_DRAIN_MS 100
+
+struct Daemon {
+	struct MOptionStore options;
+	const char* telemetry;		// Directory for telemetry files, if any.
+	struct MUinput uinput;
+	struct MSink sink;		// Shared by all devices, under lock.
+	pthread_mutex_t lock;
+	pthread_t main;
+	int stopfd;			// Readable once the daemon is stopping.
+	int grab;			// Keep the devices from the desktop.
+	int running;
+};
+
+struct Worker {
+	struct Daemon* daemon;
+	const char* path;
+	struct MTouch* mt;
+	struct MTelemetry telemetry;
+	pthread_t thread;
+	int fd;
+	int opened;
+	int started;
+};
+
+static void print_button(void* data, int button, int down)
+{
+	printf("button %d %s\n", button, down ? "down" : "up");
+}
+
+static void print_motion(void* data, int dx, int dy)
+{
+	printf("moving (%+4d, %+4d)\n", dx, dy);
+}
+
+static void print_flush(void* data)
+{
+	fflush(stdout);
+}
+
+static void post_frame(struct Worker* w)
+{
+	struct Daemon* d = w->daemon;
+	pthread_mutex_lock(&d->lock);
+	mtouch_output(w->mt, &d->sink);
+	pthread_mutex_unlock(&d->lock);
+}
+
+/* Arm the timer for the delayed button, or disarm it if there is none.
+ * Deadlines are in the timebase of evdev timestamps, CLOCK_REALTIME.
+ */
+static void arm_timer(const struct MTouch* mt, int tfd)
+{
+	struct itimerspec its;
+	struct timeval deadline;
+	memset(&its, 0, sizeof(its));
+	if (mtouch_deadline(mt, &deadline)) {
+		its.it_value.tv_sec = deadline.tv_sec;
+		its.it_value.tv_nsec = deadline.tv_usec * 1000;
+	}
+	timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+static int watch(int epfd, int fd)
+{
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = fd;
+	return epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) ? -errno : 0;
+}
+
+/* The event loop of one device. Returns when the daemon stops or the
+ * device fails.
+ */
+static int run_device(struct Worker* w)
+{
+	struct MTouch* mt = w->mt;
+	struct epoll_event events[3];
+	struct timeval now;
+	uint64_t expirations;
+	int epfd, tfd, i, n, done = 0, ret = 0;
+
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+	tfd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (epfd < 0 || tfd < 0)
+		ret = -errno;
+	if (!ret)
+		ret = watch(epfd, mt->fd);
+	if (!ret)
+		ret = watch(epfd, tfd);
+	if (!ret)
+		ret = watch(epfd, w->daemon->stopfd);
+
+	while (!ret && !done) {
+		n = epoll_wait(epfd, events, 3, -1);
+		if (n < 0) {
+			if (errno != EINTR)
+				ret = -errno;
+			continue;
+		}
+		for (i = 0; i < n && !done; i++) {
+			if (events[i].data.fd == w->daemon->stopfd) {
+				done = 1;
+			}
+			else if (events[i].data.fd == tfd) {
+				if (read(tfd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+					continue;
+				microtime(&now);
+				if (mtouch_expire(mt, &now))
+					post_frame(w);
+			}
+			else {
+				while ((ret = mtouch_read(mt)) > 0)
+					post_frame(w);
+				if (ret == -EAGAIN)
+					ret = 0;
+				else if (ret == 0)
+					ret = -ENODEV;
+			}
+		}
+		arm_timer(mt, tfd);
+	}
+	if (tfd >= 0)
+		close(tfd);
+	if (epfd >= 0)
+		close(epfd);
+	return ret;
+}
+
+static void* worker(void* data)
+{
+	struct Worker* w = data;
+	struct Daemon* d = w->daemon;
+	int ret = run_device(w);
+	if (ret)
+		mlog(MLOG_ERROR, "%s: %s\n", w->path, strerror(-ret));
+	// The last device to go takes the daemon down with it.
+	if (__atomic_sub_fetch(&d->running, 1, __ATOMIC_ACQ_REL) == 0)
+		pthread_kill(d->main, SIGTERM);
+	return NULL;
+}
+
+static int open_device(struct Worker* w)
+{
+	struct MOptions opts;
+	w->mt = mtouch_alloc();
+	if (!w->mt)
+		return -ENOMEM;
+	SYSCALL(w->fd = open(w->path, O_RDONLY | O_NONBLOCK | O_CLOEXEC));
+	if (w->fd < 0)
+		return -errno;
+	moptions_bind(&opts, &w->daemon->options);
+	mconfig_configure(&w->mt->cfg, &opts);
+	w->mt->grab = w->daemon->grab;
+	if (mtouch_configure(w->mt, w->fd) || mtouch_open(w->mt, w->fd))
+		return -EINVAL;
+	w->opened = 1;
+	return 0;
+}
+
+static void share_telemetry(struct Worker* w)
+{
+	char base[PATH_MAX], path[PATH_MAX];
+	int ret;
+	snprintf(base, sizeof(base), "%s", w->path);
+	snprintf(path, sizeof(path), "%s/mtrack-%s.tlm", w->daemon->telemetry, basename(base));
+	ret = telemetry_open(&w->telemetry, path);
+	if (ret)
+		mlog(MLOG_WARNING, "%s: could not share telemetry: %s\n", path, strerror(-ret));
+	else
+		w->mt->telemetry = &w->telemetry;
+}
+
+static void close_device(struct Worker* w)
+{
+	if (w->opened)
+		mtouch_close(w->mt);
+	telemetry_close(&w->telemetry);
+	if (w->fd >= 0)
+		close(w->fd);
+	mtouch_free(w->mt);
+}
+
+/* Wait for a signal to stop, logging the trace ring in the meantime.
+ */
+static void wait_stop(const sigset_t* signals)
+{
+	struct timespec timeout = { 0, TRACE_DRAIN_MS * 1000000L };
+	while (sigtimedwait(signals, NULL, &timeout) < 0)
+		trace_drain();
+	trace_drain();
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "Usage: mtrackd [options] <device>...\n");
+	fprintf(stderr, "  -o  set an option, as Name=Value\n");
+	fprintf(stderr, "  -c  read options from a file, one Name=Value per line\n");
+	fprintf(stderr, "  -n  name of the uinput pointer\n");
+	fprintf(stderr, "  -p  print the output instead of sending it to uinput\n");
+	fprintf(stderr, "  -d  trace categories: 1 gestures, 2 mtstate, 4 props, 8 driver\n");
+	fprintf(stderr, "  -T  share the live state of each device in this directory\n");
+}
+
+int main(int argc, char *argv[])
+{
+	static struct Daemon d;
+	struct Worker workers[MAX_DEVICES];
+	const char* name = MUINPUT_NAME;
+	uint64_t one = 1;
+	sigset_t signals;
+	int print = 0, nworkers, nstarted = 0, opt, i, ret;
+
+	while ((opt = getopt(argc, argv, "o:c:n:pd:T:")) != -1) {
+		switch (opt) {
+		case 'o':
+			if (moptions_parse(&d.options, optarg)) {
+				fprintf(stderr, "error: bad option: %s\n", optarg);
+				return 2;
+			}
+			break;
+		case 'c':
+			ret = moptions_load(&d.options, optarg);
+			if (ret) {
+				fprintf(stderr, "error: could not read options: %s\n", strerror(-ret));
+				return 2;
+			}
+			break;
+		case 'n':
+			name = optarg;
+			break;
+		case 'p':
+			print = 1;
+			break;
+		case 'd':
+			trace_set_mask(strtoul(optarg, NULL, 0));
+			break;
+		case 'T':
+			d.telemetry = optarg;
+			break;
+		default:
+			usage();
+			return 2;
+		}
+	}
+	nworkers = argc - optind;
+	if (nworkers < 1 || nworkers > MAX_DEVICES) {
+		usage();
+		return 2;
+	}
+
+	// Only the main thread takes the signals, through sigtimedwait.
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+	pthread_mutex_init(&d.lock, NULL);
+	d.main = pthread_self();
+	d.stopfd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (d.stopfd < 0) {
+		fprintf(stderr, "error: eventfd: %s\n", strerror(errno));
+		return 1;
+	}
+	if (print) {
+		d.sink.button = print_button;
+		d.sink.motion = print_motion;
+		d.sink.flush = print_flush;
+	}
+	else {
+		ret = muinput_open(&d.uinput, NULL, name);
+		if (ret) {
+			fprintf(stderr, "error: could not create uinput device: %s\n", strerror(-ret));
+			return 1;
+		}
+		muinput_sink(&d.uinput, &d.sink);
+		d.grab = 1;
+	}
+
+	// Main holds a reference until every worker is started, so that a
+	// device failing early cannot stop the daemon while others open.
+	d.running = 1;
+	memset(workers, 0, sizeof(workers));
+	for (i = 0; i < nworkers; i++) {
+		struct Worker* w = &workers[i];
+		w->daemon = &d;
+		w->path = argv[optind + i];
+		w->fd = -1;
+		ret = open_device(w);
+		if (ret) {
+			fprintf(stderr, "error: %s: could not open device: %s\n", w->path, strerror(-ret));
+			continue;
+		}
+		if (d.telemetry)
+			share_telemetry(w);
+		__atomic_add_fetch(&d.running, 1, __ATOMIC_RELAXED);
+		w->started = !pthread_create(&w->thread, NULL, worker, w);
+		if (w->started)
+			nstarted++;
+		else
+			__atomic_sub_fetch(&d.running, 1, __ATOMIC_RELAXED);
+	}
+
+	if (__atomic_sub_fetch(&d.running, 1, __ATOMIC_ACQ_REL))
+		wait_stop(&signals);
+	if (write(d.stopfd, &one, sizeof(one)) < 0)
+		mlog(MLOG_WARNING, "could not stop the devices: %s\n", strerror(errno));
+	for (i = 0; i < nworkers; i++) {
+		if (workers[i].started)
+			pthread_join(workers[i].thread, NULL);
+		close_device(&workers[i]);
+	}
+
+	if (!print)
+		muinput_close(&d.uinput);
+	close(d.stopfd);
+	pthread_mutex_destroy(&d.lock);
+	return nstarted ? 0 : 1;
+}